@@ -0,0 +1,198 @@
+// adaptive_quality.h
+// Адаптивное качество воспроизведения: по измеренному времени конвертации и вывода
+// кадра контроллер ступенчато снижает ширину, глубину цвета и частоту показа, чтобы
+// укладываться в бюджет кадра, и возвращает качество, когда запас устойчиво появляется.
+// Пороги понижения и повышения разнесены, а повторные колебания удлиняют ожидание повышения
+
+#ifndef ADAPTIVE_QUALITY_H
+#define ADAPTIVE_QUALITY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+// Ступень качества: доля исходной ширины, глубина цвета и шаг показа кадров
+struct QualityLevel {
+    double widthScale = 1.0;
+    ColorDepth depth = ColorDepth::TrueColor;
+    int frameStep = 1;     // показывается каждый frameStep-й кадр
+};
+
+inline const char *colorDepthName(ColorDepth depth) {
+    switch (depth) {
+    case ColorDepth::TrueColor: return "24 бит";
+    case ColorDepth::Ansi256: return "256 цветов";
+    default: return "без цвета";
+    }
+}
+
+class AdaptiveQuality {
+public:
+    struct Options {
+        double targetFps = 25.0;
+        double degradeAbove = 0.9;   // доля бюджета, выше которой качество снижается
+        double upgradeBelow = 0.55;  // доля бюджета, ниже которой качество можно повысить
+        int degradeFrames = 6;       // сколько кадров подряд нужно превышение
+        int upgradeFrames = 45;      // сколько кадров подряд нужен запас
+        int settleFrames = 4;        // кадры после смены ступени, которые не учитываются
+    };
+
+    AdaptiveQuality() : AdaptiveQuality(Options(), ColorDepth::TrueColor) {}
+    // maxDepth - глубина цвета, выбранная пользователем (выше неё ступени не поднимаются)
+    AdaptiveQuality(Options opts, ColorDepth maxDepth) : m_opts(opts) {
+        buildLadder(maxDepth);
+        reset();
+    }
+
+    void reset() {
+        m_level = 0;
+        m_emaMs = 0.0;
+        m_over = m_under = 0;
+        m_settle = m_opts.settleFrames;
+        m_holdFactor = 1;
+        m_sinceUpgrade = -1;
+        m_changes = 0;
+    }
+
+    void setTargetFps(double fps) { m_opts.targetFps = fps > 0 ? fps : 25.0; }
+
+    const QualityLevel &level() const { return m_ladder[m_level]; }
+    int levelIndex() const { return m_level; }
+    int levelCount() const { return static_cast<int>(m_ladder.size()); }
+    int frameStep() const { return level().frameStep; }
+    ColorDepth depth() const { return level().depth; }
+
+    // Ширина вывода для базовой ширины пользователя
+    int width(int baseWidth) const {
+        return std::max(std::min(baseWidth, kMinWidth), static_cast<int>(std::lround(baseWidth * level().widthScale)));
+    }
+
+    // Бюджет одного показанного кадра (мс) с учётом шага показа
+    double budgetMs() const { return 1000.0 / m_opts.targetFps * frameStep(); }
+
+    // Сглаженная доля бюджета, занятая конвертацией и выводом
+    double usage() const { return m_emaMs / budgetMs(); }
+
+    // Учёт времени (мс) подготовки и вывода одного показанного кадра.
+    // Возвращает true, если ступень качества изменилась
+    bool addSample(double costMs) {
+        if (m_settle > 0) {
+            // Сразу после смены ступени кэши и размеры ещё не установились
+            --m_settle;
+            m_emaMs = costMs;
+            return false;
+        }
+        m_emaMs = m_emaMs > 0.0 ? m_emaMs + kEmaAlpha * (costMs - m_emaMs) : costMs;
+        if (m_sinceUpgrade >= 0)
+            ++m_sinceUpgrade;
+
+        const double u = usage();
+        m_over = u > m_opts.degradeAbove ? m_over + 1 : 0;
+        m_under = u < m_opts.upgradeBelow ? m_under + 1 : 0;
+
+        if (m_over >= m_opts.degradeFrames && m_level + 1 < levelCount()) {
+            // Понижение вскоре после повышения - признак колебаний: следующее
+            // повышение потребует вдвое более долгого запаса
+            if (m_sinceUpgrade >= 0 && m_sinceUpgrade < 2 * m_opts.upgradeFrames)
+                m_holdFactor = std::min(m_holdFactor * 2, kMaxHoldFactor);
+            else
+                m_holdFactor = 1;
+            m_sinceUpgrade = -1;
+            changeLevel(m_level + 1);
+            return true;
+        }
+        if (m_under >= m_opts.upgradeFrames * m_holdFactor && m_level > 0) {
+            m_sinceUpgrade = 0;
+            changeLevel(m_level - 1);
+            return true;
+        }
+        return false;
+    }
+
+    std::string statusText(int baseWidth) const {
+        const QualityLevel &q = level();
+        char line[192];
+        std::snprintf(line, sizeof(line), "качество %d/%d: ширина %d, %s, каждый %d-й кадр | бюджет %.0f%% (%.1f из %.1f мс)",
+                      levelCount() - m_level, levelCount(), width(baseWidth), colorDepthName(q.depth), q.frameStep,
+                      usage() * 100.0, m_emaMs, budgetMs());
+        return line;
+    }
+
+    // Сколько раз менялась ступень с последнего reset()
+    int changes() const { return m_changes; }
+
+private:
+    static constexpr double kEmaAlpha = 0.2;
+    static constexpr int kMaxHoldFactor = 8;
+    static constexpr int kMinWidth = 20;
+
+    // Лестница от лучшего к худшему: сначала ширина, затем цвет, затем частота показа
+    void buildLadder(ColorDepth maxDepth) {
+        const QualityLevel candidates[] = {
+            {1.0, ColorDepth::TrueColor, 1}, {0.85, ColorDepth::TrueColor, 1}, {0.7, ColorDepth::TrueColor, 1},
+            {0.7, ColorDepth::Ansi256, 1},   {0.55, ColorDepth::Ansi256, 1},   {0.55, ColorDepth::Mono, 1},
+            {0.55, ColorDepth::Mono, 2},     {0.4, ColorDepth::Mono, 2},       {0.4, ColorDepth::Mono, 3},
+        };
+        m_ladder.clear();
+        for (QualityLevel q : candidates) {
+            q.depth = static_cast<ColorDepth>(std::max(static_cast<int>(q.depth), static_cast<int>(maxDepth)));
+            if (!m_ladder.empty()) {
+                const QualityLevel &last = m_ladder.back();
+                if (last.widthScale == q.widthScale && last.depth == q.depth && last.frameStep == q.frameStep)
+                    continue;
+            }
+            m_ladder.push_back(q);
+        }
+    }
+
+    void changeLevel(int level) {
+        m_level = level;
+        m_over = m_under = 0;
+        m_settle = m_opts.settleFrames;
+        ++m_changes;
+    }
+
+    Options m_opts;
+    std::vector<QualityLevel> m_ladder;
+    int m_level = 0;
+    double m_emaMs = 0.0;
+    int m_over = 0;
+    int m_under = 0;
+    int m_settle = 0;
+    int m_holdFactor = 1;
+    int m_sinceUpgrade = -1;   // кадров после последнего повышения (-1 - повышения не было)
+    int m_changes = 0;
+};
+
+// Уменьшение готового кадра до cols столбцов (ближайшая ячейка) - для плееров,
+// которые показывают заранее сконвертированные кадры
+inline void downscaleAsciiFrame(const AsciiFrame &src, int cols, AsciiFrame &dst) {
+    if (cols >= src.cols || src.cols <= 0) {
+        dst = src;
+        return;
+    }
+    const int rows = std::max(1, static_cast<int>(std::lround(static_cast<double>(src.rows) * cols / src.cols)));
+    dst.cols = cols;
+    dst.rows = rows;
+    dst.glyphs.resize(static_cast<size_t>(rows) * cols);
+    dst.colors.create(rows, cols, CV_8UC3);
+    for (int row = 0; row < rows; ++row) {
+        const int srow = row * src.rows / rows;
+        const uint8_t *srcCells = src.glyphs.data() + static_cast<size_t>(srow) * src.cols;
+        const cv::Vec3b *srcColors = src.colors.ptr<cv::Vec3b>(srow);
+        uint8_t *cells = dst.glyphs.data() + static_cast<size_t>(row) * cols;
+        cv::Vec3b *colors = dst.colors.ptr<cv::Vec3b>(row);
+        for (int col = 0; col < cols; ++col) {
+            const int scol = col * src.cols / cols;
+            cells[col] = srcCells[scol];
+            colors[col] = srcColors[scol];
+        }
+    }
+}
+
+#endif // ADAPTIVE_QUALITY_H
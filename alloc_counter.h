@@ -0,0 +1,67 @@
+// alloc_counter.h
+// Счётчик выделений памяти: проверка того, что конвейер кадров после прогрева не
+// обращается к куче. Глобальные operator new/delete заменяются на считающие, поэтому
+// их определения попадают ровно в одну единицу трансляции - в ту, где перед #include
+// задан ASCII_ALLOC_COUNTER_IMPLEMENT. Счёт общий для всех потоков и видит выделения
+// через new в любой библиотеке C++; malloc из кода на C (кодеки, zlib) не учитывается
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace alloc_counter {
+
+inline std::atomic<uint64_t> g_allocations{0};
+
+inline uint64_t allocations() { return g_allocations.load(std::memory_order_relaxed); }
+
+} // namespace alloc_counter
+
+// Число выделений с момента создания (во всех потоках)
+class AllocationScope {
+public:
+    AllocationScope() : m_start(alloc_counter::allocations()) {}
+    uint64_t count() const { return alloc_counter::allocations() - m_start; }
+
+private:
+    uint64_t m_start;
+};
+
+#ifdef ASCII_ALLOC_COUNTER_IMPLEMENT
+
+// GCC сопоставляет new с delete и не знает, что здесь обе стороны идут через malloc/free
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(std::size_t size) {
+    alloc_counter::g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return ::operator new(size); }
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    alloc_counter::g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept { return ::operator new(size, tag); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+
+#endif // ASCII_ALLOC_COUNTER_IMPLEMENT
+
+#endif // ALLOC_COUNTER_H
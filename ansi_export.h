@@ -0,0 +1,232 @@
+// ansi_export.h
+// Сериализация ASCII-кадра в текст для терминала: без цвета или с ANSI-цветами
+// (24 бит или xterm-256). Цвет выводится только при смене, пробелы цвет не меняют
+
+#ifndef ANSI_EXPORT_H
+#define ANSI_EXPORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+namespace ansi_detail {
+
+inline const std::string &glyphAt(const std::vector<std::string> &glyphs, uint8_t index) {
+    return glyphs[std::min<size_t>(index, glyphs.size() - 1)];
+}
+
+inline bool isBlank(const std::string &glyph) {
+    return glyph.empty() || glyph == " ";
+}
+
+// Десятичное число без временной строки
+inline void appendNumber(std::string &out, unsigned value) {
+    char digits[12];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    while (n > 0)
+        out += digits[--n];
+}
+
+inline void appendTrueColor(std::string &out, int r, int g, int b) {
+    out += "\033[38;2;";
+    appendNumber(out, static_cast<unsigned>(r));
+    out += ';';
+    appendNumber(out, static_cast<unsigned>(g));
+    out += ';';
+    appendNumber(out, static_cast<unsigned>(b));
+    out += 'm';
+}
+
+inline void append256(std::string &out, int index) {
+    out += "\033[38;5;";
+    appendNumber(out, static_cast<unsigned>(index));
+    out += 'm';
+}
+
+} // namespace ansi_detail
+
+// Текст кадра без цвета, строки разделены '\n'. Вариант с out заменяет его содержимое,
+// сохраняя выделенную память: повторные кадры того же размера не выделяют память
+inline void asciiFrameToPlain(const AsciiFrame &frame, const std::vector<std::string> &glyphs, std::string &out) {
+    out.clear();
+    out.reserve(static_cast<size_t>(frame.rows) * (frame.cols + 1));
+    for (int row = 0; row < frame.rows; ++row) {
+        const uint8_t *cells = frame.glyphs.data() + static_cast<size_t>(row) * frame.cols;
+        for (int col = 0; col < frame.cols; ++col)
+            out += ansi_detail::glyphAt(glyphs, cells[col]);
+        out += '\n';
+    }
+}
+
+inline std::string asciiFrameToPlain(const AsciiFrame &frame, const std::vector<std::string> &glyphs) {
+    std::string out;
+    asciiFrameToPlain(frame, glyphs, out);
+    return out;
+}
+
+// Текст кадра с ANSI-цветами. Для xterm-256 цвета квантуются с режимом дизеринга dither.
+// Вариант с out переиспользует его память и палитру потока
+inline void asciiFrameToAnsi(const AsciiFrame &frame, const std::vector<std::string> &glyphs,
+                             ColorDepth depth, DitherMode dither, std::string &out) {
+    using namespace ansi_detail;
+    if (depth == ColorDepth::Mono) {
+        asciiFrameToPlain(frame, glyphs, out);
+        return;
+    }
+    thread_local std::vector<uint8_t> palette;
+    if (depth == ColorDepth::Ansi256)
+        quantizeAnsi256(frame.colors, dither, palette);
+
+    out.clear();
+    out.reserve(static_cast<size_t>(frame.rows) * frame.cols * 8);
+    for (int row = 0; row < frame.rows; ++row) {
+        const cv::Vec3b *colors = frame.colors.ptr<cv::Vec3b>(row);
+        const uint8_t *cells = frame.glyphs.data() + static_cast<size_t>(row) * frame.cols;
+        int current = -1;  // текущий цвет строки (-1 - не задан)
+        for (int col = 0; col < frame.cols; ++col) {
+            const std::string &glyph = glyphAt(glyphs, cells[col]);
+            if (!isBlank(glyph)) {
+                size_t cell = static_cast<size_t>(row) * frame.cols + col;
+                int color = depth == ColorDepth::Ansi256
+                                ? palette[cell]
+                                : (colors[col][2] << 16) | (colors[col][1] << 8) | colors[col][0];
+                if (color != current) {
+                    if (depth == ColorDepth::Ansi256)
+                        append256(out, color);
+                    else
+                        appendTrueColor(out, colors[col][2], colors[col][1], colors[col][0]);
+                    current = color;
+                }
+            }
+            out += glyph;
+        }
+        if (current >= 0)
+            out += "\033[0m";
+        out += '\n';
+    }
+}
+
+inline std::string asciiFrameToAnsi(const AsciiFrame &frame, const std::vector<std::string> &glyphs,
+                                    ColorDepth depth, DitherMode dither) {
+    std::string out;
+    asciiFrameToAnsi(frame, glyphs, depth, dither, out);
+    return out;
+}
+
+// Дельта-кодирование кадров для терминала: выводятся только изменившиеся ячейки
+// с позиционированием курсора, полный кадр очищает экран и рисует все ячейки.
+// Каждый кадр заканчивается сбросом цвета, поэтому поток можно начинать с любого полного кадра
+class AnsiDeltaEncoder {
+public:
+    AnsiDeltaEncoder(std::vector<std::string> glyphs, ColorDepth depth, DitherMode dither)
+        : m_glyphs(std::move(glyphs)), m_depth(depth), m_dither(dither) {}
+
+    // delta - изменения относительно предыдущего кадра (для первого кадра или при смене
+    // размера - полный кадр), full (если задан) - полный кадр.
+    // Возвращает true, если delta является полным кадром
+    bool encode(const AsciiFrame &frame, std::string *delta, std::string *full = nullptr) {
+        packCells(frame, m_cur);
+        const bool haveDelta = m_prev.size() == m_cur.size() && m_cols == frame.cols;
+        m_cols = frame.cols;
+        size_t changed = m_cur.size();
+        if (haveDelta) {
+            changed = 0;
+            for (size_t i = 0; i < m_cur.size(); ++i)
+                changed += m_cur[i] != m_prev[i];
+        }
+        m_changedRatio = m_cur.empty() ? 0.0 : static_cast<double>(changed) / m_cur.size();
+        if (delta) {
+            delta->clear();
+            emit(frame, haveDelta ? &m_prev : nullptr, *delta);
+        }
+        if (full) {
+            full->clear();
+            emit(frame, nullptr, *full);
+        }
+        m_prev.swap(m_cur);
+        return !haveDelta;
+    }
+
+    // Доля ячеек, изменившихся в последнем кадре
+    double changedRatio() const { return m_changedRatio; }
+
+private:
+    // Ячейка: индекс символа в старшем байте, цвет (RGB или индекс xterm-256) в младших.
+    // Цвет пробела не виден, поэтому не учитывается
+    void packCells(const AsciiFrame &frame, std::vector<uint32_t> &out) {
+        using namespace ansi_detail;
+        if (m_depth == ColorDepth::Ansi256)
+            quantizeAnsi256(frame.colors, m_dither, m_palette);
+        out.resize(static_cast<size_t>(frame.rows) * frame.cols);
+        for (int row = 0; row < frame.rows; ++row) {
+            const cv::Vec3b *colors = m_depth == ColorDepth::TrueColor ? frame.colors.ptr<cv::Vec3b>(row) : nullptr;
+            for (int col = 0; col < frame.cols; ++col) {
+                const size_t cell = static_cast<size_t>(row) * frame.cols + col;
+                const uint8_t glyph = frame.glyphs[cell];
+                uint32_t color = 0;
+                if (!isBlank(glyphAt(m_glyphs, glyph))) {
+                    if (m_depth == ColorDepth::Ansi256)
+                        color = m_palette[cell];
+                    else if (colors)
+                        color = (uint32_t(colors[col][2]) << 16) | (uint32_t(colors[col][1]) << 8) | colors[col][0];
+                }
+                out[cell] = (uint32_t(glyph) << 24) | color;
+            }
+        }
+    }
+
+    void emit(const AsciiFrame &frame, const std::vector<uint32_t> *prev, std::string &out) {
+        using namespace ansi_detail;
+        if (!prev)
+            out += "\033[0m\033[?25l\033[2J";
+        int cursorRow = -1, cursorCol = -1;
+        int64_t current = -1;
+        for (int row = 0; row < frame.rows; ++row) {
+            for (int col = 0; col < frame.cols; ++col) {
+                const size_t cell = static_cast<size_t>(row) * frame.cols + col;
+                const uint32_t value = m_cur[cell];
+                if (prev && (*prev)[cell] == value)
+                    continue;
+                if (row != cursorRow || col != cursorCol) {
+                    out += "\033[";
+                    appendNumber(out, static_cast<unsigned>(row + 1));
+                    out += ';';
+                    appendNumber(out, static_cast<unsigned>(col + 1));
+                    out += 'H';
+                }
+                const std::string &glyph = glyphAt(m_glyphs, static_cast<uint8_t>(value >> 24));
+                const uint32_t color = value & 0xFFFFFF;
+                if (m_depth != ColorDepth::Mono && !isBlank(glyph) && static_cast<int64_t>(color) != current) {
+                    if (m_depth == ColorDepth::Ansi256)
+                        append256(out, static_cast<int>(color));
+                    else
+                        appendTrueColor(out, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+                    current = color;
+                }
+                out += glyph;
+                cursorRow = row;
+                cursorCol = col + 1;
+            }
+        }
+        if (current >= 0)
+            out += "\033[0m";
+    }
+
+    std::vector<std::string> m_glyphs;
+    ColorDepth m_depth;
+    DitherMode m_dither;
+    std::vector<uint32_t> m_prev;
+    std::vector<uint32_t> m_cur;
+    std::vector<uint8_t> m_palette;
+    int m_cols = 0;
+    double m_changedRatio = 0.0;
+};
+
+#endif // ANSI_EXPORT_H
@@ -0,0 +1,652 @@
+// ascii_core.h
+// Общее ядро конвертации кадра в сетку ASCII-ячеек (используется GUI и консольными утилитами)
+
+#ifndef ASCII_CORE_H
+#define ASCII_CORE_H
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Режим дизеринга между яркостью и выбором символа
+enum class DitherMode {
+    None,           // каждая ячейка независимо округляется до ближайшего уровня
+    Ordered,        // упорядоченный дизеринг Байера 8x8 (для видео в реальном времени)
+    FloydSteinberg  // диффузия ошибки Флойда-Стейнберга (для статичных изображений)
+};
+
+// Глубина цвета для ANSI-вывода
+enum class ColorDepth {
+    TrueColor,  // 24-битный цвет: \033[38;2;r;g;bm
+    Ansi256,    // палитра xterm-256 (куб 6x6x6): \033[38;5;nm
+    Mono        // без цвета
+};
+
+// Кадр ASCII-арта в виде сетки ячеек
+struct AsciiFrame {
+    int cols = 0;
+    int rows = 0;
+    std::vector<uint8_t> glyphs;  // индексы символов в наборе, rows * cols
+    cv::Mat colors;               // цвет ячеек, CV_8UC3 (BGR), rows x cols
+};
+
+// Режим дизеринга по имени (none, ordered|bayer, fs|floyd|floyd-steinberg).
+// false - неизвестное имя, mode не меняется
+inline bool ditherModeFromString(const std::string &name, DitherMode &mode) {
+    if (name == "none")
+        mode = DitherMode::None;
+    else if (name == "ordered" || name == "bayer")
+        mode = DitherMode::Ordered;
+    else if (name == "fs" || name == "floyd" || name == "floyd-steinberg")
+        mode = DitherMode::FloydSteinberg;
+    else
+        return false;
+    return true;
+}
+
+// Высота ASCII-кадра: коэффициент 0.55 корректирует соотношение сторон символа
+inline int asciiRowsFor(int srcCols, int srcRows, int desiredWidth) {
+    double aspect = static_cast<double>(srcRows) / srcCols;
+    return std::max(1, static_cast<int>(desiredWidth * aspect * 0.55));
+}
+
+// Таблица символов из UTF-8 строки набора (каждый кодовый символ - отдельный элемент)
+inline std::vector<std::string> glyphTableFromUtf8(const std::string &charset) {
+    std::vector<std::string> table;
+    for (size_t i = 0; i < charset.size();) {
+        unsigned char c = static_cast<unsigned char>(charset[i]);
+        size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+        table.push_back(charset.substr(i, len));
+        i += len;
+    }
+    return table;
+}
+
+namespace ascii_detail {
+
+// Матрица Байера 8x8 (значения 0..63)
+static const uint8_t kBayer8[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+// Яркость хранится в фиксированной точке: gray * 256 (0..65280)
+static const uint32_t kLumScale = 255u * 256u;
+
+// Уровни куба 6x6x6 палитры xterm-256
+static const uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+// Яркость строки BGR-пикселей: 0.299 R + 0.587 G + 0.114 B в фиксированной точке
+inline void luminanceRow(const uint8_t *bgr, uint16_t *lum, int cols) {
+    for (int x = 0; x < cols; ++x) {
+        uint32_t b = bgr[3 * x], g = bgr[3 * x + 1], r = bgr[3 * x + 2];
+        lum[x] = static_cast<uint16_t>(r * 77u + g * 150u + b * 29u);
+    }
+}
+
+// Пороги строки y матрицы Байера в масштабе яркости (значения внутри (0, kLumScale))
+inline void bayerThresholds(int y, uint32_t thr[8]) {
+    for (int i = 0; i < 8; ++i)
+        thr[i] = (2u * kBayer8[y & 7][i] + 1u) * kLumScale / 128u;
+}
+
+// Выбор уровней для строки без дизеринга и с упорядоченным дизерингом.
+// Циклы без ветвлений, компилятор векторизует их (деление на константу)
+inline void quantizeRow(const uint16_t *lum, uint8_t *out, int cols, uint32_t maxLevel,
+                        const uint32_t *thr) {
+    if (!thr) {
+        for (int x = 0; x < cols; ++x)
+            out[x] = static_cast<uint8_t>(std::min(lum[x] * maxLevel / kLumScale, maxLevel));
+        return;
+    }
+    for (int x = 0; x < cols; ++x) {
+        uint32_t v = (lum[x] * maxLevel + thr[x & 7]) / kLumScale;
+        out[x] = static_cast<uint8_t>(std::min(v, maxLevel));
+    }
+}
+
+// Кадры меньше этого числа ячеек обрабатываются в вызывающем потоке: раздача строк
+// помощникам обходится дороже самой работы
+static const long kParallelCells = 32 * 1024;
+
+// Постоянные помощники вызывающего потока для строк больших кадров. Потоки создаются при
+// первом большом кадре и живут до завершения владельца, у каждого вызывающего потока
+// (например, отрезка предобработки) они свои. Задание передаётся указателем на функцию
+// с контекстом, так что запуск после прогрева не выделяет память
+class RowWorkers {
+public:
+    RowWorkers() = default;
+    RowWorkers(const RowWorkers &) = delete;
+    RowWorkers &operator=(const RowWorkers &) = delete;
+
+    ~RowWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        for (std::thread &t : m_threads)
+            t.join();
+    }
+
+    // Помощники текущего потока
+    static RowWorkers &local() {
+        thread_local RowWorkers workers;
+        return workers;
+    }
+
+    // body(part) для part = 0..parts-1, все части одновременно (часть 0 - в вызывающем
+    // потоке), поэтому части могут ждать друг друга, как в конвейере диффузии ошибки
+    template <typename Body>
+    void run(int parts, Body &body) {
+        if (parts <= 1) {
+            body(0);
+            return;
+        }
+        dispatch(parts, [](void *ctx, int part) { (*static_cast<Body *>(ctx))(part); }, &body);
+    }
+
+private:
+    void dispatch(int parts, void (*fn)(void *, int), void *ctx) {
+        while (static_cast<int>(m_threads.size()) < parts - 1) {
+            const int id = static_cast<int>(m_threads.size()) + 1;
+            m_threads.emplace_back([this, id]() { loop(id); });
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_fn = fn;
+            m_ctx = ctx;
+            m_parts = parts;
+            m_pending = parts - 1;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+        fn(ctx, 0);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this]() { return m_pending == 0; });
+    }
+
+    // Помощник id берёт каждое новое задание, в котором не меньше id + 1 частей
+    void loop(int id) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [&]() { return m_quit || m_generation != seen; });
+            if (m_quit)
+                return;
+            seen = m_generation;
+            if (id >= m_parts)
+                continue;
+            void (*fn)(void *, int) = m_fn;
+            void *ctx = m_ctx;
+            lock.unlock();
+            fn(ctx, id);
+            lock.lock();
+            if (--m_pending == 0)
+                m_idle.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    void (*m_fn)(void *, int) = nullptr;
+    void *m_ctx = nullptr;
+    int m_parts = 0;
+    int m_pending = 0;
+    uint64_t m_generation = 0;
+    bool m_quit = false;
+};
+
+// Предел частей для кадров текущего потока: 0 - по числу ядер. Пул, который сам
+// раздаёт ядра между заданиями (демон каталогов), ставит своим потокам меньший предел
+inline int &rowPartsLimit() {
+    thread_local int limit = 0;
+    return limit;
+}
+
+// Предел частей на время области с восстановлением прежнего при выходе
+class RowPartsLimitScope {
+public:
+    explicit RowPartsLimitScope(int limit) : m_saved(rowPartsLimit()) { rowPartsLimit() = limit; }
+    ~RowPartsLimitScope() { rowPartsLimit() = m_saved; }
+
+    RowPartsLimitScope(const RowPartsLimitScope &) = delete;
+    RowPartsLimitScope &operator=(const RowPartsLimitScope &) = delete;
+
+private:
+    int m_saved;
+};
+
+// Сколько частей выделить кадру rows x cols
+inline int rowParts(int rows, int cols) {
+    if (static_cast<long>(rows) * cols < kParallelCells)
+        return 1;
+    static const int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const int limit = rowPartsLimit() > 0 ? rowPartsLimit() : hardware;
+    return std::max(1, std::min({limit, rows, 8}));
+}
+
+// Строка яркостей потока: растёт до наибольшей ширины кадра и дальше переиспользуется
+inline uint16_t *lumScratch(int cols) {
+    thread_local std::vector<uint16_t> lum;
+    if (lum.size() < static_cast<size_t>(cols))
+        lum.resize(static_cast<size_t>(cols));
+    return lum.data();
+}
+
+// Плоскость float для диффузии ошибки: своя у потока для каждого числа каналов,
+// пересоздаётся только при смене размера кадра
+inline cv::Mat &ditherPlane(int rows, int cols, int channels) {
+    thread_local cv::Mat planes[4];
+    cv::Mat &plane = planes[channels];
+    plane.create(rows, cols, CV_MAKETYPE(CV_32F, channels));
+    return plane;
+}
+
+// Счётчики готовности строк конвейера, по одному на строку; растут вместе с высотой кадра
+inline std::atomic<int> *rowProgress(int rows) {
+    thread_local std::unique_ptr<std::atomic<int>[]> done;
+    thread_local int capacity = 0;
+    if (capacity < rows) {
+        done.reset(new std::atomic<int>[static_cast<size_t>(rows)]);
+        capacity = rows;
+    }
+    for (int y = 0; y < rows; ++y)
+        done[y].store(0, std::memory_order_relaxed);
+    return done.get();
+}
+
+// Диффузия ошибки Флойда-Стейнберга с конвейерной обработкой строк.
+// Строка y обрабатывается частью y % parts; столбец x строки y можно считать,
+// когда строка y-1 завершила столбцы до x+1 включительно. Ошибка вправо по строке
+// переносится в локальной переменной, поэтому строки y и y+1 пишут в разные ячейки.
+// quantize(y, x, c, value) возвращает восстановленное значение выбранного уровня.
+// Каналов не больше трёх
+template <typename Quantizer>
+void floydSteinbergPipelined(cv::Mat &plane, int channels, Quantizer quantize) {
+    const int rows = plane.rows;
+    const int cols = plane.cols;
+    const int kChunk = 32;
+    std::atomic<int> *done = rowProgress(rows);
+
+    auto processRow = [&](int y) {
+        float *cur = plane.ptr<float>(y);
+        float *next = (y + 1 < rows) ? plane.ptr<float>(y + 1) : nullptr;
+        float carry[3] = {0.0f, 0.0f, 0.0f};
+        for (int x0 = 0; x0 < cols; x0 += kChunk) {
+            int x1 = std::min(cols, x0 + kChunk);
+            if (y > 0) {
+                int need = std::min(cols, x1 + 1);
+                while (done[y - 1].load(std::memory_order_acquire) < need)
+                    std::this_thread::yield();
+            }
+            for (int x = x0; x < x1; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    float value = cur[x * channels + c] + carry[c];
+                    float err = value - quantize(y, x, c, value);
+                    carry[c] = err * (7.0f / 16.0f);
+                    if (next) {
+                        if (x > 0)
+                            next[(x - 1) * channels + c] += err * (3.0f / 16.0f);
+                        next[x * channels + c] += err * (5.0f / 16.0f);
+                        if (x + 1 < cols)
+                            next[(x + 1) * channels + c] += err * (1.0f / 16.0f);
+                    }
+                }
+            }
+            done[y].store(x1, std::memory_order_release);
+        }
+    };
+
+    const int parts = rowParts(rows, cols);
+    auto body = [&](int part) {
+        for (int y = part; y < rows; y += parts)
+            processRow(y);
+    };
+    RowWorkers::local().run(parts, body);
+}
+
+// Независимые строки [0, rows) кусками по частям: body(begin, end)
+template <typename Body>
+void forEachRowRange(int rows, int cols, Body body) {
+    const int parts = rowParts(rows, cols);
+    auto part = [&](int index) {
+        body(rows * index / parts, rows * (index + 1) / parts);
+    };
+    RowWorkers::local().run(parts, part);
+}
+
+inline int nearestCubeIndex(float value) {
+    int best = 0;
+    float bestDist = std::abs(value - kCubeLevels[0]);
+    for (int i = 1; i < 6; ++i) {
+        float d = std::abs(value - kCubeLevels[i]);
+        if (d < bestDist) {
+            bestDist = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Индекс уровня куба для канала 0..255 с порогом t в [0, 1)
+inline int cubeIndexWithThreshold(int value, float t) {
+    int lo = 0;
+    while (lo < 4 && kCubeLevels[lo + 1] <= value)
+        ++lo;
+    float span = static_cast<float>(kCubeLevels[lo + 1] - kCubeLevels[lo]);
+    float frac = (value - kCubeLevels[lo]) / span;
+    return frac + t >= 1.0f ? lo + 1 : lo;
+}
+
+} // namespace ascii_detail
+
+// Преобразование уже уменьшенного BGR-изображения (одна ячейка на пиксель) в индексы символов
+inline void mapGlyphs(const cv::Mat &resized, int levels, DitherMode dither, std::vector<uint8_t> &glyphs) {
+    using namespace ascii_detail;
+    const int rows = resized.rows;
+    const int cols = resized.cols;
+    const uint32_t maxLevel = static_cast<uint32_t>(std::max(1, std::min(levels, 256)) - 1);
+    glyphs.resize(static_cast<size_t>(rows) * cols);
+
+    if (dither == DitherMode::FloydSteinberg) {
+        cv::Mat &plane = ditherPlane(rows, cols, 1);
+        uint16_t *lum = lumScratch(cols);
+        for (int y = 0; y < rows; ++y) {
+            luminanceRow(resized.ptr<uint8_t>(y), lum, cols);
+            float *dst = plane.ptr<float>(y);
+            for (int x = 0; x < cols; ++x)
+                dst[x] = static_cast<float>(lum[x]) * maxLevel / kLumScale;
+        }
+        floydSteinbergPipelined(plane, 1, [&](int y, int x, int, float value) {
+            int q = static_cast<int>(std::lround(value));
+            q = std::max(0, std::min(q, static_cast<int>(maxLevel)));
+            glyphs[static_cast<size_t>(y) * cols + x] = static_cast<uint8_t>(q);
+            return static_cast<float>(q);
+        });
+        return;
+    }
+
+    // Без дизеринга и Байер: строки независимы, большие кадры делятся между помощниками
+    const bool ordered = dither == DitherMode::Ordered;
+    forEachRowRange(rows, cols, [&](int begin, int end) {
+        uint16_t *lum = lumScratch(cols);
+        uint32_t thr[8];
+        for (int y = begin; y < end; ++y) {
+            luminanceRow(resized.ptr<uint8_t>(y), lum, cols);
+            if (ordered)
+                bayerThresholds(y, thr);
+            quantizeRow(lum, glyphs.data() + static_cast<size_t>(y) * cols, cols, maxLevel,
+                        ordered ? thr : nullptr);
+        }
+    });
+}
+
+// Конвертация кадра: уменьшение до desiredWidth столбцов и выбор символов
+inline void convertFrame(const cv::Mat &img, int desiredWidth, int levels, DitherMode dither, AsciiFrame &out) {
+    int newH = asciiRowsFor(img.cols, img.rows, desiredWidth);
+    cv::resize(img, out.colors, cv::Size(desiredWidth, newH));
+    out.cols = desiredWidth;
+    out.rows = newH;
+    mapGlyphs(out.colors, levels, dither, out.glyphs);
+}
+
+// Квантование цветов ячеек в палитру xterm-256 (куб 6x6x6, индексы 16..231)
+// с теми же режимами дизеринга, что и для символов
+inline void quantizeAnsi256(const cv::Mat &colors, DitherMode dither, std::vector<uint8_t> &indices) {
+    using namespace ascii_detail;
+    const int rows = colors.rows;
+    const int cols = colors.cols;
+    indices.assign(static_cast<size_t>(rows) * cols, 16);
+
+    if (dither == DitherMode::FloydSteinberg) {
+        cv::Mat &plane = ditherPlane(rows, cols, 3);
+        for (int y = 0; y < rows; ++y) {
+            const uint8_t *src = colors.ptr<uint8_t>(y);
+            float *dst = plane.ptr<float>(y);
+            for (int i = 0; i < cols * 3; ++i)
+                dst[i] = src[i];
+        }
+        // Каналы BGR: вес в индексе куба 1 (B), 6 (G), 36 (R)
+        static const int kWeight[3] = {1, 6, 36};
+        floydSteinbergPipelined(plane, 3, [&](int y, int x, int c, float value) {
+            int q = nearestCubeIndex(value);
+            uint8_t &idx = indices[static_cast<size_t>(y) * cols + x];
+            if (c == 0)
+                idx = 16;
+            idx = static_cast<uint8_t>(idx + q * kWeight[c]);
+            return static_cast<float>(kCubeLevels[q]);
+        });
+        return;
+    }
+
+    const bool ordered = dither == DitherMode::Ordered;
+    forEachRowRange(rows, cols, [&](int begin, int end) {
+        for (int y = begin; y < end; ++y) {
+            const uint8_t *src = colors.ptr<uint8_t>(y);
+            uint8_t *dst = indices.data() + static_cast<size_t>(y) * cols;
+            for (int x = 0; x < cols; ++x) {
+                int b, g, r;
+                if (ordered) {
+                    float t = (kBayer8[y & 7][x & 7] + 0.5f) / 64.0f;
+                    b = cubeIndexWithThreshold(src[3 * x], t);
+                    g = cubeIndexWithThreshold(src[3 * x + 1], t);
+                    r = cubeIndexWithThreshold(src[3 * x + 2], t);
+                } else {
+                    b = nearestCubeIndex(src[3 * x]);
+                    g = nearestCubeIndex(src[3 * x + 1]);
+                    r = nearestCubeIndex(src[3 * x + 2]);
+                }
+                dst[x] = static_cast<uint8_t>(16 + 36 * r + 6 * g + b);
+            }
+        }
+    });
+}
+
+// Цвет (BGR) элемента куба xterm-256
+inline cv::Vec3b ansi256ToBgr(uint8_t index) {
+    int i = std::max(0, static_cast<int>(index) - 16);
+    return cv::Vec3b(ascii_detail::kCubeLevels[i % 6], ascii_detail::kCubeLevels[(i / 6) % 6],
+                     ascii_detail::kCubeLevels[(i / 36) % 6]);
+}
+
+// Параметры временной стабилизации кадров видео
+struct StabilizerOptions {
+    double levelThreshold = 0.5;  // мёртвая зона яркости в долях шага между уровнями символов
+    int colorThreshold = 12;      // мёртвая зона цвета: наибольшая разница канала (0..255)
+    double blockMotion = 0.35;    // доля сдвинувшихся ячеек блока 8x4, при которой блок обновляется целиком
+    double sceneCut = 0.6;        // доля по всему кадру, при которой кадр принимается без фильтрации
+};
+
+// Временная стабилизация: ячейка меняет символ, только если её яркость ушла от яркости,
+// при которой символ был выбран, дальше мёртвой зоны, а цвет - только если канал
+// сместился больше порога. Так шум сенсора и артефакты сжатия у границы уровней не
+// переключают соседние символы каждый кадр. Блоки, где сдвинулась заметная доля ячеек
+// (движение), и кадры со сменой сцены принимаются целиком, чтобы не оставлять следов.
+// Состояние - 6 байт на ячейку
+class TemporalStabilizer {
+public:
+    TemporalStabilizer() = default;
+    explicit TemporalStabilizer(StabilizerOptions opts) : m_opts(opts) {}
+
+    const StabilizerOptions &options() const { return m_opts; }
+
+    // Забыть историю: следующий кадр будет принят как есть (например, после перемотки)
+    void reset() {
+        m_cols = m_rows = 0;
+        m_cells.clear();
+    }
+
+    // Стабилизация кадра на месте; levels - число символов набора, которым кадр построен.
+    // Кадр другого размера сбрасывает историю
+    void apply(AsciiFrame &frame, int levels) {
+        using namespace ascii_detail;
+        const int cols = frame.cols;
+        const int rows = frame.rows;
+        const size_t count = static_cast<size_t>(rows) * cols;
+        if (count == 0 || frame.glyphs.size() != count)
+            return;
+        const bool fresh = cols != m_cols || rows != m_rows;
+        if (fresh) {
+            m_cols = cols;
+            m_rows = rows;
+            m_cells.resize(count);
+        }
+
+        // Первый проход: яркость ячеек и какие из них вышли за мёртвые зоны
+        const uint32_t maxLevel = static_cast<uint32_t>(std::max(2, std::min(levels, 256)) - 1);
+        const int deadLum = static_cast<int>(m_opts.levelThreshold * kLumScale / maxLevel);
+        const int tilesX = (cols + kTileW - 1) / kTileW;
+        const int tilesY = (rows + kTileH - 1) / kTileH;
+        m_lum.resize(count);
+        m_moved.resize(count);
+        m_tileMoved.assign(static_cast<size_t>(tilesX) * tilesY, 0);
+        size_t moved = 0, raw = 0;
+        for (int y = 0; y < rows; ++y) {
+            const uint8_t *bgr = frame.colors.ptr<uint8_t>(y);
+            const size_t base = static_cast<size_t>(y) * cols;
+            luminanceRow(bgr, m_lum.data() + base, cols);
+            if (fresh)
+                continue;
+            uint16_t *tileRow = m_tileMoved.data() + static_cast<size_t>(y / kTileH) * tilesX;
+            for (int x = 0; x < cols; ++x) {
+                const Cell &c = m_cells[base + x];
+                const uint8_t glyph = frame.glyphs[base + x];
+                const int colorDelta = std::max({std::abs(bgr[3 * x] - c.bgr[0]), std::abs(bgr[3 * x + 1] - c.bgr[1]),
+                                                 std::abs(bgr[3 * x + 2] - c.bgr[2])});
+                const bool glyphMoved = glyph != c.glyph && std::abs(m_lum[base + x] - c.lum) > deadLum;
+                const bool colorMoved = colorDelta > m_opts.colorThreshold;
+                m_moved[base + x] = static_cast<uint8_t>((glyphMoved ? kGlyphMoved : 0) | (colorMoved ? kColorMoved : 0));
+                raw += glyph != c.glyph || colorDelta != 0;
+                if (glyphMoved || colorMoved) {
+                    ++moved;
+                    ++tileRow[x / kTileW];
+                }
+            }
+        }
+
+        if (fresh || moved >= m_opts.sceneCut * count) {
+            // Первый кадр или смена сцены: принимается целиком
+            for (int y = 0; y < rows; ++y) {
+                const uint8_t *bgr = frame.colors.ptr<uint8_t>(y);
+                const size_t base = static_cast<size_t>(y) * cols;
+                for (int x = 0; x < cols; ++x)
+                    store(m_cells[base + x], frame.glyphs[base + x], m_lum[base + x], bgr + 3 * x);
+            }
+            m_changedRatio = m_rawRatio = fresh ? 1.0 : static_cast<double>(raw) / count;
+            if (!fresh) {
+                // Кадр без истории не учитывается в средних: сравнивать не с чем
+                ++m_frames;
+                ++m_resets;
+                m_changedSum += m_changedRatio;
+                m_rawSum += m_rawRatio;
+            }
+            return;
+        }
+
+        // Второй проход: в блоках с движением ячейки берутся из кадра, в остальных
+        // сдвинувшиеся ячейки обновляются, а прочие сохраняют прежний символ и цвет
+        const int tileCells = kTileW * kTileH;
+        size_t changed = 0;
+        for (int y = 0; y < rows; ++y) {
+            uint8_t *bgr = frame.colors.ptr<uint8_t>(y);
+            const size_t base = static_cast<size_t>(y) * cols;
+            const uint16_t *tileRow = m_tileMoved.data() + static_cast<size_t>(y / kTileH) * tilesX;
+            for (int x = 0; x < cols; ++x) {
+                Cell &c = m_cells[base + x];
+                uint8_t &glyph = frame.glyphs[base + x];
+                uint8_t *px = bgr + 3 * x;
+                const bool motion = tileRow[x / kTileW] >= m_opts.blockMotion * tileCells;
+                const uint8_t flags = motion ? (kGlyphMoved | kColorMoved) : m_moved[base + x];
+                bool differs = false;
+                if (flags & kGlyphMoved) {
+                    differs = glyph != c.glyph;
+                    c.glyph = glyph;
+                    c.lum = m_lum[base + x];
+                } else {
+                    glyph = c.glyph;
+                }
+                if (flags & kColorMoved) {
+                    differs = differs || px[0] != c.bgr[0] || px[1] != c.bgr[1] || px[2] != c.bgr[2];
+                    c.bgr[0] = px[0];
+                    c.bgr[1] = px[1];
+                    c.bgr[2] = px[2];
+                } else {
+                    px[0] = c.bgr[0];
+                    px[1] = c.bgr[1];
+                    px[2] = c.bgr[2];
+                }
+                changed += differs;
+            }
+        }
+        m_changedRatio = static_cast<double>(changed) / count;
+        m_rawRatio = static_cast<double>(raw) / count;
+        ++m_frames;
+        m_changedSum += m_changedRatio;
+        m_rawSum += m_rawRatio;
+    }
+
+    // Доля ячеек, изменившихся в последнем кадре после стабилизации и без неё
+    double changedRatio() const { return m_changedRatio; }
+    double rawChangedRatio() const { return m_rawRatio; }
+
+    // Средние доли по всем кадрам, у которых была история
+    double averageChangedRatio() const { return m_frames ? m_changedSum / m_frames : 0.0; }
+    double averageRawChangedRatio() const { return m_frames ? m_rawSum / m_frames : 0.0; }
+    uint64_t frames() const { return m_frames; }
+    uint64_t sceneResets() const { return m_resets; }
+
+private:
+    static const int kTileW = 8;
+    static const int kTileH = 4;
+    static const uint8_t kGlyphMoved = 1;
+    static const uint8_t kColorMoved = 2;
+
+    // Показанное состояние ячейки и яркость, при которой выбран её символ
+    struct Cell {
+        uint16_t lum;
+        uint8_t glyph;
+        uint8_t bgr[3];
+    };
+    static_assert(sizeof(Cell) == 6, "состояние ячейки должно оставаться компактным");
+
+    static void store(Cell &c, uint8_t glyph, uint16_t lum, const uint8_t *bgr) {
+        c.lum = lum;
+        c.glyph = glyph;
+        c.bgr[0] = bgr[0];
+        c.bgr[1] = bgr[1];
+        c.bgr[2] = bgr[2];
+    }
+
+    StabilizerOptions m_opts;
+    int m_cols = 0;
+    int m_rows = 0;
+    std::vector<Cell> m_cells;
+    std::vector<uint16_t> m_lum;        // яркость текущего кадра
+    std::vector<uint8_t> m_moved;       // флаги kGlyphMoved/kColorMoved текущего кадра
+    std::vector<uint16_t> m_tileMoved;  // число сдвинувшихся ячеек в блоках
+    double m_changedRatio = 0.0;
+    double m_rawRatio = 0.0;
+    double m_changedSum = 0.0;
+    double m_rawSum = 0.0;
+    uint64_t m_frames = 0;
+    uint64_t m_resets = 0;
+};
+
+#endif // ASCII_CORE_H
@@ -0,0 +1,298 @@
+// ascii_python.cpp
+// Модуль Python asciiart_native (pybind11) для main.py: конвертация кадров, пакетная
+// предобработка видео и сериализаторы из того же ядра, что и у C++-приложения.
+// Изображения NumPy (HxWx3 uint8, BGR) оборачиваются в cv::Mat без копирования,
+// массивы glyphs/colors кадра ссылаются на его память. На время работы ядра GIL отпущен
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ascii_core.h"
+#include "ansi_export.h"
+#include "html_export.h"
+#include "image_loader.h"
+#include "segment_preprocess.h"
+
+namespace py = pybind11;
+
+namespace {
+
+// C-непрерывный массив uint8; другие массивы pybind11 приводит к нему (с копией только при необходимости)
+using ImageArray = py::array_t<uint8_t, py::array::c_style | py::array::forcecast>;
+
+cv::Mat matFromArray(const ImageArray &image) {
+    if (image.ndim() != 3 || image.shape(2) != 3)
+        throw py::value_error("ожидается изображение HxWx3 uint8 (BGR)");
+    if (image.shape(0) < 1 || image.shape(1) < 1)
+        throw py::value_error("пустое изображение");
+    return cv::Mat(static_cast<int>(image.shape(0)), static_cast<int>(image.shape(1)), CV_8UC3,
+                   const_cast<uint8_t *>(image.data()), static_cast<size_t>(image.strides(0)));
+}
+
+void checkConvertArgs(int width, int levels) {
+    if (width < 1)
+        throw py::value_error("ширина должна быть положительной");
+    if (levels < 2 || levels > 256)
+        throw py::value_error("в наборе должно быть от 2 до 256 символов");
+}
+
+DitherMode ditherArg(const std::string &name) {
+    DitherMode mode = DitherMode::None;
+    if (!ditherModeFromString(name, mode))
+        throw py::value_error("неизвестный дизеринг '" + name + "' (none, ordered или fs)");
+    return mode;
+}
+
+ColorDepth colorDepthFromString(const std::string &name) {
+    if (name == "256")
+        return ColorDepth::Ansi256;
+    if (name == "mono")
+        return ColorDepth::Mono;
+    return ColorDepth::TrueColor;
+}
+
+// Текст кадра для QTextEdit: как frameToText в main.cpp
+std::string frameText(const AsciiFrame &frame, const std::vector<std::string> &glyphs, bool blackWhite) {
+    if (blackWhite) {
+        std::string text = asciiFrameToPlain(frame, glyphs);
+        if (!text.empty())
+            text.pop_back();
+        return text;
+    }
+    HtmlOptions opts;
+    opts.lineBreak = "<br>";
+    return asciiFrameToHtmlBody(frame, glyphs, opts);
+}
+
+// Предобработка видео или GIF целиком, аналог PreprocessingThread: длинное видео делится
+// на отрезки со своими декодерами (decoders: 0 - по числу ядер, 1 - последовательно).
+// stop() можно вызывать из другого потока Python, пока выполняется run()
+class VideoPreprocessor {
+public:
+    VideoPreprocessor(std::string path, int width, const std::string &charset, const std::string &dither,
+                      bool blackWhite, bool stabilize, int decoders)
+        : m_path(std::move(path)), m_width(width), m_glyphs(glyphTableFromUtf8(charset)),
+          m_dither(ditherArg(dither)), m_blackWhite(blackWhite), m_stabilize(stabilize),
+          m_decoders(decoders) {
+        checkConvertArgs(m_width, static_cast<int>(m_glyphs.size()));
+    }
+
+    void stop() { m_stop = true; }
+
+    // Итоги последнего run(): средние доли изменившихся ячеек (со стабилизацией и без неё),
+    // метки времени кадров (мс) и число декодеров
+    double changedRatio() const { return m_result.changedRatio; }
+    double rawChangedRatio() const { return m_result.rawChangedRatio; }
+    const std::vector<double> &timestamps() const { return m_result.ptsMs; }
+    int decoders() const { return m_result.segments; }
+
+    // Возвращает (кадры, fps). as_text=True - тексты кадров для показа, иначе объекты Frame.
+    // progress(processed, total) вызывается по мере готовности, если известна длина
+    py::tuple run(const py::object &progress, bool asText) {
+        std::vector<std::string> texts;
+        std::vector<std::shared_ptr<AsciiFrame>> frames;
+        {
+            py::gil_scoped_release release;
+            SegmentPreprocessOptions opts;
+            opts.width = m_width;
+            opts.levels = static_cast<int>(m_glyphs.size());
+            opts.dither = m_dither;
+            opts.segments = m_decoders;
+            opts.stabilize = m_stabilize;
+            SegmentedPreprocessor job(m_path, opts);
+            // Отрезки сдают кадры не по порядку, текст строится в их потоках
+            std::mutex mutex;
+            m_result = job.run(
+                [&](size_t index, AsciiFrame &&frame) {
+                    auto shared = std::make_shared<AsciiFrame>(std::move(frame));
+                    std::string text;
+                    if (asText)
+                        text = frameText(*shared, m_glyphs, m_blackWhite);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (asText) {
+                        if (index >= texts.size())
+                            texts.resize(index + 1);
+                        texts[index] = std::move(text);
+                    } else {
+                        if (index >= frames.size())
+                            frames.resize(index + 1);
+                        frames[index] = std::move(shared);
+                    }
+                },
+                [&](size_t done, size_t total) {
+                    if (total > 0 && !progress.is_none()) {
+                        py::gil_scoped_acquire acquire;
+                        progress(std::min(done, total), total);
+                    }
+                },
+                [this]() { return m_stop.load(); });
+            texts.resize(std::min(texts.size(), m_result.frames));
+            frames.resize(std::min(frames.size(), m_result.frames));
+        }
+        py::list result;
+        if (asText) {
+            for (const std::string &text : texts)
+                result.append(py::str(text));
+        } else {
+            for (auto &frame : frames)
+                result.append(py::cast(frame));
+        }
+        return py::make_tuple(result, m_result.opened ? m_result.fps : 0.0);
+    }
+
+private:
+    std::string m_path;
+    int m_width;
+    std::vector<std::string> m_glyphs;
+    DitherMode m_dither;
+    bool m_blackWhite;
+    bool m_stabilize;
+    int m_decoders;
+    SegmentPreprocessResult m_result;
+    std::atomic<bool> m_stop{false};
+};
+
+} // namespace
+
+PYBIND11_MODULE(asciiart_native, m) {
+    m.doc() = "Конвертация изображений и видео в ASCII-арт (C++-ядро AsciiArtConverter)";
+
+    py::class_<AsciiFrame, std::shared_ptr<AsciiFrame>>(m, "Frame")
+        .def_readonly("cols", &AsciiFrame::cols)
+        .def_readonly("rows", &AsciiFrame::rows)
+        // Индексы символов rows x cols; массив держит ссылку на кадр
+        .def_property_readonly("glyphs", [](py::object self) {
+            AsciiFrame &f = self.cast<AsciiFrame &>();
+            return py::array_t<uint8_t>({f.rows, f.cols}, {f.cols, 1}, f.glyphs.data(), self);
+        })
+        // Цвета ячеек rows x cols x 3 (BGR)
+        .def_property_readonly("colors", [](py::object self) {
+            AsciiFrame &f = self.cast<AsciiFrame &>();
+            return py::array_t<uint8_t>({f.rows, f.cols, 3},
+                                        {static_cast<py::ssize_t>(f.colors.step[0]), py::ssize_t(3), py::ssize_t(1)},
+                                        f.colors.data, self);
+        })
+        .def("__repr__", [](const AsciiFrame &f) {
+            return "<asciiart_native.Frame " + std::to_string(f.cols) + "x" + std::to_string(f.rows) + ">";
+        });
+
+    m.def("rows_for", &asciiRowsFor, py::arg("src_cols"), py::arg("src_rows"), py::arg("width"),
+          "Число строк ASCII-кадра для изображения src_cols x src_rows при ширине width");
+
+    m.def("load_image", [](const std::string &path, int width) -> py::object {
+        auto image = std::make_shared<cv::Mat>();
+        {
+            py::gil_scoped_release release;
+            *image = loadImageForAscii(path, width);
+        }
+        if (image->empty())
+            return py::none();
+        // Массив ссылается на память Mat, капсула держит её до удаления массива
+        py::capsule owner(new std::shared_ptr<cv::Mat>(image),
+                          [](void *p) { delete static_cast<std::shared_ptr<cv::Mat> *>(p); });
+        return py::array_t<uint8_t>({image->rows, image->cols, 3},
+                                    {static_cast<py::ssize_t>(image->step[0]), py::ssize_t(3), py::ssize_t(1)},
+                                    image->data, owner);
+    }, py::arg("path"), py::arg("width") = 0,
+       "Загрузка BGR-изображения в разрешении, достаточном для ширины width (0 - полное); None при ошибке");
+
+    m.def("convert_frame", [](const ImageArray &image, int width, int levels, const std::string &dither) {
+        checkConvertArgs(width, levels);
+        cv::Mat img = matFromArray(image);
+        auto frame = std::make_shared<AsciiFrame>();
+        const DitherMode mode = ditherArg(dither);
+        {
+            py::gil_scoped_release release;
+            convertFrame(img, width, levels, mode, *frame);
+        }
+        return frame;
+    }, py::arg("image"), py::arg("width"), py::arg("levels"), py::arg("dither") = "none",
+       "Конвертация BGR-изображения (HxWx3 uint8) в кадр шириной width символов");
+
+    m.def("to_plain", [](const AsciiFrame &frame, const std::string &charset) {
+        std::string out;
+        {
+            py::gil_scoped_release release;
+            out = asciiFrameToPlain(frame, glyphTableFromUtf8(charset));
+        }
+        return out;
+    }, py::arg("frame"), py::arg("charset"), "Текст кадра без цвета, строки заканчиваются '\\n'");
+
+    m.def("to_ansi", [](const AsciiFrame &frame, const std::string &charset, const std::string &colors,
+                        const std::string &dither) {
+        const DitherMode mode = ditherArg(dither);
+        std::string out;
+        {
+            py::gil_scoped_release release;
+            out = asciiFrameToAnsi(frame, glyphTableFromUtf8(charset), colorDepthFromString(colors), mode);
+        }
+        return out;
+    }, py::arg("frame"), py::arg("charset"), py::arg("colors") = "truecolor", py::arg("dither") = "none",
+       "Текст кадра с ANSI-цветами (colors: truecolor, 256 или mono)");
+
+    m.def("to_html_body", [](const AsciiFrame &frame, const std::string &charset, bool blackWhite,
+                             const std::string &lineBreak) {
+        std::string out;
+        {
+            py::gil_scoped_release release;
+            HtmlOptions opts;
+            opts.blackWhite = blackWhite;
+            opts.lineBreak = lineBreak.c_str();
+            out = asciiFrameToHtmlBody(frame, glyphTableFromUtf8(charset), opts);
+        }
+        return out;
+    }, py::arg("frame"), py::arg("charset"), py::arg("black_white") = false, py::arg("line_break") = "<br>",
+       "HTML-фрагмент кадра с цветными span");
+
+    m.def("frame_text", [](const AsciiFrame &frame, const std::string &charset, bool blackWhite) {
+        std::string out;
+        {
+            py::gil_scoped_release release;
+            out = frameText(frame, glyphTableFromUtf8(charset), blackWhite);
+        }
+        return out;
+    }, py::arg("frame"), py::arg("charset"), py::arg("black_white") = false,
+       "Текст кадра для QTextEdit: простой текст или HTML с <br>");
+
+    py::class_<TemporalStabilizer>(m, "Stabilizer",
+                                   "Временная стабилизация кадров видео: подавляет дрожание символов и цветов")
+        .def(py::init([](double levelThreshold, int colorThreshold) {
+                 StabilizerOptions opts;
+                 opts.levelThreshold = levelThreshold;
+                 opts.colorThreshold = colorThreshold;
+                 return TemporalStabilizer(opts);
+             }),
+             py::arg("level_threshold") = 0.5, py::arg("color_threshold") = 12)
+        .def("apply", [](TemporalStabilizer &self, AsciiFrame &frame, int levels) {
+            py::gil_scoped_release release;
+            self.apply(frame, levels);
+        }, py::arg("frame"), py::arg("levels"), "Стабилизация кадра на месте")
+        .def("reset", &TemporalStabilizer::reset)
+        .def_property_readonly("changed_ratio", &TemporalStabilizer::changedRatio)
+        .def_property_readonly("raw_changed_ratio", &TemporalStabilizer::rawChangedRatio)
+        .def_property_readonly("average_changed_ratio", &TemporalStabilizer::averageChangedRatio)
+        .def_property_readonly("average_raw_changed_ratio", &TemporalStabilizer::averageRawChangedRatio);
+
+    py::class_<VideoPreprocessor>(m, "VideoPreprocessor")
+        .def(py::init<std::string, int, const std::string &, const std::string &, bool, bool, int>(),
+             py::arg("path"), py::arg("width"), py::arg("charset"), py::arg("dither") = "none",
+             py::arg("black_white") = false, py::arg("stabilize") = false, py::arg("decoders") = 0)
+        .def("run", &VideoPreprocessor::run, py::arg("progress") = py::none(), py::arg("as_text") = true,
+             "Конвертация всех кадров; возвращает (кадры, fps)")
+        .def("stop", &VideoPreprocessor::stop, "Прервать run() из другого потока")
+        .def_property_readonly("changed_ratio", &VideoPreprocessor::changedRatio)
+        .def_property_readonly("raw_changed_ratio", &VideoPreprocessor::rawChangedRatio)
+        .def_property_readonly("timestamps", &VideoPreprocessor::timestamps, "Метки времени кадров, мс")
+        .def_property_readonly("decoders", &VideoPreprocessor::decoders, "Сколько декодеров работало");
+}
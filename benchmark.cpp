@@ -0,0 +1,900 @@
+// benchmark.cpp
+// Сквозной замер производительности: генерирует детерминированный набор изображений,
+// видео и GIF (синтетические узоры с разной степенью движения), прогоняет конвертацию
+// изображений, предобработку видео, отрисовку для терминала и экспорт (HTML-плеер, asciinema, GIF)
+// и выводит для каждого прогона кадры/с, время до первого кадра, пиковый RSS, объём
+// вывода и хеш результата в JSON. С --baseline сравнивает с сохранённым прогоном.
+// --alloc-check вместо замеров считает выделения памяти на кадр после прогрева
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define ASCII_ALLOC_COUNTER_IMPLEMENT
+#include "alloc_counter.h"
+#include "ascii_core.h"
+#include "ansi_export.h"
+#include "html_export.h"
+#include "html_player.h"
+#include "gif_encoder.h"
+#include "image_loader.h"
+#include "segment_preprocess.h"
+#include "terminal_export.h"
+#include "rendition_ladder.h"
+
+using namespace std;
+
+// ---- Измерения ----
+
+// Пиковый RSS процесса в КБ. В Linux пик сбрасывается перед каждым прогоном
+// (clear_refs), поэтому значение относится к одному прогону
+static long long peakRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return static_cast<long long>(pmc.PeakWorkingSetSize / 1024);
+    return 0;
+#else
+    ifstream status("/proc/self/status");
+    string line;
+    while (getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0)
+            return atoll(line.c_str() + 6);
+    }
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static void resetPeakRss() {
+#ifdef __linux__
+    ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+// FNV-1a 64 - хеш вывода для проверки, что оптимизация не изменила результат
+struct Hasher {
+    uint64_t value = 1469598103934665603ull;
+    void add(const void *data, size_t size) {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            value ^= p[i];
+            value *= 1099511628211ull;
+        }
+    }
+    void add(const string &s) { add(s.data(), s.size()); }
+    void add(const AsciiFrame &frame) {
+        add(frame.glyphs.data(), frame.glyphs.size());
+        for (int row = 0; row < frame.rows; ++row)
+            add(frame.colors.ptr<uint8_t>(row), static_cast<size_t>(frame.cols) * 3);
+    }
+    string hex() const {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(value));
+        return buf;
+    }
+};
+
+struct RunResult {
+    string name;
+    long long frames = 0;
+    double seconds = 0.0;
+    double firstFrameMs = 0.0;
+    long long peakRssKb = 0;
+    long long bytes = 0;
+    string hash;
+    double changedCells = -1.0;   // средняя доля изменившихся ячеек (только дельта-прогоны)
+
+    double fps() const { return seconds > 0 ? frames / seconds : 0.0; }
+};
+
+class Stopwatch {
+public:
+    Stopwatch() : m_start(chrono::steady_clock::now()) {}
+    double ms() const { return chrono::duration<double, milli>(chrono::steady_clock::now() - m_start).count(); }
+
+private:
+    chrono::steady_clock::time_point m_start;
+};
+
+// ---- Генерация набора ----
+
+enum class Motion { Static, Low, High };
+
+static const char *motionName(Motion m) {
+    return m == Motion::Static ? "static" : m == Motion::Low ? "low" : "high";
+}
+
+static uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// Синтетический кадр: диагональный градиент, движущийся круг и (для высокой
+// степени движения) шумовые блоки 16x16, меняющиеся каждый кадр. Пиксели считаются
+// целочисленно, поэтому набор одинаков на всех платформах и версиях OpenCV
+static void synthFrame(int w, int h, int t, Motion motion, cv::Mat &out) {
+    out.create(h, w, CV_8UC3);
+    const int shift = motion == Motion::Static ? 0 : motion == Motion::Low ? t : t * 7;
+    const int cx = motion == Motion::Static ? w / 2 : (w / 4 + t * (motion == Motion::Low ? 2 : 9)) % w;
+    const int cy = h / 2;
+    const int radius = min(w, h) / 5;
+    for (int y = 0; y < h; ++y) {
+        uint8_t *row = out.ptr<uint8_t>(y);
+        for (int x = 0; x < w; ++x) {
+            uint8_t *px = row + x * 3;
+            px[0] = static_cast<uint8_t>(((x + shift) * 255) / max(1, w));
+            px[1] = static_cast<uint8_t>((y * 255) / max(1, h));
+            px[2] = static_cast<uint8_t>(((x + y + shift) * 127) / max(1, w + h) + 64);
+            const int dx = x - cx, dy = y - cy;
+            if (dx * dx + dy * dy < radius * radius) {
+                px[0] = 40;
+                px[1] = 220;
+                px[2] = 250;
+            }
+            if (motion == Motion::High) {
+                const uint32_t r = mix(static_cast<uint32_t>((x / 16) * 73856093u ^ (y / 16) * 19349663u ^ t * 83492791u));
+                if ((r & 7) == 0) {
+                    px[0] = static_cast<uint8_t>(r >> 8);
+                    px[1] = static_cast<uint8_t>(r >> 16);
+                    px[2] = static_cast<uint8_t>(r >> 24);
+                }
+            }
+        }
+    }
+}
+
+struct CorpusItem {
+    enum Kind { Image, Video } kind;
+    string path;
+};
+
+static bool fileExists(const string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && st.st_size > 0;
+}
+
+static void makeDir(const string &path) {
+#ifdef _WIN32
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+}
+
+static bool writeGif(const string &path, int w, int h, int frames, Motion motion) {
+    vector<cv::Mat> images(frames);
+    GifPaletteBuilder builder;
+    for (int t = 0; t < frames; ++t) {
+        synthFrame(w, h, t, motion, images[t]);
+        builder.add(images[t]);
+    }
+    GifPalette palette = builder.build();
+    GifWriter writer;
+    if (!writer.open(path, w, h, palette))
+        return false;
+    const int minCodeSize = gifMinCodeSize(palette);
+    vector<uint8_t> cur(static_cast<size_t>(w) * h), prev, block;
+    for (int t = 0; t < frames; ++t) {
+        for (int y = 0; y < h; ++y) {
+            const cv::Vec3b *row = images[t].ptr<cv::Vec3b>(y);
+            for (int x = 0; x < w; ++x)
+                cur[static_cast<size_t>(y) * w + x] = palette.indexOf(row[x]);
+        }
+        block.clear();
+        encodeGifFrame(cur.data(), prev.empty() ? nullptr : prev.data(), w, h, palette.transparentIndex(),
+                       minCodeSize, block);
+        writer.addFrame(block, 4);
+        prev = cur;
+    }
+    return writer.close();
+}
+
+// Набор генерируется один раз; существующие файлы не перезаписываются
+static vector<CorpusItem> buildCorpus(const string &dir) {
+    makeDir(dir);
+    vector<CorpusItem> items;
+    cv::Mat frame;
+
+    struct ImageSpec { int w, h; const char *ext; };
+    const ImageSpec images[] = {{640, 480, "png"}, {1920, 1080, "png"}, {1920, 1080, "jpg"}, {6000, 4000, "jpg"}};
+    for (const ImageSpec &spec : images) {
+        const string path = dir + "/image_" + to_string(spec.w) + "x" + to_string(spec.h) + "." + spec.ext;
+        if (!fileExists(path)) {
+            synthFrame(spec.w, spec.h, 0, Motion::Low, frame);
+            cv::imwrite(path, frame, {cv::IMWRITE_JPEG_QUALITY, 90});
+        }
+        items.push_back({CorpusItem::Image, path});
+    }
+
+    struct VideoSpec { int w, h, frames; Motion motion; };
+    const VideoSpec videos[] = {{320, 240, 100, Motion::Low}, {1280, 720, 100, Motion::Static},
+                                {1280, 720, 100, Motion::Low}, {1280, 720, 100, Motion::High},
+                                {1920, 1080, 50, Motion::High}};
+    for (const VideoSpec &spec : videos) {
+        const string path = dir + "/video_" + to_string(spec.w) + "x" + to_string(spec.h) + "_" +
+                            to_string(spec.frames) + "f_" + motionName(spec.motion) + ".avi";
+        if (!fileExists(path)) {
+            cv::VideoWriter writer(path, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 25.0, cv::Size(spec.w, spec.h));
+            if (!writer.isOpened()) {
+                cerr << "Не удалось создать " << path << endl;
+                continue;
+            }
+            for (int t = 0; t < spec.frames; ++t) {
+                synthFrame(spec.w, spec.h, t, spec.motion, frame);
+                writer.write(frame);
+            }
+        }
+        items.push_back({CorpusItem::Video, path});
+    }
+
+    struct GifSpec { int w, h, frames; Motion motion; };
+    const GifSpec gifs[] = {{320, 240, 40, Motion::Low}, {480, 360, 60, Motion::High}};
+    for (const GifSpec &spec : gifs) {
+        const string path = dir + "/gif_" + to_string(spec.w) + "x" + to_string(spec.h) + "_" +
+                            to_string(spec.frames) + "f_" + motionName(spec.motion) + ".gif";
+        if (!fileExists(path) && !writeGif(path, spec.w, spec.h, spec.frames, spec.motion)) {
+            cerr << "Не удалось создать " << path << endl;
+            continue;
+        }
+        items.push_back({CorpusItem::Video, path});
+    }
+    return items;
+}
+
+// ---- Прогоны ----
+
+struct BenchOptions {
+    int width = 120;
+    int iterations = 5;
+    string outputDir;
+    vector<string> glyphs;
+};
+
+static string baseName(const string &path) {
+    const size_t slash = path.find_last_of("/\\");
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+// Изображение: загрузка под ширину, конвертация и ANSI-текст, iterations раз
+static RunResult runImage(const string &path, const BenchOptions &opts) {
+    RunResult r;
+    r.name = "image/" + baseName(path);
+    resetPeakRss();
+    Hasher hash;
+    Stopwatch total;
+    for (int i = 0; i < opts.iterations; ++i) {
+        cv::Mat img = loadImageForAscii(path, opts.width);
+        if (img.empty())
+            break;
+        AsciiFrame frame;
+        convertFrame(img, opts.width, static_cast<int>(opts.glyphs.size()), DitherMode::None, frame);
+        const string text = asciiFrameToAnsi(frame, opts.glyphs, ColorDepth::TrueColor, DitherMode::None);
+        if (i == 0) {
+            r.firstFrameMs = total.ms();
+            hash.add(text);
+            r.bytes = static_cast<long long>(text.size());
+        }
+        ++r.frames;
+    }
+    r.seconds = total.ms() / 1000.0;
+    r.peakRssKb = peakRssKb();
+    r.hash = hash.hex();
+    return r;
+}
+
+// Видео или GIF: декодирование и конвертация всех кадров (как предобработка в приложении)
+static RunResult runPreprocess(const string &path, const BenchOptions &opts, vector<AsciiFrame> &frames, double &fps) {
+    RunResult r;
+    r.name = "preprocess/" + baseName(path);
+    frames.clear();
+    resetPeakRss();
+    Hasher hash;
+    Stopwatch total;
+    cv::VideoCapture cap(path);
+    fps = cap.get(cv::CAP_PROP_FPS);
+    if (fps <= 0) fps = 25.0;
+    cv::Mat image;
+    while (cap.read(image) && !image.empty()) {
+        AsciiFrame frame;
+        convertFrame(image, opts.width, static_cast<int>(opts.glyphs.size()), DitherMode::None, frame);
+        if (frames.empty())
+            r.firstFrameMs = total.ms();
+        hash.add(frame);
+        frames.push_back(move(frame));
+    }
+    r.seconds = total.ms() / 1000.0;
+    r.frames = static_cast<long long>(frames.size());
+    r.peakRssKb = peakRssKb();
+    r.hash = hash.hex();
+    return r;
+}
+
+// Та же предобработка несколькими декодерами по отрезкам (как PreprocessingThread).
+// Хеш должен совпасть с последовательным прогоном: это единственная проверка сшивки
+// отрезков, расхождение - код выхода 5
+static RunResult runPreprocessParallel(const string &path, const BenchOptions &opts) {
+    RunResult r;
+    r.name = "preprocess-parallel/" + baseName(path);
+    resetPeakRss();
+    Stopwatch total;
+    SegmentPreprocessOptions popts;
+    popts.width = opts.width;
+    popts.levels = static_cast<int>(opts.glyphs.size());
+    popts.minSegmentFrames = 25;   // кадров в наборе немного, иначе отрезков не будет
+    vector<AsciiFrame> frames;
+    mutex framesMutex;
+    SegmentedPreprocessor job(path, popts);
+    const SegmentPreprocessResult result = job.run([&](size_t index, AsciiFrame &&frame) {
+        lock_guard<mutex> lock(framesMutex);
+        if (r.firstFrameMs == 0.0)
+            r.firstFrameMs = total.ms();
+        if (index >= frames.size())
+            frames.resize(index + 1);
+        frames[index] = move(frame);
+    });
+    frames.resize(result.frames);
+    r.seconds = total.ms() / 1000.0;
+    r.frames = static_cast<long long>(frames.size());
+    r.peakRssKb = peakRssKb();
+    Hasher hash;
+    for (const AsciiFrame &frame : frames)
+        hash.add(frame);
+    r.hash = hash.hex();
+    return r;
+}
+
+// Лестница из трёх ширин (половина, заданная, двойная) за одно декодирование (console --ladder).
+// Сравнивается с preprocess/ той же записи: цель - немногим дороже одной ширины, а не втрое
+static RunResult runLadder(const string &path, const BenchOptions &opts) {
+    RunResult r;
+    r.name = "ladder/" + baseName(path);
+    resetPeakRss();
+    Hasher hash;
+    Stopwatch total;
+    vector<Rendition> renditions;
+    for (int width : {opts.width / 2, opts.width, opts.width * 2}) {
+        Rendition rendition;
+        rendition.width = width;
+        rendition.glyphs = opts.glyphs;
+        renditions.push_back(move(rendition));
+    }
+    RenditionLadder ladder(move(renditions));
+    cv::VideoCapture cap(path);
+    cv::Mat image;
+    while (cap.read(image) && !image.empty()) {
+        ladder.process(image, 0.0);
+        if (r.frames == 0)
+            r.firstFrameMs = total.ms();
+        for (size_t i = 0; i < ladder.renditions().size(); ++i)
+            hash.add(ladder.frameFor(i));
+        ++r.frames;
+    }
+    r.seconds = total.ms() / 1000.0;
+    r.peakRssKb = peakRssKb();
+    r.hash = hash.hex();
+    return r;
+}
+
+// Отрисовка для терминала: полный ANSI-кадр (как console), дельта (как --serve-tcp)
+// и дельта после временной стабилизации (--stabilize)
+static vector<RunResult> runConsole(const string &path, const vector<AsciiFrame> &frames, const BenchOptions &opts) {
+    static const char *const kModes[] = {"console/", "console-delta/", "console-stable/"};
+    vector<RunResult> results;
+    for (int mode = 0; mode < 3; ++mode) {
+        RunResult r;
+        r.name = kModes[mode] + baseName(path);
+        resetPeakRss();
+        Hasher hash;
+        AnsiDeltaEncoder encoder(opts.glyphs, ColorDepth::TrueColor, DitherMode::None);
+        TemporalStabilizer stabilizer;
+        AsciiFrame stable;
+        string text;
+        double changedSum = 0.0;
+        Stopwatch total;
+        for (const AsciiFrame &frame : frames) {
+            if (mode == 0) {
+                text = asciiFrameToAnsi(frame, opts.glyphs, ColorDepth::TrueColor, DitherMode::None);
+            } else if (mode == 1) {
+                encoder.encode(frame, &text);
+            } else {
+                stable.cols = frame.cols;
+                stable.rows = frame.rows;
+                stable.glyphs = frame.glyphs;
+                frame.colors.copyTo(stable.colors);
+                stabilizer.apply(stable, static_cast<int>(opts.glyphs.size()));
+                encoder.encode(stable, &text);
+            }
+            if (r.frames == 0)
+                r.firstFrameMs = total.ms();
+            else if (mode > 0)
+                changedSum += encoder.changedRatio();
+            r.bytes += static_cast<long long>(text.size());
+            hash.add(text);
+            ++r.frames;
+        }
+        if (mode > 0 && r.frames > 1)
+            r.changedCells = changedSum / (r.frames - 1);
+        r.seconds = total.ms() / 1000.0;
+        r.peakRssKb = peakRssKb();
+        r.hash = hash.hex();
+        results.push_back(r);
+    }
+    return results;
+}
+
+static RunResult runHtmlExport(const string &path, const vector<AsciiFrame> &frames, double fps, const BenchOptions &opts) {
+    RunResult r;
+    r.name = "export-html/" + baseName(path);
+    resetPeakRss();
+    Stopwatch total;
+    HtmlPlayerEncoder encoder(false);
+    for (const AsciiFrame &frame : frames) {
+        encoder.addFrame(frame);
+        if (r.frames++ == 0)
+            r.firstFrameMs = total.ms();
+    }
+    const string doc = encoder.document(opts.glyphs, fps);
+    ofstream(opts.outputDir + "/" + baseName(path) + ".html", ios::binary) << doc;
+    r.seconds = total.ms() / 1000.0;
+    r.bytes = static_cast<long long>(doc.size());
+    r.peakRssKb = peakRssKb();
+    Hasher hash;
+    hash.add(doc);
+    r.hash = hash.hex();
+    return r;
+}
+
+// Запись asciinema: дельты кадров сразу пишутся в файл. Хеш считается без строки
+// заголовка, в которой время создания
+static RunResult runCastExport(const string &path, const vector<AsciiFrame> &frames, double fps, const BenchOptions &opts) {
+    RunResult r;
+    r.name = "export-cast/" + baseName(path);
+    resetPeakRss();
+    Stopwatch total;
+    const string output = opts.outputDir + "/" + baseName(path) + ".cast";
+    TerminalExportWriter::Options wopts;
+    wopts.glyphs = opts.glyphs;
+    wopts.format = TerminalExportFormat::Asciinema;
+    TerminalExportWriter writer(wopts);
+    writer.open(output);
+    for (const AsciiFrame &frame : frames) {
+        writer.addFrame(frame, r.frames / fps);
+        if (r.frames++ == 0)
+            r.firstFrameMs = total.ms();
+    }
+    writer.close(r.frames / fps);
+    r.seconds = total.ms() / 1000.0;
+    r.bytes = static_cast<long long>(writer.bytesWritten());
+    r.peakRssKb = peakRssKb();
+    ifstream in(output, ios::binary);
+    string line;
+    getline(in, line);
+    Hasher hash;
+    while (getline(in, line))
+        hash.add(line);
+    r.hash = hash.hex();
+    return r;
+}
+
+// GIF из цветов ячеек: каждая ячейка - сплошной блок kCell x 2*kCell. Бенчмарк не
+// зависит от Qt, поэтому вместо растеризации шрифта нагружаются палитра, дельты и LZW
+static RunResult runGifExport(const string &path, const vector<AsciiFrame> &frames, double fps, const BenchOptions &opts) {
+    static const int kCell = 4;
+    RunResult r;
+    r.name = "export-gif/" + baseName(path);
+    resetPeakRss();
+    Stopwatch total;
+    if (frames.empty())
+        return r;
+    GifPaletteBuilder builder;
+    for (const AsciiFrame &frame : frames)
+        builder.add(frame.colors);
+    GifPalette palette = builder.build();
+    const int w = frames[0].cols * kCell, h = frames[0].rows * kCell * 2;
+    const string out = opts.outputDir + "/" + baseName(path) + ".gif";
+    GifWriter writer;
+    if (!writer.open(out, w, h, palette))
+        return r;
+    const int minCodeSize = gifMinCodeSize(palette);
+    const int delayCs = max(1, static_cast<int>(lround(100.0 / fps)));
+    vector<uint8_t> cur(static_cast<size_t>(w) * h), prev, block;
+    for (const AsciiFrame &frame : frames) {
+        for (int y = 0; y < h; ++y) {
+            const cv::Vec3b *colors = frame.colors.ptr<cv::Vec3b>(y / (kCell * 2));
+            uint8_t *dst = cur.data() + static_cast<size_t>(y) * w;
+            for (int x = 0; x < w; ++x)
+                dst[x] = palette.indexOf(colors[x / kCell]);
+        }
+        block.clear();
+        encodeGifFrame(cur.data(), prev.empty() ? nullptr : prev.data(), w, h, palette.transparentIndex(),
+                       minCodeSize, block);
+        writer.addFrame(block, delayCs);
+        prev.swap(cur);
+        cur.resize(prev.size());
+        if (r.frames++ == 0)
+            r.firstFrameMs = total.ms();
+    }
+    writer.close();
+    r.seconds = total.ms() / 1000.0;
+    r.bytes = static_cast<long long>(writer.bytesWritten());
+    r.peakRssKb = peakRssKb();
+    ifstream file(out, ios::binary);
+    const string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    Hasher hash;
+    hash.add(data);
+    r.hash = hash.hex();
+    return r;
+}
+
+// ---- Выделения памяти ----
+
+// Выделения на кадр по этапам в установившемся режиме. Кадры источника готовятся
+// заранее, первые kWarmup кадров каждого случая прогревают буферы и не считаются.
+// Уменьшение (cv::resize) только показывается: его внутренние буферы принадлежат OpenCV.
+// Возвращает число этапов, выделявших память после прогрева
+static int runAllocationCheck(const BenchOptions &opts, int frames) {
+    const int kWarmup = 3;
+    const int kSources = 8;
+    vector<cv::Mat> sources(kSources);
+    for (int t = 0; t < kSources; ++t)
+        synthFrame(640, 360, t, Motion::High, sources[t]);
+
+    struct Case {
+        const char *name;
+        int width;
+        DitherMode dither;
+        ColorDepth depth;
+    };
+    // Широкий кадр больше порога параллельной обработки строк: проверяются и помощники
+    const Case cases[] = {
+        {"none/truecolor", opts.width, DitherMode::None, ColorDepth::TrueColor},
+        {"ordered/256", opts.width, DitherMode::Ordered, ColorDepth::Ansi256},
+        {"floyd/256", opts.width, DitherMode::FloydSteinberg, ColorDepth::Ansi256},
+        {"wide-none/truecolor", 480, DitherMode::None, ColorDepth::TrueColor},
+        {"wide-floyd/truecolor", 480, DitherMode::FloydSteinberg, ColorDepth::TrueColor},
+    };
+    const char *stageNames[] = {"resize", "glyphs", "stabilizer", "ansi", "delta", "html"};
+    const int kStages = 6;
+
+    int failures = 0;
+    fprintf(stderr, "%-22s", "выделений на кадр");
+    for (const char *stage : stageNames)
+        fprintf(stderr, " %10s", stage);
+    fprintf(stderr, "\n");
+    for (const Case &c : cases) {
+        const int levels = static_cast<int>(opts.glyphs.size());
+        AsciiFrame frame;
+        TemporalStabilizer stabilizer;
+        AnsiDeltaEncoder encoder(opts.glyphs, c.depth, c.dither);
+        HtmlOptions html;
+        string ansi, delta, body;
+        uint64_t counts[kStages] = {};
+        for (int i = 0; i < kWarmup + frames; ++i) {
+            const cv::Mat &src = sources[i % kSources];
+            uint64_t stage[kStages];
+            {
+                AllocationScope scope;
+                const int rows = asciiRowsFor(src.cols, src.rows, c.width);
+                cv::resize(src, frame.colors, cv::Size(c.width, rows));
+                frame.cols = c.width;
+                frame.rows = rows;
+                stage[0] = scope.count();
+            }
+            {
+                AllocationScope scope;
+                mapGlyphs(frame.colors, levels, c.dither, frame.glyphs);
+                stage[1] = scope.count();
+            }
+            {
+                AllocationScope scope;
+                stabilizer.apply(frame, levels);
+                stage[2] = scope.count();
+            }
+            {
+                AllocationScope scope;
+                asciiFrameToAnsi(frame, opts.glyphs, c.depth, c.dither, ansi);
+                stage[3] = scope.count();
+            }
+            {
+                AllocationScope scope;
+                encoder.encode(frame, &delta);
+                stage[4] = scope.count();
+            }
+            {
+                AllocationScope scope;
+                asciiFrameToHtmlBody(frame, opts.glyphs, html, body);
+                stage[5] = scope.count();
+            }
+            if (i >= kWarmup) {
+                for (int k = 0; k < kStages; ++k)
+                    counts[k] += stage[k];
+            }
+        }
+        fprintf(stderr, "%-22s", c.name);
+        for (int k = 0; k < kStages; ++k) {
+            fprintf(stderr, " %10.2f", static_cast<double>(counts[k]) / frames);
+            if (k > 0 && counts[k] > 0)
+                ++failures;
+        }
+        fprintf(stderr, "\n");
+    }
+    return failures;
+}
+
+// ---- JSON и сравнение с базой ----
+
+static string toJson(const vector<RunResult> &results) {
+    ostringstream out;
+    out << "{\"version\":1,\"runs\":[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult &r = results[i];
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "{\"name\":\"%s\",\"frames\":%lld,\"seconds\":%.4f,\"fps\":%.2f,\"first_frame_ms\":%.2f,"
+                 "\"peak_rss_kb\":%lld,\"bytes\":%lld,\"hash\":\"%s\"",
+                 r.name.c_str(), r.frames, r.seconds, r.fps(), r.firstFrameMs, r.peakRssKb, r.bytes, r.hash.c_str());
+        out << line;
+        if (r.changedCells >= 0.0) {
+            snprintf(line, sizeof(line), ",\"changed_cells\":%.4f", r.changedCells);
+            out << line;
+        }
+        out << '}' << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+// Значение поля key из строки прогона (формат toJson: один прогон на строку)
+static string jsonField(const string &line, const string &key) {
+    const string pattern = "\"" + key + "\":";
+    size_t pos = line.find(pattern);
+    if (pos == string::npos)
+        return string();
+    pos += pattern.size();
+    if (pos < line.size() && line[pos] == '"') {
+        const size_t end = line.find('"', pos + 1);
+        return line.substr(pos + 1, end == string::npos ? string::npos : end - pos - 1);
+    }
+    const size_t end = line.find_first_of(",}", pos);
+    return line.substr(pos, end == string::npos ? string::npos : end - pos);
+}
+
+static map<string, RunResult> loadBaseline(const string &path) {
+    map<string, RunResult> runs;
+    ifstream file(path);
+    string line;
+    while (getline(file, line)) {
+        const string name = jsonField(line, "name");
+        if (name.empty())
+            continue;
+        RunResult r;
+        r.name = name;
+        r.frames = atoll(jsonField(line, "frames").c_str());
+        r.seconds = atof(jsonField(line, "seconds").c_str());
+        r.firstFrameMs = atof(jsonField(line, "first_frame_ms").c_str());
+        r.peakRssKb = atoll(jsonField(line, "peak_rss_kb").c_str());
+        r.bytes = atoll(jsonField(line, "bytes").c_str());
+        r.hash = jsonField(line, "hash");
+        runs[name] = r;
+    }
+    return runs;
+}
+
+// Регрессии: кадры/с ниже, время до первого кадра или пиковый RSS выше базы больше чем
+// на tolerance. Изменившийся хеш - предупреждение (другая версия OpenCV меняет декодирование),
+// с strictHash - тоже регрессия
+static int compareWithBaseline(const vector<RunResult> &results, const map<string, RunResult> &baseline,
+                               double tolerance, bool strictHash) {
+    int regressions = 0;
+    for (const RunResult &r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end()) {
+            fprintf(stderr, "  новый    %s\n", r.name.c_str());
+            continue;
+        }
+        const RunResult &b = it->second;
+        vector<string> problems;
+        char buf[160];
+        if (b.fps() > 0 && r.fps() < b.fps() * (1.0 - tolerance)) {
+            snprintf(buf, sizeof(buf), "кадры/с %.1f -> %.1f", b.fps(), r.fps());
+            problems.push_back(buf);
+        }
+        // Время до первого кадра короче 5 мс слишком шумное для сравнения
+        if (b.firstFrameMs > 5.0 && r.firstFrameMs > b.firstFrameMs * (1.0 + tolerance)) {
+            snprintf(buf, sizeof(buf), "первый кадр %.1f -> %.1f мс", b.firstFrameMs, r.firstFrameMs);
+            problems.push_back(buf);
+        }
+        if (b.peakRssKb > 0 && r.peakRssKb > b.peakRssKb * (1.0 + tolerance)) {
+            snprintf(buf, sizeof(buf), "пик RSS %lld -> %lld КБ", b.peakRssKb, r.peakRssKb);
+            problems.push_back(buf);
+        }
+        const bool hashChanged = !b.hash.empty() && b.hash != r.hash;
+        if (hashChanged && strictHash)
+            problems.push_back("изменился вывод (хеш)");
+        if (!problems.empty()) {
+            ++regressions;
+            string joined;
+            for (const string &p : problems)
+                joined += (joined.empty() ? "" : ", ") + p;
+            fprintf(stderr, "  РЕГРЕССИЯ %s: %s\n", r.name.c_str(), joined.c_str());
+        } else if (hashChanged) {
+            fprintf(stderr, "  вывод изменился %s (хеш %s -> %s)\n", r.name.c_str(), b.hash.c_str(), r.hash.c_str());
+        } else {
+            fprintf(stderr, "  ok       %s: %.1f кадр/с (база %.1f)\n", r.name.c_str(), r.fps(), b.fps());
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    string corpusDir = "bench_corpus";
+    string outFile;
+    string baselineFile;
+    string filter;
+    double tolerance = 0.15;
+    bool strictHash = false;
+    int allocFrames = 0;
+    BenchOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--corpus=", 0) == 0) {
+            corpusDir = arg.substr(9);
+        } else if (arg.rfind("--out=", 0) == 0) {
+            outFile = arg.substr(6);
+        } else if (arg.rfind("--baseline=", 0) == 0) {
+            baselineFile = arg.substr(11);
+        } else if (arg.rfind("--tolerance=", 0) == 0) {
+            tolerance = atof(arg.c_str() + 12) / 100.0;
+        } else if (arg.rfind("--filter=", 0) == 0) {
+            filter = arg.substr(9);
+        } else if (arg.rfind("--width=", 0) == 0) {
+            opts.width = max(10, atoi(arg.c_str() + 8));
+        } else if (arg.rfind("--iterations=", 0) == 0) {
+            opts.iterations = max(1, atoi(arg.c_str() + 13));
+        } else if (arg == "--strict-hash") {
+            strictHash = true;
+        } else if (arg == "--alloc-check" || arg.rfind("--alloc-check=", 0) == 0) {
+            allocFrames = arg.size() > 14 ? max(1, atoi(arg.c_str() + 14)) : 100;
+        } else {
+            cout << "Использование: " << argv[0] << " [флаги]\n";
+            cout << "  --corpus=каталог     - набор входных файлов (создаётся при первом запуске, по умолчанию bench_corpus)\n";
+            cout << "  --out=файл           - куда записать JSON (по умолчанию stdout)\n";
+            cout << "  --baseline=файл      - сравнить с сохранённым JSON; код выхода 3 при регрессиях\n";
+            cout << "  --tolerance=проценты - допустимое ухудшение (по умолчанию 15)\n";
+            cout << "  --strict-hash        - считать регрессией изменение вывода\n";
+            cout << "  --filter=подстрока   - только прогоны, в имени которых есть подстрока\n";
+            cout << "  --width=N --iterations=N - ширина кадра и число повторов для изображений\n";
+            cout << "  --alloc-check[=N]    - только счёт выделений памяти на кадр (N кадров после прогрева);\n";
+            cout << "                         код выхода 4, если этапы конвейера выделяют память\n";
+            cout << "Код выхода 5 - параллельная предобработка разошлась с последовательной\n";
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    opts.glyphs = glyphTableFromUtf8(" .'`^\",:;Il!i><~+_-?][}{1)(|\\/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$");
+    opts.outputDir = corpusDir + "/out";
+
+    if (allocFrames > 0) {
+        const int failures = runAllocationCheck(opts, allocFrames);
+        if (failures > 0) {
+            cerr << "Этапов с выделениями после прогрева: " << failures << endl;
+            return 4;
+        }
+        cerr << "Выделений после прогрева нет" << endl;
+        return 0;
+    }
+
+    cerr << "Набор: " << corpusDir << endl;
+    const vector<CorpusItem> corpus = buildCorpus(corpusDir);
+    makeDir(opts.outputDir);
+
+    vector<RunResult> results;
+    int stitchMismatches = 0;
+    auto wanted = [&](const string &name) { return filter.empty() || name.find(filter) != string::npos; };
+    auto report = [&](const RunResult &r) {
+        fprintf(stderr, "%-48s %8.1f кадр/с  первый %7.1f мс  RSS %7lld КБ\n", r.name.c_str(), r.fps(),
+                r.firstFrameMs, r.peakRssKb);
+        if (r.changedCells >= 0.0)
+            fprintf(stderr, "%-48s %8.1f%% ячеек меняется за кадр\n", "", r.changedCells * 100.0);
+        results.push_back(r);
+    };
+    for (const CorpusItem &item : corpus) {
+        const string name = baseName(item.path);
+        if (item.kind == CorpusItem::Image) {
+            if (wanted("image/" + name))
+                report(runImage(item.path, opts));
+            continue;
+        }
+        if (wanted("ladder/" + name))
+            report(runLadder(item.path, opts));
+        // Кадры последовательной предобработки нужны отрисовке, экспорту и проверке сшивки;
+        // если ни один из этих прогонов не выбран фильтром, запись дальше не декодируется
+        const bool wantConsole = wanted("console/" + name) || wanted("console-delta/" + name) ||
+                                 wanted("console-stable/" + name);
+        const bool wantExport = wanted("export-html/" + name) || wanted("export-cast/" + name) ||
+                                wanted("export-gif/" + name);
+        if (!wanted("preprocess/" + name) && !wanted("preprocess-parallel/" + name) && !wantConsole && !wantExport)
+            continue;
+        vector<AsciiFrame> frames;
+        double fps = 25.0;
+        RunResult pre = runPreprocess(item.path, opts, frames, fps);
+        if (wanted(pre.name))
+            report(pre);
+        if (wanted("preprocess-parallel/" + name)) {
+            const RunResult parallel = runPreprocessParallel(item.path, opts);
+            report(parallel);
+            if (parallel.hash != pre.hash) {
+                fprintf(stderr, "  отрезки сшиты неверно %s (хеш %s, последовательно %s)\n", parallel.name.c_str(),
+                        parallel.hash.c_str(), pre.hash.c_str());
+                ++stitchMismatches;
+            }
+        }
+        if (wantConsole) {
+            for (const RunResult &r : runConsole(item.path, frames, opts)) {
+                if (wanted(r.name))
+                    report(r);
+            }
+        }
+        if (wanted("export-html/" + name))
+            report(runHtmlExport(item.path, frames, fps, opts));
+        if (wanted("export-cast/" + name))
+            report(runCastExport(item.path, frames, fps, opts));
+        if (wanted("export-gif/" + name))
+            report(runGifExport(item.path, frames, fps, opts));
+    }
+
+    const string json = toJson(results);
+    if (outFile.empty())
+        cout << json;
+    else
+        ofstream(outFile) << json;
+
+    if (stitchMismatches > 0) {
+        cerr << "Параллельная предобработка разошлась с последовательной: " << stitchMismatches << endl;
+        return 5;
+    }
+
+    if (!baselineFile.empty()) {
+        const map<string, RunResult> baseline = loadBaseline(baselineFile);
+        if (baseline.empty()) {
+            cerr << "Ошибка: не удалось прочитать базу " << baselineFile << endl;
+            return 1;
+        }
+        cerr << "Сравнение с " << baselineFile << " (допуск " << tolerance * 100 << "%):" << endl;
+        const int regressions = compareWithBaseline(results, baseline, tolerance, strictHash);
+        if (regressions > 0) {
+            cerr << "Регрессий: " << regressions << endl;
+            return 3;
+        }
+    }
+    return 0;
+}
@@ -1,44 +1,80 @@
 #include <iostream>
-#include <sstream>
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <chrono>
 #include <thread>
+#include <atomic>
+#include <memory>
+#include <csignal>
+#include <cstdio>
 #include <opencv2/opencv.hpp>
 
+#include "ascii_core.h"
+#include "ansi_export.h"
+#include "live_input.h"
+#include "web_stream.h"
+#include "term_stream.h"
+#include "adaptive_quality.h"
+#include "image_loader.h"
+#include "terminal_export.h"
+#include "rendition_ladder.h"
+#include "watch_daemon.h"
+
 using namespace std;
 using namespace cv;
 
-// Функция для преобразования изображения (Mat) в ASCII-арт строку
-string convertMatToAscii(const Mat &img, int desiredWidth, const string &asciiChars) {
-    int originalWidth = img.cols;
-    int originalHeight = img.rows;
-    double aspect = static_cast<double>(originalHeight) / originalWidth;
-    // Коэффициент 0.55 корректирует соотношение сторон символа в консоли
-    int newHeight = static_cast<int>(desiredWidth * aspect * 0.55);
-    if(newHeight < 1) newHeight = 1;
-	 
-	Mat resized;
-    resize(img, resized, Size(desiredWidth, newHeight));
-
-    ostringstream oss;
-    for (int i = 0; i < resized.rows; i++) {
-        for (int j = 0; j < resized.cols; j++) {
-            Vec3b color = resized.at<Vec3b>(i, j);
-            int b = color[0], g = color[1], r = color[2];
-            // Преобразование в оттенок серого по формуле яркости
-            double gray = 0.299 * r + 0.587 * g + 0.114 * b;
-			//double gamma = 3.8;
-			//double corrected = pow(gray/255.0, gamma) * 255.0;
-            int index = static_cast<int>(gray/ 255 * (asciiChars.size() - 1));
-            char ch = asciiChars[index];
-            // Вывод символа с 24-битной раскраской (ANSI escape sequence)
-            oss << "\033[38;2;" << r << ";" << g << ";" << b << "m" << ch << "\033[0m";
-        }
-        oss << "\n";
-    }
-    return oss.str();
+// Параметры вывода, задаваемые флагами командной строки
+struct ConsoleOptions {
+    DitherMode dither = DitherMode::None;
+    ColorDepth colorDepth = ColorDepth::TrueColor;
+    bool adaptive = false;       // подстраивать качество под бюджет кадра
+    double targetFps = 0.0;      // целевая частота адаптивного режима (0 - частота источника)
+    size_t loopCacheBytes = 64u << 20;  // лимит кэша готовых кадров зацикленного GIF
+    bool stabilize = false;      // временная стабилизация символов и цветов
+    StabilizerOptions stabilizer;
+};
+
+// Контроллер качества для источника с частотой sourceFps
+AdaptiveQuality makeAdaptiveQuality(const ConsoleOptions &opts, double sourceFps) {
+    AdaptiveQuality::Options qualityOptions;
+    qualityOptions.targetFps = opts.targetFps > 0 ? opts.targetFps : sourceFps;
+    return AdaptiveQuality(qualityOptions, opts.colorDepth);
+}
+
+// Буферы конвертации кадров одного потока вывода: сетка ячеек, таблица символов и текст.
+// Кадры той же ширины, что и предыдущий, конвертируются и сериализуются без выделения памяти
+struct ConsoleFrameBuffers {
+    AsciiFrame frame;
+    string charset;              // набор, по которому построена glyphs
+    vector<string> glyphs;
+    string text;
+};
+
+// Функция для преобразования изображения (Mat) в ASCII-арт строку.
+// stabilizer (для кадров видео) подавляет дрожание символов между кадрами.
+// Строка живёт в buffers до следующего кадра
+const string &convertMatToAscii(const Mat &img, int desiredWidth, const string &asciiChars, const ConsoleOptions &opts,
+                                ConsoleFrameBuffers &buffers, TemporalStabilizer *stabilizer = nullptr) {
+    if (buffers.glyphs.empty() || buffers.charset != asciiChars) {
+        buffers.charset = asciiChars;
+        buffers.glyphs = glyphTableFromUtf8(asciiChars);
+    }
+    convertFrame(img, desiredWidth, static_cast<int>(asciiChars.size()), opts.dither, buffers.frame);
+    if (stabilizer)
+        stabilizer->apply(buffers.frame, static_cast<int>(asciiChars.size()));
+    // Для палитры xterm-256 цвета квантуются с тем же режимом дизеринга
+    asciiFrameToAnsi(buffers.frame, buffers.glyphs, opts.colorDepth, opts.dither, buffers.text);
+    return buffers.text;
+}
+
+// Итог стабилизации в stderr: сколько ячеек менялось с ней и без неё
+void printStabilizerStats(const TemporalStabilizer &stabilizer) {
+    if (stabilizer.frames() == 0)
+        return;
+    fprintf(stderr, "Стабилизация: менялось в среднем %.1f%% ячеек (без неё %.1f%%), смен сцены: %llu\n",
+            stabilizer.averageChangedRatio() * 100.0, stabilizer.averageRawChangedRatio() * 100.0,
+            static_cast<unsigned long long>(stabilizer.sceneResets()));
 }
 
 // Функция для очистки консоли с помощью ANSI-кодов
@@ -47,18 +83,761 @@ void clearConsole() {
     cout << "\033[2J\033[H";
 }
 
+// Параметры живого входа (--live)
+struct LiveOptions {
+    bool enabled = false;
+    string source = "-";
+    int width = 0;
+    int height = 0;
+    double fps = 25.0;
+    LivePixelFormat format = LivePixelFormat::Bgr24;
+};
+
+static atomic<bool> g_interrupted(false);
+
+// Размер кадра --size задан и подходит формату --pix-fmt; иначе сообщение об ошибке
+bool liveSizeValid(const LiveOptions &live) {
+    if (live.width <= 0 || live.height <= 0) {
+        cerr << "Ошибка: для --live нужен размер кадра, например --size=320x240" << endl;
+        return false;
+    }
+    if (!liveFrameSizeValid(live.format, live.width, live.height)) {
+        cerr << "Ошибка: для этого формата пикселей стороны кадра должны быть чётными" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Воспроизведение живого потока: выводится самый свежий кадр не чаще fps раз в секунду,
+// по завершении в stderr печатается статистика задержки и отброшенных кадров
+int runLive(const LiveOptions &live, int desiredWidth, const string &asciiChars, const ConsoleOptions &opts) {
+    if (!liveSizeValid(live))
+        return 1;
+    LiveFrameReader reader(live.source, live.format, live.width, live.height);
+    if (!reader.isOpen()) {
+        cerr << "Ошибка: не удалось открыть вход " << live.source << endl;
+        return 1;
+    }
+    signal(SIGINT, [](int) { g_interrupted = true; });
+    reader.start();
+
+    const auto interval = chrono::duration_cast<chrono::steady_clock::duration>(
+        chrono::duration<double>(1.0 / (live.fps > 0 ? live.fps : 25.0)));
+    LatencyStats latency;
+    AdaptiveQuality quality = makeAdaptiveQuality(opts, live.fps > 0 ? live.fps : 25.0);
+    ConsoleOptions frameOpts = opts;
+    TemporalStabilizer stabilizer(opts.stabilizer);
+    ConsoleFrameBuffers buffers;
+    LiveFrame frame;
+    Mat bgr;
+    uint64_t shown = 0;
+    auto started = chrono::steady_clock::now();
+    auto nextShow = started;
+    while (!g_interrupted) {
+        if (!reader.next(frame, chrono::milliseconds(100))) {
+            if (reader.finished())
+                break;
+            continue;
+        }
+        auto frameStarted = chrono::steady_clock::now();
+        liveFrameToBgr(frame.raw, live.format, live.width, live.height, bgr);
+        int width = desiredWidth;
+        if (opts.adaptive) {
+            width = quality.width(desiredWidth);
+            frameOpts.colorDepth = quality.depth();
+        }
+        const string &asciiFrame = convertMatToAscii(bgr, width, asciiChars, frameOpts, buffers,
+                                                     opts.stabilize ? &stabilizer : nullptr);
+        clearConsole();
+        cout << asciiFrame;
+        if (opts.adaptive)
+            cout << quality.statusText(desiredWidth) << '\n';
+        cout << flush;
+        auto now = chrono::steady_clock::now();
+        latency.add(chrono::duration<double, milli>(now - frame.arrived).count());
+        ++shown;
+        if (opts.adaptive)
+            quality.addSample(chrono::duration<double, milli>(now - frameStarted).count());
+        // Не чаще заявленной частоты (в адаптивном режиме - с учётом шага показа):
+        // кадры, пришедшие за время ожидания, заменят друг друга
+        const auto step = interval * (opts.adaptive ? quality.frameStep() : 1);
+        nextShow = max(nextShow + step, now - step);
+        this_thread::sleep_until(nextShow);
+    }
+    reader.stop();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    fprintf(stderr, "Живой вход: получено %llu, показано %llu, отброшено %llu, %.1f кадр/с\n",
+            static_cast<unsigned long long>(reader.framesRead()), static_cast<unsigned long long>(shown),
+            static_cast<unsigned long long>(reader.framesDropped()), seconds > 0 ? shown / seconds : 0.0);
+    fprintf(stderr, "Задержка (получение -> вывод): ср. %.1f мс, p95 %.0f мс, макс. %.1f мс\n",
+            latency.average(), latency.percentile(0.95), latency.maximum());
+    if (opts.adaptive)
+        fprintf(stderr, "Адаптивное качество: %s, смен ступени: %d\n", quality.statusText(desiredWidth).c_str(),
+                quality.changes());
+    printStabilizerStats(stabilizer);
+    return 0;
+}
+
+// Кэш одного прохода зацикленного видео: готовый к выводу текст кадров и их сроки от
+// начала прохода. Одинаковые подряд кадры делят одну строку. При превышении лимита
+// кэш очищается и больше не заполняется - такие видео декодируются на каждом проходе
+class LoopCache {
+public:
+    explicit LoopCache(size_t limitBytes) : m_limit(limitBytes) {}
+
+    void add(string text, double ptsMs) {
+        if (m_overflow)
+            return;
+        if (m_frames.empty() || *m_frames.back().text != text) {
+            m_bytes += text.size();
+            if (m_bytes > m_limit) {
+                m_overflow = true;
+                clear();
+                return;
+            }
+            m_frames.push_back({make_shared<const string>(move(text)), ptsMs});
+        } else {
+            m_frames.push_back({m_frames.back().text, ptsMs});
+        }
+    }
+
+    // Проход завершён целиком; durationMs - длительность прохода
+    void finish(double durationMs) {
+        m_complete = !m_overflow && !m_frames.empty();
+        m_durationMs = durationMs;
+    }
+
+    // Неполный проход (например, сменилось качество) - начать заново на следующем
+    void clear() {
+        m_frames.clear();
+        m_bytes = 0;
+        m_complete = false;
+    }
+
+    bool complete() const { return m_complete; }
+    bool overflow() const { return m_overflow; }
+    size_t bytes() const { return m_bytes; }
+    size_t size() const { return m_frames.size(); }
+    const string &text(size_t i) const { return *m_frames[i].text; }
+    double ptsMs(size_t i) const { return m_frames[i].ptsMs; }
+    double durationMs() const { return m_durationMs; }
+
+private:
+    struct Entry {
+        shared_ptr<const string> text;
+        double ptsMs;
+    };
+    size_t m_limit;
+    vector<Entry> m_frames;
+    size_t m_bytes = 0;
+    bool m_complete = false;
+    bool m_overflow = false;
+    double m_durationMs = 0.0;
+};
+
+// Воспроизведение видео или GIF (loop - по кругу). Каждый кадр выводится к своему сроку
+// (по его метке времени, иначе по частоте), а не через фиксированную паузу после вывода.
+// В адаптивном режиме ширина, цвет и шаг показа подстраиваются так, чтобы конвертация
+// и вывод укладывались в бюджет кадра. При зацикливании первый проход сохраняет готовый
+// текст кадров в LoopCache, дальше кэш только выводится. Повтор почти ничего не стоит,
+// поэтому контроллеру качества он не показывается: ступень первого прохода сохраняется
+int playVideo(const string &inputFile, bool loop, int desiredWidth, const string &asciiChars, const ConsoleOptions &opts) {
+    VideoCapture cap(inputFile);
+    if (!cap.isOpened()) {
+        cerr << "Ошибка: не удалось открыть файл " << inputFile << endl;
+        return 1;
+    }
+    double fps = cap.get(CAP_PROP_FPS);
+    if (fps <= 0) fps = 10;
+    const double intervalMs = 1000.0 / fps;
+    AdaptiveQuality quality = makeAdaptiveQuality(opts, fps);
+    ConsoleOptions frameOpts = opts;
+    TemporalStabilizer stabilizer(opts.stabilizer);
+    ConsoleFrameBuffers buffers;
+    LoopCache cache(loop ? opts.loopCacheBytes : 0);
+
+    auto ms = [](double value) {
+        return chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(value));
+    };
+    // Вывод кадра к сроку passStart + ptsMs; prepMs - время его подготовки.
+    // measure - передать стоимость кадра контроллеру качества.
+    // Возвращает false, если сменилась ступень качества
+    auto present = [&](const string &text, chrono::steady_clock::time_point &passStart, double ptsMs, double prepMs,
+                       bool measure) {
+        const auto deadline = passStart + ms(ptsMs);
+        const auto now = chrono::steady_clock::now();
+        // Отставание больше чем на кадр не навёрстывается пачкой кадров
+        if (now - deadline > ms(intervalMs))
+            passStart += now - deadline - ms(intervalMs);
+        else
+            this_thread::sleep_until(deadline);
+        const auto shown = chrono::steady_clock::now();
+        clearConsole();
+        cout << text;
+        if (opts.adaptive)
+            cout << quality.statusText(desiredWidth) << '\n';
+        cout << flush;
+        return !opts.adaptive || !measure ||
+               !quality.addSample(prepMs + chrono::duration<double, milli>(chrono::steady_clock::now() - shown).count());
+    };
+
+    Mat frame;
+    while (true) {
+        auto passStart = chrono::steady_clock::now();
+        if (cache.complete()) {
+            // Повтор из кэша: ни декодирования, ни конвертации, качество не меняется
+            for (size_t i = 0; i < cache.size(); ++i)
+                present(cache.text(i), passStart, cache.ptsMs(i), 0.0, false);
+            this_thread::sleep_until(passStart + ms(cache.durationMs()));
+            continue;
+        }
+
+        int64_t index = 0;   // номер кадра в текущем проходе
+        double ptsMs = 0.0;
+        double firstPos = 0.0;
+        bool cacheValid = true;
+        while (true) {
+            // Пропускаемые кадры только извлекаются из потока, без декодирования в Mat
+            const bool show = !opts.adaptive || index % quality.frameStep() == 0;
+            const bool ok = show ? cap.read(frame) && !frame.empty() : cap.grab();
+            if (!ok)
+                break;
+            // Метка времени кадра из контейнера (у GIF - с учётом задержек кадров)
+            const double pos = cap.get(CAP_PROP_POS_MSEC);
+            if (index == 0)
+                firstPos = pos;
+            ptsMs = index == 0 ? 0.0 : (pos - firstPos > ptsMs ? pos - firstPos : ptsMs + intervalMs);
+            ++index;
+            if (!show)
+                continue;
+            auto started = chrono::steady_clock::now();
+            int width = desiredWidth;
+            if (opts.adaptive) {
+                width = quality.width(desiredWidth);
+                frameOpts.colorDepth = quality.depth();
+            }
+            const string &asciiFrame = convertMatToAscii(frame, width, asciiChars, frameOpts, buffers,
+                                                         opts.stabilize ? &stabilizer : nullptr);
+            const double prepMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+            if (!present(asciiFrame, passStart, ptsMs, prepMs, true))
+                cacheValid = false;
+            if (loop && cacheValid)
+                cache.add(asciiFrame, ptsMs);
+        }
+        if (!loop || index == 0)
+            break;
+        const double durationMs = ptsMs + intervalMs;
+        if (cacheValid && !cache.overflow())
+            cache.finish(durationMs);
+        else
+            cache.clear();
+        this_thread::sleep_until(passStart + ms(durationMs));
+        if (!cache.complete()) {
+            cap.release();
+            if (!cap.open(inputFile))
+                break;
+        }
+    }
+    cap.release();
+    printStabilizerStats(stabilizer);
+    return 0;
+}
+
+// Кадры источника для серверных режимов: живой вход, видео или GIF (по кругу),
+// изображение (повторяется раз в секунду, чтобы его получали новые клиенты).
+// Темп задаёт частота источника; работа идёт до Ctrl+C или конца живого потока.
+// maxCols - наибольшая ширина вывода, под неё декодируется изображение
+template <typename Fn>
+int forEachSourceFrame(const string &inputFile, const LiveOptions &live, int maxCols, Fn onFrame) {
+    signal(SIGINT, [](int) { g_interrupted = true; });
+    if (live.enabled) {
+        if (!liveSizeValid(live))
+            return 1;
+        LiveFrameReader reader(live.source, live.format, live.width, live.height);
+        if (!reader.isOpen()) {
+            cerr << "Ошибка: не удалось открыть вход " << live.source << endl;
+            return 1;
+        }
+        reader.start();
+        LiveFrame frame;
+        Mat bgr;
+        while (!g_interrupted) {
+            if (!reader.next(frame, chrono::milliseconds(100))) {
+                if (reader.finished())
+                    break;
+                continue;
+            }
+            liveFrameToBgr(frame.raw, live.format, live.width, live.height, bgr);
+            onFrame(bgr);
+        }
+        return 0;
+    }
+
+    Mat image = loadImageForAscii(inputFile, maxCols);
+    if (!image.empty()) {
+        while (!g_interrupted) {
+            onFrame(image);
+            this_thread::sleep_for(chrono::seconds(1));
+        }
+        return 0;
+    }
+    VideoCapture cap(inputFile);
+    if (!cap.isOpened()) {
+        cerr << "Ошибка: не удалось открыть файл " << inputFile << endl;
+        return 1;
+    }
+    double fps = cap.get(CAP_PROP_FPS);
+    if (fps <= 0) fps = 10;
+    const auto interval = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(1.0 / fps));
+    auto next = chrono::steady_clock::now();
+    Mat frame;
+    while (!g_interrupted) {
+        if (!cap.read(frame) || frame.empty()) {
+            cap.release();
+            cap.open(inputFile);
+            if (!cap.read(frame) || frame.empty())
+                break;
+        }
+        onFrame(frame);
+        auto now = chrono::steady_clock::now();
+        next = max(next + interval, now - interval);
+        this_thread::sleep_until(next);
+    }
+    return 0;
+}
+
+// Трансляция по WebSocket/HTTP: источник декодируется и конвертируется один раз,
+// кадр кодируется один раз на формат и раздаётся всем клиентам
+int runServe(int port, const string &inputFile, const LiveOptions &live, int desiredWidth,
+             const string &asciiChars, const ConsoleOptions &opts) {
+    WebStreamServer::Options serverOptions;
+    serverOptions.glyphs = glyphTableFromUtf8(asciiChars);
+    serverOptions.blackWhite = opts.colorDepth == ColorDepth::Mono;
+    serverOptions.ansiDepth = opts.colorDepth;
+    serverOptions.dither = opts.dither;
+    WebStreamServer server(serverOptions);
+    TemporalStabilizer stabilizer(opts.stabilizer);
+    string error;
+    if (!server.listen(port, error)) {
+        cerr << "Ошибка: не удалось открыть порт " << port << ": " << error << endl;
+        return 1;
+    }
+    server.start();
+    cerr << "Трансляция: http://localhost:" << port << "/ (WebSocket /ws, HTTP /stream, format=plain|ansi|html|delta)" << endl;
+
+    const int levels = static_cast<int>(asciiChars.size());
+    auto lastStatus = chrono::steady_clock::now();
+    int rc = forEachSourceFrame(inputFile, live, desiredWidth, [&](const Mat &bgr) {
+        AsciiFrame frame;
+        convertFrame(bgr, desiredWidth, levels, opts.dither, frame);
+        if (opts.stabilize)
+            stabilizer.apply(frame, levels);
+        server.publish(frame);
+        auto now = chrono::steady_clock::now();
+        if (now - lastStatus >= chrono::seconds(5)) {
+            cerr << server.statusLine() << endl;
+            lastStatus = now;
+        }
+    });
+    server.stop();
+    cerr << server.statusLine() << endl;
+    printStabilizerStats(stabilizer);
+    return rc;
+}
+
+// Трансляция в терминалы по TCP: кадр конвертируется один раз на каждую пару
+// (ширина, цвет), запрошенную клиентами
+int runServeTcp(int port, const string &inputFile, const LiveOptions &live, int desiredWidth,
+                const string &asciiChars, const ConsoleOptions &opts) {
+    TerminalStreamServer::Options serverOptions;
+    serverOptions.glyphs = glyphTableFromUtf8(asciiChars);
+    serverOptions.dither = opts.dither;
+    serverOptions.defaults.width = desiredWidth;
+    serverOptions.defaults.depth = opts.colorDepth;
+    serverOptions.stabilize = opts.stabilize;
+    serverOptions.stabilizer = opts.stabilizer;
+    TerminalStreamServer server(serverOptions);
+    string error;
+    if (!server.listen(port, error)) {
+        cerr << "Ошибка: не удалось открыть порт " << port << ": " << error << endl;
+        return 1;
+    }
+    server.start();
+    cerr << "Трансляция в терминалы: nc localhost " << port << endl;
+
+    auto lastStatus = chrono::steady_clock::now();
+    int rc = forEachSourceFrame(inputFile, live, serverOptions.maxWidth, [&](const Mat &bgr) {
+        server.publish(bgr);
+        auto now = chrono::steady_clock::now();
+        if (now - lastStatus >= chrono::seconds(5)) {
+            cerr << server.statusLine() << endl;
+            lastStatus = now;
+        }
+    });
+    server.stop();
+    cerr << server.statusLine() << endl;
+    return rc;
+}
+
+// Экспорт видео или GIF в .ans или .cast без показа: кадры конвертируются, дельта-кодируются
+// и сразу пишутся в файл, поэтому экспорт идёт со скоростью конвертации, а память постоянна
+int runExport(const string &inputFile, const string &outputFile, int desiredWidth, const string &asciiChars,
+              const ConsoleOptions &opts) {
+    VideoCapture cap(inputFile);
+    if (!cap.isOpened()) {
+        cerr << "Ошибка: не удалось открыть файл " << inputFile << endl;
+        return 1;
+    }
+    double fps = cap.get(CAP_PROP_FPS);
+    if (fps <= 0) fps = 10;
+    const double intervalMs = 1000.0 / fps;
+
+    TerminalExportWriter::Options writerOptions;
+    writerOptions.glyphs = glyphTableFromUtf8(asciiChars);
+    writerOptions.depth = opts.colorDepth;
+    writerOptions.dither = opts.dither;
+    writerOptions.format = terminalExportFormatForPath(outputFile);
+    const size_t slash = inputFile.find_last_of("/\\");
+    writerOptions.title = slash == string::npos ? inputFile : inputFile.substr(slash + 1);
+    TerminalExportWriter writer(writerOptions);
+    if (!writer.open(outputFile)) {
+        cerr << "Ошибка: не удалось создать файл " << outputFile << endl;
+        return 1;
+    }
+
+    signal(SIGINT, [](int) { g_interrupted = true; });
+    const int levels = static_cast<int>(asciiChars.size());
+    TemporalStabilizer stabilizer(opts.stabilizer);
+    AsciiFrame frame;
+    Mat image;
+    int64_t index = 0;
+    double ptsMs = 0.0, firstPos = 0.0;
+    auto started = chrono::steady_clock::now();
+    auto lastStatus = started;
+    while (!g_interrupted && cap.read(image) && !image.empty()) {
+        // Метка времени как при воспроизведении: из контейнера, иначе по частоте
+        const double pos = cap.get(CAP_PROP_POS_MSEC);
+        if (index == 0)
+            firstPos = pos;
+        ptsMs = index == 0 ? 0.0 : (pos - firstPos > ptsMs ? pos - firstPos : ptsMs + intervalMs);
+        ++index;
+        convertFrame(image, desiredWidth, levels, opts.dither, frame);
+        if (opts.stabilize)
+            stabilizer.apply(frame, levels);
+        if (!writer.addFrame(frame, ptsMs / 1000.0)) {
+            cerr << "Ошибка записи в " << outputFile << endl;
+            return 1;
+        }
+        auto now = chrono::steady_clock::now();
+        if (now - lastStatus >= chrono::seconds(1)) {
+            fprintf(stderr, "\rЭкспорт: %lld кадров, %.1f с записи", static_cast<long long>(index), ptsMs / 1000.0);
+            lastStatus = now;
+        }
+    }
+    cap.release();
+    if (!writer.close((ptsMs + intervalMs) / 1000.0)) {
+        cerr << "Ошибка записи в " << outputFile << endl;
+        return 1;
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    const double durationSec = index > 0 ? (ptsMs + intervalMs) / 1000.0 : 0.0;
+    fprintf(stderr, "\rЭкспорт: %zu кадров (%.1f с записи) за %.1f с, %.1fx реального времени, %.1f МБ -> %s\n",
+            writer.framesWritten(), durationSec, seconds, seconds > 0 ? durationSec / seconds : 0.0,
+            writer.bytesWritten() / (1024.0 * 1024.0), outputFile.c_str());
+    printStabilizerStats(stabilizer);
+    return 0;
+}
+
+// Лестница вариантов: каждый кадр декодируется один раз и пишется во все ширины и глубины
+// цвета из --ladder, каждая в свой файл <имя>_<ширина>[_<цвет>].<расширение>
+int runLadderExport(const string &inputFile, const string &outputFile, const string &ladderSpec,
+                    const string &asciiChars, const ConsoleOptions &opts) {
+    const vector<pair<int, ColorDepth>> list = parseRenditionList(ladderSpec, opts.colorDepth);
+    if (list.empty()) {
+        cerr << "Ошибка: неверный список вариантов " << ladderSpec << endl;
+        return 1;
+    }
+    VideoCapture cap(inputFile);
+    if (!cap.isOpened()) {
+        cerr << "Ошибка: не удалось открыть файл " << inputFile << endl;
+        return 1;
+    }
+    double fps = cap.get(CAP_PROP_FPS);
+    if (fps <= 0) fps = 10;
+    const double intervalMs = 1000.0 / fps;
+
+    const size_t dot = outputFile.find_last_of('.');
+    const size_t slash = outputFile.find_last_of("/\\");
+    const bool hasExt = dot != string::npos && (slash == string::npos || dot > slash);
+    const string stem = hasExt ? outputFile.substr(0, dot) : outputFile;
+    const string ext = hasExt ? outputFile.substr(dot) : string(".ans");
+    const size_t inSlash = inputFile.find_last_of("/\\");
+    const string title = inSlash == string::npos ? inputFile : inputFile.substr(inSlash + 1);
+
+    vector<unique_ptr<TerminalExportWriter>> writers;
+    vector<string> paths;
+    vector<Rendition> renditions;
+    for (const auto &item : list) {
+        // Суффикс цвета нужен, только если ширина встречается несколько раз
+        const bool repeated = count_if(list.begin(), list.end(),
+                                       [&](const pair<int, ColorDepth> &o) { return o.first == item.first; }) > 1;
+        const char *depthName = item.second == ColorDepth::Ansi256 ? "256"
+                              : item.second == ColorDepth::Mono    ? "mono" : "truecolor";
+        const string path = stem + "_" + to_string(item.first) + (repeated ? string("_") + depthName : string()) + ext;
+        if (find(paths.begin(), paths.end(), path) != paths.end())
+            continue;
+
+        TerminalExportWriter::Options writerOptions;
+        writerOptions.glyphs = glyphTableFromUtf8(asciiChars);
+        writerOptions.depth = item.second;
+        writerOptions.dither = opts.dither;
+        writerOptions.format = terminalExportFormatForPath(path);
+        writerOptions.title = title;
+        auto writer = make_unique<TerminalExportWriter>(writerOptions);
+        if (!writer->open(path)) {
+            cerr << "Ошибка: не удалось создать файл " << path << endl;
+            return 1;
+        }
+        Rendition r;
+        r.width = item.first;
+        r.glyphs = writerOptions.glyphs;
+        r.dither = opts.dither;
+        r.depth = item.second;
+        TerminalExportWriter *sink = writer.get();
+        r.sink = [sink](const AsciiFrame &frame, double ptsMs) { return sink->addFrame(frame, ptsMs / 1000.0); };
+        renditions.push_back(move(r));
+        writers.push_back(move(writer));
+        paths.push_back(path);
+    }
+    RenditionLadder ladder(move(renditions), opts.stabilize, opts.stabilizer);
+
+    signal(SIGINT, [](int) { g_interrupted = true; });
+    Mat image;
+    int64_t index = 0;
+    double ptsMs = 0.0, firstPos = 0.0;
+    auto started = chrono::steady_clock::now();
+    auto lastStatus = started;
+    while (!g_interrupted && cap.read(image) && !image.empty()) {
+        const double pos = cap.get(CAP_PROP_POS_MSEC);
+        if (index == 0)
+            firstPos = pos;
+        ptsMs = index == 0 ? 0.0 : (pos - firstPos > ptsMs ? pos - firstPos : ptsMs + intervalMs);
+        ++index;
+        if (!ladder.process(image, ptsMs)) {
+            cerr << "Ошибка записи вариантов в " << stem << "_*" << ext << endl;
+            return 1;
+        }
+        auto now = chrono::steady_clock::now();
+        if (now - lastStatus >= chrono::seconds(1)) {
+            fprintf(stderr, "\rЭкспорт (%zu вариантов): %lld кадров, %.1f с записи", writers.size(),
+                    static_cast<long long>(index), ptsMs / 1000.0);
+            lastStatus = now;
+        }
+    }
+    cap.release();
+
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    const double durationSec = index > 0 ? (ptsMs + intervalMs) / 1000.0 : 0.0;
+    fprintf(stderr, "\rЭкспорт: %lld кадров (%.1f с записи) за %.1f с, %.1fx реального времени; "
+                    "%zu вариантов из %zu уровней пирамиды\n",
+            static_cast<long long>(index), durationSec, seconds, seconds > 0 ? durationSec / seconds : 0.0,
+            writers.size(), ladder.pyramidLevels());
+    int rc = 0;
+    for (size_t i = 0; i < writers.size(); ++i) {
+        if (!writers[i]->close((ptsMs + intervalMs) / 1000.0)) {
+            cerr << "Ошибка записи в " << paths[i] << endl;
+            rc = 1;
+            continue;
+        }
+        fprintf(stderr, "  %.1f МБ -> %s\n", writers[i]->bytesWritten() / (1024.0 * 1024.0), paths[i].c_str());
+    }
+    return rc;
+}
+
+// Демон каталогов: конвертировать всё, что появляется в наблюдаемых каталогах, пока
+// не придёт SIGINT или SIGTERM
+int runWatch(WatchDaemonOptions watch, int width, const string &asciiChars, const ConsoleOptions &opts) {
+    watch.width = width;
+    watch.glyphs = glyphTableFromUtf8(asciiChars);
+    watch.dither = opts.dither;
+    watch.depth = opts.colorDepth;
+    WatchDaemon daemon(watch);
+    string error;
+    if (!daemon.start(error)) {
+        cerr << "Ошибка: " << error << endl;
+        return 1;
+    }
+    signal(SIGINT, [](int) { g_interrupted = true; });
+    signal(SIGTERM, [](int) { g_interrupted = true; });
+    cerr << "Наблюдение за " << watch.dirs.size() << " каталогами, результаты в " << watch.outputDir << endl;
+    auto lastStatus = chrono::steady_clock::now();
+    while (!g_interrupted) {
+        daemon.poll(200);
+        auto now = chrono::steady_clock::now();
+        if (now - lastStatus >= chrono::seconds(1)) {
+            const WatchDaemon::Stats s = daemon.stats();
+            fprintf(stderr, "\rОчередь %zu, выполняется %zu, готово %llu, копий %llu, ошибок %llu   ", s.queued,
+                    s.running, static_cast<unsigned long long>(s.converted),
+                    static_cast<unsigned long long>(s.deduplicated), static_cast<unsigned long long>(s.failed));
+            lastStatus = now;
+        }
+    }
+    daemon.stop();
+    cerr << endl;
+    return 0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
         cout << "Использование: " << argv[0] << " <путь_к_файлу> [ширина_ascii]\n";
         cout << "  <путь_к_файлу> - путь к изображению, GIF или видео\n";
         cout << "  [ширина_ascii] - количество символов по ширине (по умолчанию: 80)\n";
+        cout << "Флаги:\n";
+        cout << "  --dither=none|ordered|fs     - дизеринг (ordered - для видео, fs - для изображений)\n";
+        cout << "  --colors=truecolor|256|mono  - глубина цвета ANSI\n";
+        cout << "  --adaptive[=fps]             - снижать ширину, цвет и частоту показа, чтобы держать частоту кадров\n";
+        cout << "  --stabilize[=уровень[,цвет]] - подавлять дрожание символов и цветов между кадрами видео\n";
+        cout << "                                 (мёртвая зона в долях уровня, по умолчанию 0.5, и цвета, по умолчанию 12)\n";
+        cout << "  --loop-cache-mb=N            - память под готовые кадры GIF для повторов (0 - декодировать каждый раз)\n";
+        cout << "  --live[=путь]                - сырые кадры из stdin или именованного канала вместо файла\n";
+        cout << "  --size=ШxВ --fps=N           - размер и частота кадров живого входа\n";
+        cout << "  --pix-fmt=bgr24|rgb24|yuv420p|nv12|yuyv422 - формат пикселей живого входа\n";
+        cout << "  --serve=порт                 - трансляция по WebSocket/HTTP вместо вывода в терминал\n";
+        cout << "  --serve-tcp=порт             - трансляция в терминалы клиентов (nc localhost порт)\n";
+        cout << "  --export=файл.ans|файл.cast  - записать видео или GIF в поток ANSI (cat файл.ans) или asciinema\n";
+        cout << "  --ladder=80,160:256,320:mono - с --export: все ширины за одно декодирование, каждая в файл_<ширина>\n";
+        cout << "  --watch=каталог[,каталог]    - демон: конвертировать новые и изменённые файлы каталогов\n";
+        cout << "  --watch-out=каталог          - куда писать результаты (по умолчанию ascii_out;\n";
+        cout << "                                 при нескольких каталогах - подкаталоги с их именами)\n";
+        cout << "  --watch-formats=ans,html     - форматы результатов: txt, ans, cast, html\n";
+        cout << "  --watch-workers=N --watch-memory-mb=N - число потоков и бюджет памяти заданий\n";
+        cout << "  --watch-stats=файл           - журнал задержек заданий, очереди и пропускной способности (JSON-строки)\n";
+        cout << "Пример: ffmpeg -re -f lavfi -i testsrc=size=320x240:rate=25 -f rawvideo -pix_fmt bgr24 - | "
+             << argv[0] << " --live --size=320x240 --fps=25 100\n";
         return 1;
     }
 
-    string inputFile = argv[1];
-    int desiredWidth = (argc >= 3) ? atoi(argv[2]) : 80;
+    // Позиционные аргументы и флаги вида --имя=значение
+    ConsoleOptions opts;
+    LiveOptions live;
+    int servePort = 0;
+    int tcpPort = 0;
+    string exportFile;
+    string ladderSpec;
+    WatchDaemonOptions watch;
+    vector<string> positional;
+    auto splitList = [](const string &list) {
+        vector<string> items;
+        size_t pos = 0;
+        while (pos <= list.size()) {
+            size_t end = list.find(',', pos);
+            if (end == string::npos)
+                end = list.size();
+            if (end > pos)
+                items.push_back(list.substr(pos, end - pos));
+            pos = end + 1;
+        }
+        return items;
+    };
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--dither=", 0) == 0) {
+            if (!ditherModeFromString(arg.substr(9), opts.dither)) {
+                cerr << "Ошибка: неизвестный дизеринг " << arg.substr(9) << " (none, ordered или fs)" << endl;
+                return 1;
+            }
+        } else if (arg.rfind("--colors=", 0) == 0) {
+            string depth = arg.substr(9);
+            if (depth == "256")
+                opts.colorDepth = ColorDepth::Ansi256;
+            else if (depth == "mono")
+                opts.colorDepth = ColorDepth::Mono;
+            else
+                opts.colorDepth = ColorDepth::TrueColor;
+        } else if (arg == "--adaptive" || arg.rfind("--adaptive=", 0) == 0) {
+            opts.adaptive = true;
+            if (arg.size() > 11)
+                opts.targetFps = atof(arg.c_str() + 11);
+        } else if (arg == "--stabilize" || arg.rfind("--stabilize=", 0) == 0) {
+            opts.stabilize = true;
+            if (arg.size() > 12)
+                sscanf(arg.c_str() + 12, "%lf,%d", &opts.stabilizer.levelThreshold, &opts.stabilizer.colorThreshold);
+        } else if (arg.rfind("--loop-cache-mb=", 0) == 0) {
+            opts.loopCacheBytes = static_cast<size_t>(max(0, atoi(arg.c_str() + 16))) << 20;
+        } else if (arg == "--live" || arg.rfind("--live=", 0) == 0) {
+            live.enabled = true;
+            if (arg.size() > 7)
+                live.source = arg.substr(7);
+        } else if (arg.rfind("--serve-tcp=", 0) == 0) {
+            tcpPort = atoi(arg.c_str() + 12);
+        } else if (arg.rfind("--export=", 0) == 0) {
+            exportFile = arg.substr(9);
+        } else if (arg.rfind("--ladder=", 0) == 0) {
+            ladderSpec = arg.substr(9);
+        } else if (arg.rfind("--watch=", 0) == 0) {
+            watch.dirs = splitList(arg.substr(8));
+        } else if (arg.rfind("--watch-out=", 0) == 0) {
+            watch.outputDir = arg.substr(12);
+        } else if (arg.rfind("--watch-formats=", 0) == 0) {
+            watch.formats = splitList(arg.substr(16));
+        } else if (arg.rfind("--watch-workers=", 0) == 0) {
+            watch.workers = atoi(arg.c_str() + 16);
+        } else if (arg.rfind("--watch-memory-mb=", 0) == 0) {
+            watch.memoryBudget = static_cast<uint64_t>(max(1, atoi(arg.c_str() + 18))) << 20;
+        } else if (arg.rfind("--watch-stats=", 0) == 0) {
+            watch.statsPath = arg.substr(14);
+        } else if (arg.rfind("--serve=", 0) == 0) {
+            servePort = atoi(arg.c_str() + 8);
+        } else if (arg.rfind("--size=", 0) == 0) {
+            if (sscanf(arg.c_str() + 7, "%dx%d", &live.width, &live.height) != 2)
+                live.width = live.height = 0;
+        } else if (arg.rfind("--fps=", 0) == 0) {
+            live.fps = atof(arg.c_str() + 6);
+        } else if (arg.rfind("--pix-fmt=", 0) == 0) {
+            if (!livePixelFormatFromString(arg.substr(10), live.format)) {
+                cerr << "Ошибка: неизвестный формат пикселей " << arg.substr(10) << endl;
+                return 1;
+            }
+        } else {
+            positional.push_back(arg);
+        }
+    }
     // Набор символов: от «тёмных» (более плотных) к «светлым» (менее плотным)
     string asciiChars = " .'`^\",:;Il!i><~+_-?][}{1)(|\\/tfjrxnuvczXYUJCLQ0OZmwqpdbkhao*#MW&8%B@$";
+    if (!watch.dirs.empty()) {
+        // В режиме демона единственный позиционный аргумент - ширина
+        int watchWidth = positional.empty() ? 80 : atoi(positional[0].c_str());
+        return runWatch(watch, watchWidth, asciiChars, opts);
+    }
+    if (live.enabled) {
+        // В живом режиме единственный позиционный аргумент - ширина
+        int liveWidth = positional.empty() ? 80 : atoi(positional[0].c_str());
+        if (servePort > 0)
+            return runServe(servePort, string(), live, liveWidth, asciiChars, opts);
+        if (tcpPort > 0)
+            return runServeTcp(tcpPort, string(), live, liveWidth, asciiChars, opts);
+        return runLive(live, liveWidth, asciiChars, opts);
+    }
+    if (positional.empty()) {
+        cerr << "Ошибка: не указан путь к файлу" << endl;
+        return 1;
+    }
+
+    string inputFile = positional[0];
+    int desiredWidth = (positional.size() >= 2) ? atoi(positional[1].c_str()) : 80;
+    if (servePort > 0)
+        return runServe(servePort, inputFile, live, desiredWidth, asciiChars, opts);
+    if (tcpPort > 0)
+        return runServeTcp(tcpPort, inputFile, live, desiredWidth, asciiChars, opts);
+    if (!ladderSpec.empty() && exportFile.empty()) {
+        cerr << "Ошибка: --ladder пишет варианты в файлы и требует --export=файл" << endl;
+        return 1;
+    }
+    if (!exportFile.empty() && !ladderSpec.empty())
+        return runLadderExport(inputFile, exportFile, ladderSpec, asciiChars, opts);
+    if (!exportFile.empty())
+        return runExport(inputFile, exportFile, desiredWidth, asciiChars, opts);
 //	string asciiChars = " .'`^\",:;Il!i><~+_-?][}{1)(|\\/*#MW&8%B@$";
 //	string asciiChars = "@%#*+=-:. ";
 //	string asciiChars = "$@B%8&WM#*oahkbdpqwmZO0QLCJUYXzcvunxrjft/|()1{}[]?-_+~<>i!lI;:,\"^`'. ";
@@ -96,56 +875,18 @@ int main(int argc, char** argv) {
     }
 
 	if (isVideo) {
-		// Обработка видео или GIF
-		if (fileExtension == "gif") {
-			// Зацикливаем воспроизведение GIF
-			while (true) {
-				VideoCapture cap(inputFile);
-				if (!cap.isOpened()) {
-					cerr << "Ошибка: не удалось открыть файл " << inputFile << endl;
-					return 1;
-				}
-				double fps = cap.get(CAP_PROP_FPS);
-				if (fps <= 0) fps = 10;
-
-				Mat frame;
-				while (cap.read(frame)) {
-					if (frame.empty()) break;
-					string asciiFrame = convertMatToAscii(frame, desiredWidth, asciiChars);
-					clearConsole();
-					cout << asciiFrame << flush;
-					this_thread::sleep_for(chrono::milliseconds(static_cast<int>(1000.0 / fps)));
-				}
-				cap.release();
-			}
-		} else {
-			// Обработка обычного видео (без зацикливания)
-			VideoCapture cap(inputFile);
-			if (!cap.isOpened()) {
-				cerr << "Ошибка: не удалось открыть файл " << inputFile << endl;
-				return 1;
-			}
-			double fps = cap.get(CAP_PROP_FPS);
-			if (fps <= 0) fps = 10;
-			Mat frame;
-			while (cap.read(frame)) {
-				if (frame.empty()) break;
-				string asciiFrame = convertMatToAscii(frame, desiredWidth, asciiChars);
-				clearConsole();
-				cout << asciiFrame << flush;
-				this_thread::sleep_for(chrono::milliseconds(static_cast<int>(1000.0 / fps)));
-			}
-			cap.release();
-		}
+		// Обработка видео или GIF (GIF зацикливается)
+		return playVideo(inputFile, fileExtension == "gif", desiredWidth, asciiChars, opts);
 	} else {
 		// Обработка статичного изображения
-		Mat img = imread(inputFile, IMREAD_COLOR);
+		// Декодируется только нужное для ширины разрешение
+		Mat img = loadImageForAscii(inputFile, desiredWidth);
 		if (img.empty()) {
 			cerr << "Ошибка: не удалось загрузить изображение " << inputFile << endl;
 			return 1;
 		}
-		string asciiImage = convertMatToAscii(img, desiredWidth, asciiChars);
-		cout << asciiImage;
+		ConsoleFrameBuffers buffers;
+		cout << convertMatToAscii(img, desiredWidth, asciiChars, opts, buffers);
 	}
 
 	return 0;
@@ -0,0 +1,282 @@
+// export_jobs.h
+// Фоновые задания экспорта: очередь с ограничением числа одновременных заданий,
+// прогрессом, оценкой оставшегося времени и отменой. Состояние заданий не зависит
+// от вкладок, поэтому конвертацию можно продолжать, пока идёт экспорт. Задания
+// выполняются на общем планировщике с обычным приоритетом: раньше предобработки,
+// но после интерактивной конвертации
+
+#ifndef EXPORT_JOBS_H
+#define EXPORT_JOBS_H
+
+#include <QObject>
+#include <QWidget>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QLabel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QMap>
+#include <QList>
+#include <QPair>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "work_scheduler.h"
+
+// Контекст выполняемого задания: проверка отмены и отчёт о прогрессе
+class ExportJobContext {
+public:
+    virtual ~ExportJobContext() = default;
+    virtual bool cancelled() const = 0;
+    // fraction - доля выполненной работы 0..1, stage - текущий этап
+    virtual void setProgress(double fraction, const QString &stage) = 0;
+    // Планировщик, на котором выполняется задание: для разбиения работы на части
+    virtual WorkScheduler &scheduler() const = 0;
+};
+
+// Функция задания возвращает пустую строку при успехе или текст ошибки
+using ExportJobFn = std::function<QString(ExportJobContext &)>;
+
+class ExportJobManager : public QObject {
+    Q_OBJECT
+public:
+    explicit ExportJobManager(WorkScheduler *scheduler, QObject *parent = nullptr)
+        : QObject(parent), m_scheduler(scheduler) {}
+
+    ~ExportJobManager() override {
+        cancelAll();
+        std::unique_lock<std::mutex> lock(m_runMutex);
+        m_waiting.clear();
+        m_idle.wait(lock, [this]() { return m_running == 0; });
+    }
+
+    int maxConcurrent() const {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        return m_maxConcurrent;
+    }
+
+    void setMaxConcurrent(int count) {
+        std::lock_guard<std::mutex> lock(m_runMutex);
+        m_maxConcurrent = std::max(1, count);
+        startWaiting();
+    }
+
+    // Постановка задания в очередь; возвращает его идентификатор
+    int submit(const QString &title, ExportJobFn fn) {
+        auto job = std::make_shared<Job>();
+        job->id = ++m_lastId;
+        job->manager = this;
+        {
+            QMutexLocker lock(&m_mutex);
+            m_jobs.insert(job->id, job);
+        }
+        emit jobAdded(job->id, title);
+        {
+            std::lock_guard<std::mutex> lock(m_runMutex);
+            m_waiting.append(qMakePair(job, fn));
+            startWaiting();
+        }
+        return job->id;
+    }
+
+    void cancel(int id) {
+        QMutexLocker lock(&m_mutex);
+        auto it = m_jobs.find(id);
+        if (it != m_jobs.end())
+            (*it)->cancel.store(true);
+    }
+
+    void cancelAll() {
+        QMutexLocker lock(&m_mutex);
+        for (auto &job : m_jobs)
+            job->cancel.store(true);
+    }
+
+signals:
+    void jobAdded(int id, const QString &title);
+    void jobStarted(int id);
+    void jobProgress(int id, double fraction, const QString &stage, qint64 etaMs);
+    void jobFinished(int id, bool ok, bool cancelled, const QString &message);
+
+private:
+    struct Job : ExportJobContext {
+        int id = 0;
+        ExportJobManager *manager = nullptr;
+        std::atomic<bool> cancel{false};
+        QElapsedTimer timer;
+        qint64 lastReportMs = -1000;
+
+        bool cancelled() const override { return cancel.load(); }
+        WorkScheduler &scheduler() const override { return *manager->m_scheduler; }
+
+        void setProgress(double fraction, const QString &stage) override {
+            qint64 elapsed = timer.elapsed();
+            // Не чаще 10 раз в секунду, чтобы не засыпать очередь событий GUI
+            if (elapsed - lastReportMs < 100 && fraction < 1.0)
+                return;
+            lastReportMs = elapsed;
+            qint64 eta = fraction > 0.001 ? static_cast<qint64>(elapsed * (1.0 - fraction) / fraction) : -1;
+            emit manager->jobProgress(id, fraction, stage, eta);
+        }
+
+        void run(const ExportJobFn &fn) {
+            if (cancel.load()) {
+                emit manager->jobFinished(id, false, true, "Отменено");
+                manager->forget(id);
+                return;
+            }
+            timer.start();
+            emit manager->jobStarted(id);
+            QString error;
+            try {
+                error = fn(*this);
+            } catch (...) {
+                error = "Произошла ошибка при экспорте.";
+            }
+            bool wasCancelled = cancel.load();
+            emit manager->jobFinished(id, error.isEmpty() && !wasCancelled, wasCancelled,
+                                      wasCancelled ? QString("Отменено") : error);
+            manager->forget(id);
+        }
+    };
+
+    void forget(int id) {
+        QMutexLocker lock(&m_mutex);
+        m_jobs.remove(id);
+    }
+
+    // Под m_runMutex: ожидающие задания уходят в планировщик, пока выполняется меньше
+    // m_maxConcurrent. Завершившееся задание запускает следующее под той же блокировкой
+    // и после неё менеджера не касается, поэтому деструктор может его дождаться
+    void startWaiting() {
+        while (m_running < m_maxConcurrent && !m_waiting.isEmpty()) {
+            QPair<std::shared_ptr<Job>, ExportJobFn> next = m_waiting.takeFirst();
+            ++m_running;
+            m_scheduler->post([this, job = next.first, fn = next.second]() {
+                job->run(fn);
+                std::lock_guard<std::mutex> lock(m_runMutex);
+                --m_running;
+                startWaiting();
+                m_idle.notify_all();
+            }, TaskPriority::Normal);
+        }
+    }
+
+    WorkScheduler *m_scheduler;
+    mutable std::mutex m_runMutex;
+    std::condition_variable m_idle;
+    QList<QPair<std::shared_ptr<Job>, ExportJobFn>> m_waiting;
+    int m_running = 0;
+    int m_maxConcurrent = 2;
+    QMutex m_mutex;
+    QMap<int, std::shared_ptr<Job>> m_jobs;
+    std::atomic<int> m_lastId{0};
+};
+
+// Панель со списком заданий: прогресс, оставшееся время и кнопка отмены
+class ExportJobsPanel : public QWidget {
+    Q_OBJECT
+public:
+    explicit ExportJobsPanel(ExportJobManager *manager, QWidget *parent = nullptr)
+        : QWidget(parent), m_manager(manager) {
+        QVBoxLayout *layout = new QVBoxLayout(this);
+        QFormLayout *form = new QFormLayout;
+        QSpinBox *limit = new QSpinBox;
+        limit->setRange(1, 16);
+        limit->setValue(manager->maxConcurrent());
+        connect(limit, QOverload<int>::of(&QSpinBox::valueChanged), manager, &ExportJobManager::setMaxConcurrent);
+        form->addRow("Одновременных экспортов:", limit);
+        layout->addLayout(form);
+        m_rows = new QVBoxLayout;
+        layout->addLayout(m_rows);
+        layout->addStretch(1);
+
+        connect(manager, &ExportJobManager::jobAdded, this, &ExportJobsPanel::onJobAdded);
+        connect(manager, &ExportJobManager::jobStarted, this, &ExportJobsPanel::onJobStarted);
+        connect(manager, &ExportJobManager::jobProgress, this, &ExportJobsPanel::onJobProgress);
+        connect(manager, &ExportJobManager::jobFinished, this, &ExportJobsPanel::onJobFinished);
+    }
+
+private slots:
+    void onJobAdded(int id, const QString &title) {
+        Row row;
+        row.widget = new QWidget;
+        QHBoxLayout *h = new QHBoxLayout(row.widget);
+        h->setContentsMargins(0, 0, 0, 0);
+        h->addWidget(new QLabel(title));
+        row.progress = new QProgressBar;
+        row.progress->setRange(0, 1000);
+        row.progress->setValue(0);
+        h->addWidget(row.progress, 1);
+        row.status = new QLabel("В очереди");
+        h->addWidget(row.status);
+        row.button = new QPushButton("Отмена");
+        connect(row.button, &QPushButton::clicked, this, [this, id]() {
+            auto it = m_jobRows.find(id);
+            if (it == m_jobRows.end())
+                return;
+            if (it->finished) {
+                it->widget->deleteLater();
+                m_jobRows.erase(it);
+            } else {
+                m_manager->cancel(id);
+                it->status->setText("Отмена...");
+            }
+        });
+        h->addWidget(row.button);
+        m_rows->addWidget(row.widget);
+        m_jobRows.insert(id, row);
+    }
+
+    void onJobStarted(int id) {
+        auto it = m_jobRows.find(id);
+        if (it != m_jobRows.end())
+            it->status->setText("Выполняется");
+    }
+
+    void onJobProgress(int id, double fraction, const QString &stage, qint64 etaMs) {
+        auto it = m_jobRows.find(id);
+        if (it == m_jobRows.end())
+            return;
+        it->progress->setValue(static_cast<int>(fraction * 1000));
+        QString eta = etaMs >= 0 ? QString(", осталось ~%1 с").arg((etaMs + 999) / 1000) : QString();
+        it->status->setText(stage + eta);
+    }
+
+    void onJobFinished(int id, bool ok, bool cancelled, const QString &message) {
+        auto it = m_jobRows.find(id);
+        if (it == m_jobRows.end())
+            return;
+        it->finished = true;
+        if (ok)
+            it->progress->setValue(1000);
+        it->status->setText(ok ? QString("Готово") : (cancelled ? QString("Отменено") : QString("Ошибка: %1").arg(message)));
+        it->status->setToolTip(message);
+        it->button->setText("Убрать");
+    }
+
+private:
+    struct Row {
+        QWidget *widget = nullptr;
+        QProgressBar *progress = nullptr;
+        QLabel *status = nullptr;
+        QPushButton *button = nullptr;
+        bool finished = false;
+    };
+
+    ExportJobManager *m_manager;
+    QVBoxLayout *m_rows;
+    QMap<int, Row> m_jobRows;
+};
+
+#endif // EXPORT_JOBS_H
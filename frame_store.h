@@ -0,0 +1,403 @@
+// frame_store.h
+// Хранилище ASCII-кадров с ограничением памяти: кадры сверх бюджета сжимаются
+// и выгружаются во временный файл, который читается через отображение в память
+
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QTemporaryFile>
+#include <QWaitCondition>
+#include <QDir>
+#include <QFile>
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "ascii_core.h"
+
+// Пиковый размер резидентной памяти процесса в байтах (0, если неизвестен)
+inline qint64 peakRssBytes() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return static_cast<qint64>(pmc.PeakWorkingSetSize);
+    return 0;
+#elif defined(Q_OS_LINUX)
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly)) {
+        for (const QByteArray &line : status.readAll().split('\n')) {
+            if (line.startsWith("VmHWM:"))
+                return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+        }
+    }
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(Q_OS_MACOS)
+    return static_cast<qint64>(usage.ru_maxrss);
+#else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+class FrameStore {
+public:
+    struct Stats {
+        size_t frames = 0;
+        size_t spilledFrames = 0;
+        qint64 residentBytes = 0;
+        qint64 spilledBytes = 0;    // сжатый размер во временном файле
+        quint64 pageIns = 0;        // сколько раз кадр подгружался с диска
+        double avgPageInMs = 0.0;
+        double maxPageInMs = 0.0;
+        qint64 peakRss = 0;
+    };
+
+    explicit FrameStore(qint64 budgetBytes = 256ll * 1024 * 1024) : m_budget(budgetBytes) {}
+    ~FrameStore() { clear(); }
+
+    FrameStore(const FrameStore &) = delete;
+    FrameStore &operator=(const FrameStore &) = delete;
+
+    void setBudget(qint64 budgetBytes) {
+        QMutexLocker lock(&m_mutex);
+        m_budget = budgetBytes;
+    }
+
+    void clear() {
+        QMutexLocker lock(&m_mutex);
+        ++m_generation;
+        m_slots.clear();
+        m_cache.clear();
+        m_residentBytes = 0;
+        m_spilledBytes = 0;
+        m_spilledFrames = 0;
+        m_pageIns = 0;
+        m_pageInTotalMs = 0.0;
+        m_pageInMaxMs = 0.0;
+        unmapLocked();
+        if (m_file) {
+            m_file->close();
+            delete m_file;
+            m_file = nullptr;
+        }
+        m_fileSize = 0;
+    }
+
+    size_t size() const {
+        QMutexLocker lock(&m_mutex);
+        return m_slots.size();
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Добавление кадра в конец; при превышении бюджета кадр сразу уходит на диск
+    void append(AsciiFrame frame) {
+        QMutexLocker lock(&m_mutex);
+        Slot slot;
+        qint64 cost = frameBytes(frame);
+        if (m_residentBytes + cost <= m_budget || !spillLocked(frame, slot)) {
+            slot.resident = std::move(frame);
+            slot.inMemory = true;
+            m_residentBytes += cost;
+        }
+        m_slots.push_back(std::move(slot));
+    }
+
+    // Кадр с номером index (для конвертации несколькими потоками не по порядку).
+    // Недостающие кадры до index остаются пустыми, пока их не запишут; прежний кадр заменяется
+    void put(size_t index, AsciiFrame frame) {
+        QMutexLocker lock(&m_mutex);
+        if (index >= m_slots.size())
+            m_slots.resize(index + 1);
+        releaseLocked(m_slots[index]);
+        m_cache.erase(index);
+        Slot &slot = m_slots[index];
+        qint64 cost = frameBytes(frame);
+        if (m_residentBytes + cost <= m_budget || !spillLocked(frame, slot)) {
+            slot.resident = std::move(frame);
+            slot.inMemory = true;
+            m_residentBytes += cost;
+        }
+    }
+
+    // Оставить первые count кадров
+    void truncate(size_t count) {
+        QMutexLocker lock(&m_mutex);
+        if (count >= m_slots.size())
+            return;
+        for (size_t i = count; i < m_slots.size(); ++i)
+            releaseLocked(m_slots[i]);
+        m_slots.resize(count);
+        m_cache.erase(m_cache.lower_bound(count), m_cache.end());
+    }
+
+    // Кадр по индексу. Выгруженные кадры распаковываются из отображённого файла
+    // вместе с несколькими следующими (упреждающее чтение для воспроизведения и экспорта).
+    // Вызывается из нескольких потоков сразу: под блокировкой только копируются сжатые
+    // записи, распаковка идёт вне её; кадр, который уже распаковывает другой поток, ожидается
+    AsciiFrame at(size_t index) {
+        std::vector<PageIn> jobs;
+        quint64 generation = 0;
+        {
+            QMutexLocker lock(&m_mutex);
+            for (;;) {
+                if (index >= m_slots.size())
+                    return AsciiFrame();
+                const Slot &slot = m_slots[index];
+                if (slot.inMemory)
+                    return slot.resident;
+                auto cached = m_cache.find(index);
+                if (cached != m_cache.end()) {
+                    cached->second.served = true;
+                    return cached->second.frame;
+                }
+                if (!m_decoding.count(index))
+                    break;
+                m_decoded.wait(&m_mutex);
+            }
+            for (size_t next = index; next < m_slots.size() && next <= index + kReadAhead; ++next) {
+                const Slot &slot = m_slots[next];
+                if (next > index && (slot.inMemory || m_cache.count(next) || m_decoding.count(next)))
+                    continue;
+                PageIn job;
+                job.index = next;
+                job.offset = slot.offset;
+                if (!readRecordLocked(slot, job.record)) {
+                    if (next == index)
+                        return AsciiFrame();
+                    continue;
+                }
+                m_decoding.insert(next);
+                jobs.push_back(std::move(job));
+            }
+            generation = m_generation;
+            ++m_readers;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        double ms = 0.0;
+        for (PageIn &job : jobs) {
+            job.ok = decodeRecord(job.record, job.frame);
+            job.record = QByteArray();
+            if (job.index == index)
+                ms = timer.nsecsElapsed() / 1e6;
+        }
+
+        QMutexLocker lock(&m_mutex);
+        --m_readers;
+        for (PageIn &job : jobs) {
+            m_decoding.erase(job.index);
+            // Слот мог быть заменён (put, truncate, clear), пока кадр распаковывался
+            if (!job.ok || generation != m_generation || job.index >= m_slots.size() ||
+                m_slots[job.index].inMemory || m_slots[job.index].offset != job.offset)
+                continue;
+            Cached &entry = m_cache[job.index];
+            entry.served = job.index == index;
+            if (job.index == index)
+                entry.frame = job.frame;
+            else
+                entry.frame = std::move(job.frame);
+        }
+        m_decoded.wakeAll();
+        if (jobs.empty() || !jobs.front().ok)
+            return AsciiFrame();
+        ++m_pageIns;
+        m_pageInTotalMs += ms;
+        m_pageInMaxMs = std::max(m_pageInMaxMs, ms);
+
+        // Позади текущего удаляются только уже выданные кадры: упреждающие кадры других
+        // потоков, читающих не по порядку, ещё нужны. Сверх предела отбрасываются дальние
+        for (auto it = m_cache.begin(); it != m_cache.end() && it->first < index;)
+            it = it->second.served ? m_cache.erase(it) : std::next(it);
+        while (m_cache.size() > (2 + m_readers) * kReadAhead + 1)
+            m_cache.erase(std::prev(m_cache.end()));
+        return jobs.front().frame;
+    }
+
+    Stats stats() const {
+        QMutexLocker lock(&m_mutex);
+        Stats s;
+        s.frames = m_slots.size();
+        s.spilledFrames = m_spilledFrames;
+        s.residentBytes = m_residentBytes;
+        s.spilledBytes = m_spilledBytes;
+        s.pageIns = m_pageIns;
+        s.avgPageInMs = m_pageIns ? m_pageInTotalMs / m_pageIns : 0.0;
+        s.maxPageInMs = m_pageInMaxMs;
+        s.peakRss = peakRssBytes();
+        return s;
+    }
+
+private:
+    struct Slot {
+        bool inMemory = false;
+        AsciiFrame resident;
+        qint64 offset = 0;
+        qint64 length = 0;
+    };
+
+    static const size_t kReadAhead = 8;
+
+    struct Cached {
+        AsciiFrame frame;
+        bool served = false;   // уже выдан вызывающему (упреждающий - ещё нет)
+    };
+
+    // Запись, распаковываемая вне блокировки
+    struct PageIn {
+        size_t index = 0;
+        qint64 offset = 0;
+        QByteArray record;
+        AsciiFrame frame;
+        bool ok = false;
+    };
+
+    static qint64 frameBytes(const AsciiFrame &frame) {
+        return static_cast<qint64>(frame.glyphs.size()) * 4 + static_cast<qint64>(sizeof(AsciiFrame));
+    }
+
+    // Учёт освобождаемого слота; выгруженные данные остаются в файле до clear()
+    void releaseLocked(Slot &slot) {
+        if (slot.inMemory) {
+            m_residentBytes -= frameBytes(slot.resident);
+        } else if (slot.length > 0) {
+            m_spilledBytes -= slot.length;
+            --m_spilledFrames;
+        }
+        slot = Slot();
+    }
+
+    // Формат записи: cols, rows (по 4 байта), затем qCompress(символы + BGR ячеек)
+    bool spillLocked(const AsciiFrame &frame, Slot &slot) {
+        if (!m_file) {
+            m_file = new QTemporaryFile(QDir::tempPath() + "/ascii_frames_XXXXXX.bin");
+            if (!m_file->open()) {
+                delete m_file;
+                m_file = nullptr;
+                return false;
+            }
+        }
+        const int cells = frame.cols * frame.rows;
+        QByteArray raw(cells * 4, Qt::Uninitialized);
+        std::memcpy(raw.data(), frame.glyphs.data(), cells);
+        for (int row = 0; row < frame.rows; ++row)
+            std::memcpy(raw.data() + cells + row * frame.cols * 3, frame.colors.ptr(row), frame.cols * 3);
+        QByteArray packed = qCompress(raw, 1);
+        qint32 header[2] = {frame.cols, frame.rows};
+
+        if (!m_file->seek(m_fileSize))
+            return false;
+        if (m_file->write(reinterpret_cast<const char *>(header), sizeof(header)) != sizeof(header) ||
+            m_file->write(packed) != packed.size())
+            return false;
+        slot.offset = m_fileSize;
+        slot.length = static_cast<qint64>(sizeof(header)) + packed.size();
+        m_fileSize += slot.length;
+        m_spilledBytes += slot.length;
+        ++m_spilledFrames;
+        return true;
+    }
+
+    // Копия сжатой записи слота из отображённого файла
+    bool readRecordLocked(const Slot &slot, QByteArray &record) {
+        if (!m_file || slot.length == 0)   // пустой слот: кадр ещё не записан
+            return false;
+        if (!m_map || slot.offset + slot.length > m_mapSize) {
+            // Файл вырос с момента прошлого отображения - отображаем заново целиком
+            unmapLocked();
+            m_file->flush();
+            m_map = m_file->map(0, m_fileSize);
+            if (!m_map)
+                return false;
+            m_mapSize = m_fileSize;
+        }
+        record = QByteArray(reinterpret_cast<const char *>(m_map + slot.offset), static_cast<qsizetype>(slot.length));
+        return true;
+    }
+
+    static bool decodeRecord(const QByteArray &record, AsciiFrame &frame) {
+        qint32 header[2];
+        if (record.size() < static_cast<qsizetype>(sizeof(header)))
+            return false;
+        std::memcpy(header, record.constData(), sizeof(header));
+        QByteArray raw = qUncompress(reinterpret_cast<const uchar *>(record.constData()) + sizeof(header),
+                                     record.size() - static_cast<qsizetype>(sizeof(header)));
+        const int cells = header[0] * header[1];
+        if (raw.size() != cells * 4)
+            return false;
+        frame.cols = header[0];
+        frame.rows = header[1];
+        frame.glyphs.assign(raw.constData(), raw.constData() + cells);
+        frame.colors.create(frame.rows, frame.cols, CV_8UC3);
+        for (int row = 0; row < frame.rows; ++row)
+            std::memcpy(frame.colors.ptr(row), raw.constData() + cells + row * frame.cols * 3, frame.cols * 3);
+        return true;
+    }
+
+    void unmapLocked() {
+        if (m_map && m_file)
+            m_file->unmap(m_map);
+        m_map = nullptr;
+        m_mapSize = 0;
+    }
+
+    mutable QMutex m_mutex;
+    qint64 m_budget;
+    std::vector<Slot> m_slots;
+    QWaitCondition m_decoded;             // распаковка одного из m_decoding закончилась
+    std::map<size_t, Cached> m_cache;
+    std::set<size_t> m_decoding;          // распаковываются вне блокировки
+    size_t m_readers = 0;                 // потоков распаковывает сейчас
+    quint64 m_generation = 0;             // меняется при clear(): смещения прежнего файла недействительны
+    qint64 m_residentBytes = 0;
+    qint64 m_spilledBytes = 0;
+    size_t m_spilledFrames = 0;
+    quint64 m_pageIns = 0;
+    double m_pageInTotalMs = 0.0;
+    double m_pageInMaxMs = 0.0;
+    QTemporaryFile *m_file = nullptr;
+    qint64 m_fileSize = 0;
+    uchar *m_map = nullptr;
+    qint64 m_mapSize = 0;
+};
+
+// Строка состояния хранилища для интерфейса
+inline QString frameStoreStatus(const FrameStore::Stats &s) {
+    const double mb = 1024.0 * 1024.0;
+    return QString("Кадров: %1 | в памяти: %2 МБ | на диске: %3 кадров, %4 МБ | подкачка: %5 (ср. %6 мс, макс. %7 мс) | пик RSS: %8 МБ")
+        .arg(s.frames)
+        .arg(s.residentBytes / mb, 0, 'f', 1)
+        .arg(s.spilledFrames)
+        .arg(s.spilledBytes / mb, 0, 'f', 1)
+        .arg(s.pageIns)
+        .arg(s.avgPageInMs, 0, 'f', 2)
+        .arg(s.maxPageInMs, 0, 'f', 2)
+        .arg(s.peakRss / mb, 0, 'f', 0);
+}
+
+#endif // FRAME_STORE_H
@@ -0,0 +1,410 @@
+// gif_encoder.h
+// Кодировщик анимированного GIF для ASCII-кадров: общая палитра строится прямо
+// из цветов ячеек, каждый кадр записывается как прямоугольник изменившихся пикселей
+// (неизменные внутри него - прозрачные), LZW-сжатие кадров независимо и может
+// выполняться параллельно, а запись идёт строго по порядку
+
+#ifndef GIF_ENCODER_H
+#define GIF_ENCODER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+namespace gif_detail {
+
+constexpr int kBinBits = 5;  // бит на канал в гистограмме цветов
+constexpr int kBins = 1 << (3 * kBinBits);
+constexpr int kLzwHashSize = 8192;
+
+inline int binOf(int b, int g, int r) {
+    constexpr int shift = 8 - kBinBits;
+    return ((r >> shift) << (2 * kBinBits)) | ((g >> shift) << kBinBits) | (b >> shift);
+}
+
+inline void putLe16(std::vector<uint8_t> &out, int v) {
+    out.push_back(static_cast<uint8_t>(v & 0xFF));
+    out.push_back(static_cast<uint8_t>((v >> 8) & 0xFF));
+}
+
+// LZW-сжатие индексов с разбиением на блоки по 255 байт (формат данных изображения GIF)
+inline void lzwCompress(const std::vector<uint8_t> &indices, int minCodeSize, std::vector<uint8_t> &out) {
+    const int clearCode = 1 << minCodeSize;
+    const int eoiCode = clearCode + 1;
+    int codeSize = minCodeSize + 1;
+    int maxCode = eoiCode;
+    std::vector<int32_t> keys(kLzwHashSize, -1);
+    std::vector<int16_t> codes(kLzwHashSize, 0);
+
+    std::vector<uint8_t> packed;
+    packed.reserve(indices.size() / 2 + 16);
+    uint32_t bitBuf = 0;
+    int bitCount = 0;
+    auto put = [&](int code, int size) {
+        bitBuf |= static_cast<uint32_t>(code) << bitCount;
+        bitCount += size;
+        while (bitCount >= 8) {
+            packed.push_back(static_cast<uint8_t>(bitBuf & 0xFF));
+            bitBuf >>= 8;
+            bitCount -= 8;
+        }
+    };
+
+    put(clearCode, codeSize);
+    if (!indices.empty()) {
+        int cur = indices[0];
+        for (size_t i = 1; i < indices.size(); ++i) {
+            const int next = indices[i];
+            const int32_t key = (cur << 8) | next;
+            uint32_t h = (static_cast<uint32_t>(key) * 2654435761u) >> (32 - 13);
+            while (keys[h] != -1 && keys[h] != key)
+                h = (h + 1) & (kLzwHashSize - 1);
+            if (keys[h] == key) {
+                cur = codes[h];
+                continue;
+            }
+            put(cur, codeSize);
+            keys[h] = key;
+            codes[h] = static_cast<int16_t>(++maxCode);
+            if (maxCode >= (1 << codeSize))
+                ++codeSize;
+            if (maxCode == 4095) {
+                put(clearCode, codeSize);
+                std::fill(keys.begin(), keys.end(), -1);
+                codeSize = minCodeSize + 1;
+                maxCode = eoiCode;
+            }
+            cur = next;
+        }
+        put(cur, codeSize);
+        put(clearCode, codeSize);
+    }
+    put(eoiCode, minCodeSize + 1);
+    if (bitCount > 0)
+        packed.push_back(static_cast<uint8_t>(bitBuf & 0xFF));
+
+    out.push_back(static_cast<uint8_t>(minCodeSize));
+    for (size_t pos = 0; pos < packed.size(); pos += 255) {
+        const size_t len = std::min<size_t>(255, packed.size() - pos);
+        out.push_back(static_cast<uint8_t>(len));
+        out.insert(out.end(), packed.begin() + pos, packed.begin() + pos + len);
+    }
+    out.push_back(0);
+}
+
+} // namespace gif_detail
+
+// Палитра GIF: индекс 0 - черный фон, дальше цвета ячеек; индекс size() - прозрачный
+class GifPalette {
+public:
+    GifPalette() : m_colors{cv::Vec3b(0, 0, 0)} { buildLookup(); }
+    explicit GifPalette(std::vector<cv::Vec3b> colors) : m_colors(std::move(colors)) {
+        if (m_colors.empty())
+            m_colors.push_back(cv::Vec3b(0, 0, 0));
+        buildLookup();
+    }
+
+    const std::vector<cv::Vec3b> &colors() const { return m_colors; }
+    int size() const { return static_cast<int>(m_colors.size()); }
+    int transparentIndex() const { return size(); }
+
+    // Ближайший цвет палитры для BGR-цвета (по таблице 5 бит на канал)
+    uint8_t indexOf(const cv::Vec3b &bgr) const { return m_lookup[gif_detail::binOf(bgr[0], bgr[1], bgr[2])]; }
+
+private:
+    void buildLookup() {
+        using namespace gif_detail;
+        m_lookup.assign(kBins, 0);
+        constexpr int shift = 8 - kBinBits;
+        constexpr int half = 1 << (shift - 1);
+        for (int bin = 0; bin < kBins; ++bin) {
+            const int r = ((bin >> (2 * kBinBits)) << shift) + half;
+            const int g = (((bin >> kBinBits) & ((1 << kBinBits) - 1)) << shift) + half;
+            const int b = ((bin & ((1 << kBinBits) - 1)) << shift) + half;
+            int best = 0, bestDist = 1 << 30;
+            for (size_t i = 0; i < m_colors.size(); ++i) {
+                const int db = b - m_colors[i][0], dg = g - m_colors[i][1], dr = r - m_colors[i][2];
+                const int dist = 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = static_cast<int>(i);
+                }
+            }
+            m_lookup[bin] = static_cast<uint8_t>(best);
+        }
+    }
+
+    std::vector<cv::Vec3b> m_colors;
+    std::vector<uint8_t> m_lookup;
+};
+
+// Сбор цветов ячеек всех кадров и построение общей палитры. Пока различных
+// цветов (5 бит на канал) не больше maxColors, палитра их повторяет; иначе
+// применяется медианное сечение с весами по числу ячеек
+class GifPaletteBuilder {
+public:
+    GifPaletteBuilder() : m_bins(gif_detail::kBins) {}
+
+    void add(const cv::Mat &colors) {
+        for (int row = 0; row < colors.rows; ++row) {
+            const cv::Vec3b *p = colors.ptr<cv::Vec3b>(row);
+            for (int col = 0; col < colors.cols; ++col) {
+                Bin &bin = m_bins[gif_detail::binOf(p[col][0], p[col][1], p[col][2])];
+                bin.sum[0] += p[col][0];
+                bin.sum[1] += p[col][1];
+                bin.sum[2] += p[col][2];
+                ++bin.count;
+            }
+        }
+    }
+
+    // maxColors - число цветов ячеек (черный фон добавляется отдельно, всего не больше 255)
+    GifPalette build(int maxColors = 254) const {
+        maxColors = std::clamp(maxColors, 1, 254);
+        struct Entry { int c[3]; uint64_t count; };
+        std::vector<Entry> entries;
+        for (const Bin &bin : m_bins) {
+            if (!bin.count)
+                continue;
+            Entry e;
+            for (int ch = 0; ch < 3; ++ch)
+                e.c[ch] = static_cast<int>((bin.sum[ch] + bin.count / 2) / bin.count);
+            e.count = bin.count;
+            entries.push_back(e);
+        }
+
+        // Медианное сечение: коробки - диапазоны в entries
+        struct Box { size_t begin, end; };
+        std::vector<Box> boxes;
+        if (!entries.empty())
+            boxes.push_back({0, entries.size()});
+        auto spread = [&](const Box &box, int &channel) {
+            int best = -1;
+            for (int ch = 0; ch < 3; ++ch) {
+                int lo = 255, hi = 0;
+                for (size_t i = box.begin; i < box.end; ++i) {
+                    lo = std::min(lo, entries[i].c[ch]);
+                    hi = std::max(hi, entries[i].c[ch]);
+                }
+                if (hi - lo > best) {
+                    best = hi - lo;
+                    channel = ch;
+                }
+            }
+            return best;
+        };
+        while (static_cast<int>(boxes.size()) < maxColors) {
+            int pick = -1, pickChannel = 0, pickSpread = 0;
+            for (size_t i = 0; i < boxes.size(); ++i) {
+                if (boxes[i].end - boxes[i].begin < 2)
+                    continue;
+                int channel = 0;
+                int s = spread(boxes[i], channel);
+                if (s > pickSpread) {
+                    pickSpread = s;
+                    pick = static_cast<int>(i);
+                    pickChannel = channel;
+                }
+            }
+            if (pick < 0)
+                break;
+            Box box = boxes[pick];
+            std::sort(entries.begin() + box.begin, entries.begin() + box.end,
+                      [pickChannel](const Entry &a, const Entry &b) { return a.c[pickChannel] < b.c[pickChannel]; });
+            uint64_t total = 0, acc = 0;
+            for (size_t i = box.begin; i < box.end; ++i)
+                total += entries[i].count;
+            size_t split = box.begin + 1;
+            for (size_t i = box.begin; i + 1 < box.end; ++i) {
+                acc += entries[i].count;
+                split = i + 1;
+                if (acc * 2 >= total)
+                    break;
+            }
+            boxes[pick] = {box.begin, split};
+            boxes.push_back({split, box.end});
+        }
+
+        std::vector<cv::Vec3b> colors{cv::Vec3b(0, 0, 0)};
+        for (const Box &box : boxes) {
+            uint64_t sum[3] = {0, 0, 0}, count = 0;
+            for (size_t i = box.begin; i < box.end; ++i) {
+                for (int ch = 0; ch < 3; ++ch)
+                    sum[ch] += static_cast<uint64_t>(entries[i].c[ch]) * entries[i].count;
+                count += entries[i].count;
+            }
+            cv::Vec3b c(static_cast<uint8_t>(sum[0] / count), static_cast<uint8_t>(sum[1] / count),
+                        static_cast<uint8_t>(sum[2] / count));
+            if (c != cv::Vec3b(0, 0, 0))
+                colors.push_back(c);
+        }
+        return GifPalette(std::move(colors));
+    }
+
+private:
+    struct Bin {
+        uint64_t sum[3] = {0, 0, 0};
+        uint64_t count = 0;
+    };
+    std::vector<Bin> m_bins;
+};
+
+// Минимальный размер кода LZW для палитры с прозрачным индексом
+inline int gifMinCodeSize(const GifPalette &palette) {
+    int bits = 1;
+    while ((1 << bits) < palette.size() + 1)
+        ++bits;
+    return std::max(2, bits);
+}
+
+// Кодирование кадра cur (индексы width x height) относительно prev (nullptr - полный кадр).
+// В out записывается дескриптор изображения и сжатые данные прямоугольника изменений;
+// пиксели, совпадающие с prev, заменяются прозрачным индексом.
+// Возвращает false (out пуст), если кадр не отличается от предыдущего
+inline bool encodeGifFrame(const uint8_t *cur, const uint8_t *prev, int width, int height,
+                           int transparentIndex, int minCodeSize, std::vector<uint8_t> &out) {
+    out.clear();
+    int top = 0, bottom = height - 1, left = 0, right = width - 1;
+    if (prev) {
+        top = height;
+        bottom = -1;
+        for (int y = 0; y < height; ++y) {
+            if (std::memcmp(cur + static_cast<size_t>(y) * width, prev + static_cast<size_t>(y) * width, width) != 0) {
+                top = std::min(top, y);
+                bottom = y;
+            }
+        }
+        if (bottom < 0)
+            return false;
+        left = width;
+        right = -1;
+        for (int y = top; y <= bottom; ++y) {
+            const uint8_t *c = cur + static_cast<size_t>(y) * width;
+            const uint8_t *p = prev + static_cast<size_t>(y) * width;
+            for (int x = 0; x < left; ++x) {
+                if (c[x] != p[x]) {
+                    left = x;
+                    break;
+                }
+            }
+            for (int x = width - 1; x > right; --x) {
+                if (c[x] != p[x]) {
+                    right = x;
+                    break;
+                }
+            }
+        }
+    }
+    const int w = right - left + 1, h = bottom - top + 1;
+    std::vector<uint8_t> indices(static_cast<size_t>(w) * h);
+    for (int y = 0; y < h; ++y) {
+        const size_t offset = static_cast<size_t>(top + y) * width + left;
+        uint8_t *dst = indices.data() + static_cast<size_t>(y) * w;
+        if (!prev) {
+            std::memcpy(dst, cur + offset, w);
+            continue;
+        }
+        for (int x = 0; x < w; ++x)
+            dst[x] = cur[offset + x] == prev[offset + x] ? static_cast<uint8_t>(transparentIndex) : cur[offset + x];
+    }
+
+    out.push_back(0x2C);
+    gif_detail::putLe16(out, left);
+    gif_detail::putLe16(out, top);
+    gif_detail::putLe16(out, w);
+    gif_detail::putLe16(out, h);
+    out.push_back(0);
+    gif_detail::lzwCompress(indices, minCodeSize, out);
+    return true;
+}
+
+// Последовательная запись GIF. Неизменившиеся кадры не записываются - их длительность
+// прибавляется к предыдущему кадру
+class GifWriter {
+public:
+    bool open(const std::string &path, int width, int height, const GifPalette &palette) {
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_file)
+            return false;
+        m_transparent = palette.transparentIndex();
+        int bits = 1;
+        while ((1 << bits) < palette.size() + 1)
+            ++bits;
+
+        std::vector<uint8_t> head = {'G', 'I', 'F', '8', '9', 'a'};
+        gif_detail::putLe16(head, width);
+        gif_detail::putLe16(head, height);
+        head.push_back(static_cast<uint8_t>(0x80 | ((bits - 1) << 4) | (bits - 1)));
+        head.push_back(0);
+        head.push_back(0);
+        for (int i = 0; i < (1 << bits); ++i) {
+            cv::Vec3b c = i < palette.size() ? palette.colors()[i] : cv::Vec3b(0, 0, 0);
+            head.push_back(c[2]);
+            head.push_back(c[1]);
+            head.push_back(c[0]);
+        }
+        // Бесконечный повтор (расширение NETSCAPE2.0)
+        const uint8_t loop[] = {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+                                0x03, 0x01, 0x00, 0x00, 0x00};
+        head.insert(head.end(), loop, loop + sizeof(loop));
+        write(head);
+        return static_cast<bool>(m_file);
+    }
+
+    // block - результат encodeGifFrame (пустой - кадр не изменился), delayCs - длительность в сотых секунды
+    void addFrame(std::vector<uint8_t> &block, int delayCs) {
+        if (block.empty()) {
+            m_pendingDelay += delayCs;
+            return;
+        }
+        flushPending();
+        m_pending.swap(block);
+        m_pendingDelay = delayCs;
+    }
+
+    bool close() {
+        flushPending();
+        const uint8_t trailer = 0x3B;
+        m_file.write(reinterpret_cast<const char *>(&trailer), 1);
+        ++m_bytes;
+        m_file.close();
+        return !m_file.fail();
+    }
+
+    uint64_t bytesWritten() const { return m_bytes; }
+    size_t framesWritten() const { return m_frames; }
+
+private:
+    void flushPending() {
+        if (m_pending.empty())
+            return;
+        std::vector<uint8_t> gce = {0x21, 0xF9, 0x04, static_cast<uint8_t>((1 << 2) | 1)};
+        gif_detail::putLe16(gce, std::clamp(m_pendingDelay, 0, 65535));
+        gce.push_back(static_cast<uint8_t>(m_transparent));
+        gce.push_back(0);
+        write(gce);
+        write(m_pending);
+        m_pending.clear();
+        m_pendingDelay = 0;
+        ++m_frames;
+    }
+
+    void write(const std::vector<uint8_t> &bytes) {
+        m_file.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        m_bytes += bytes.size();
+    }
+
+    std::ofstream m_file;
+    int m_transparent = 0;
+    std::vector<uint8_t> m_pending;
+    int m_pendingDelay = 0;
+    uint64_t m_bytes = 0;
+    size_t m_frames = 0;
+};
+
+#endif // GIF_ENCODER_H
@@ -0,0 +1,156 @@
+// html_export.h
+// Компактная сериализация ASCII-кадра в HTML: соседние ячейки близкого цвета
+// объединяются в один span, цвета можно свести к палитре с короткими CSS-классами
+
+#ifndef HTML_EXPORT_H
+#define HTML_EXPORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+struct HtmlOptions {
+    bool blackWhite = false;     // без цвета, только символы
+    int colorTolerance = 4;      // максимальное отличие канала для слияния ячеек в один span
+    bool usePalette = false;     // квантовать цвета в палитру и ссылаться на неё CSS-классами
+    int paletteLevels = 6;       // уровней на канал в палитре (6 -> 216 классов)
+    const char *lineBreak = "\n";  // "\n" для <pre>, "<br>" для фрагментов QTextEdit
+};
+
+namespace html_detail {
+
+inline void appendEscaped(std::string &out, const std::string &glyph) {
+    if (glyph.size() == 1) {
+        switch (glyph[0]) {
+        case '<': out += "&lt;"; return;
+        case '>': out += "&gt;"; return;
+        case '&': out += "&amp;"; return;
+        default: break;
+        }
+    }
+    out += glyph;
+}
+
+inline void appendHexColor(std::string &out, int r, int g, int b) {
+    char buf[8];
+    std::snprintf(buf, sizeof(buf), "#%02x%02x%02x", r, g, b);
+    out += buf;
+}
+
+inline bool isBlank(const std::string &glyph) {
+    return glyph.empty() || glyph == " ";
+}
+
+// Индекс цвета в палитре levels^3 и обратное преобразование в значение канала
+inline int paletteIndex(int r, int g, int b, int levels) {
+    auto q = [levels](int v) { return (v * (levels - 1) + 127) / 255; };
+    return (q(r) * levels + q(g)) * levels + q(b);
+}
+
+inline int paletteChannel(int index, int levels) {
+    return index * 255 / (levels - 1);
+}
+
+} // namespace html_detail
+
+// Разметка тела кадра (без обёртки документа). Пробельные символы не меняют цвет
+// текущего span, поэтому они присоединяются к нему независимо от цвета ячейки.
+// usedClasses (если задан) отмечает индексы палитры, встретившиеся в кадре.
+// Разметка заменяет содержимое out, выделенная им память переиспользуется
+inline void asciiFrameToHtmlBody(const AsciiFrame &frame, const std::vector<std::string> &glyphs,
+                                 const HtmlOptions &opts, std::string &out, std::vector<bool> *usedClasses = nullptr) {
+    using namespace html_detail;
+    out.clear();
+    out.reserve(static_cast<size_t>(frame.rows) * frame.cols * 2);
+    const int levels = std::max(2, opts.paletteLevels);
+    for (int row = 0; row < frame.rows; ++row) {
+        const cv::Vec3b *colors = frame.colors.ptr<cv::Vec3b>(row);
+        const uint8_t *cells = frame.glyphs.data() + static_cast<size_t>(row) * frame.cols;
+        bool open = false;
+        int runR = 0, runG = 0, runB = 0, runClass = -1;
+        for (int col = 0; col < frame.cols; ++col) {
+            const std::string &glyph = glyphs[std::min<size_t>(cells[col], glyphs.size() - 1)];
+            if (opts.blackWhite || (open && isBlank(glyph))) {
+                appendEscaped(out, glyph);
+                continue;
+            }
+            int b = colors[col][0], g = colors[col][1], r = colors[col][2];
+            bool same;
+            int cls = -1;
+            if (opts.usePalette) {
+                cls = paletteIndex(r, g, b, levels);
+                same = open && cls == runClass;
+            } else {
+                same = open && std::abs(r - runR) <= opts.colorTolerance &&
+                       std::abs(g - runG) <= opts.colorTolerance &&
+                       std::abs(b - runB) <= opts.colorTolerance;
+            }
+            if (!same) {
+                if (open)
+                    out += "</span>";
+                if (opts.usePalette) {
+                    char name[32];
+                    std::snprintf(name, sizeof(name), "<span class=c%d>", cls);
+                    out += name;
+                    if (usedClasses)
+                        (*usedClasses)[cls] = true;
+                } else {
+                    out += "<span style=\"color:";
+                    appendHexColor(out, r, g, b);
+                    out += "\">";
+                }
+                open = true;
+                runR = r; runG = g; runB = b; runClass = cls;
+            }
+            appendEscaped(out, glyph);
+        }
+        if (open)
+            out += "</span>";
+        if (row + 1 < frame.rows)
+            out += opts.lineBreak;
+    }
+}
+
+inline std::string asciiFrameToHtmlBody(const AsciiFrame &frame, const std::vector<std::string> &glyphs,
+                                        const HtmlOptions &opts, std::vector<bool> *usedClasses = nullptr) {
+    std::string out;
+    asciiFrameToHtmlBody(frame, glyphs, opts, out, usedClasses);
+    return out;
+}
+
+// Минимальный HTML-документ с кадром внутри <pre>
+inline std::string asciiFrameToHtmlDocument(const AsciiFrame &frame, const std::vector<std::string> &glyphs,
+                                            HtmlOptions opts, const std::string &fontCss = "10px/1.1 monospace") {
+    using namespace html_detail;
+    opts.lineBreak = "\n";
+    const int levels = std::max(2, opts.paletteLevels);
+    std::vector<bool> used(opts.usePalette ? static_cast<size_t>(levels) * levels * levels : 0, false);
+    std::string body = asciiFrameToHtmlBody(frame, glyphs, opts, opts.usePalette ? &used : nullptr);
+
+    std::string doc = "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><style>"
+                      "body{margin:0;background:#000}pre{margin:0;color:#fff;font:";
+    doc += fontCss;
+    doc += '}';
+    for (size_t i = 0; i < used.size(); ++i) {
+        if (!used[i])
+            continue;
+        int idx = static_cast<int>(i);
+        doc += ".c";
+        doc += std::to_string(idx);
+        doc += "{color:";
+        appendHexColor(doc, paletteChannel(idx / (levels * levels), levels),
+                       paletteChannel((idx / levels) % levels, levels), paletteChannel(idx % levels, levels));
+        doc += '}';
+    }
+    doc += "</style></head><body><pre>";
+    doc += body;
+    doc += "</pre></body></html>\n";
+    return doc;
+}
+
+#endif // HTML_EXPORT_H
@@ -0,0 +1,253 @@
+// html_player.h
+// Экспорт ASCII-анимации в самодостаточный HTML-файл: кадры хранятся в сжатом
+// двоичном виде (ключевые кадры и дельты, base64), небольшой JS-декодер рисует их
+// в canvas (цветной режим) или <pre> (черно-белый) по requestAnimationFrame
+
+#ifndef HTML_PLAYER_H
+#define HTML_PLAYER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+// Кодирование base64 (RFC 4648)
+inline std::string base64Encode(const uint8_t *data, size_t size) {
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((size + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < size; i += 3) {
+        uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out += kAlphabet[(v >> 18) & 63];
+        out += kAlphabet[(v >> 12) & 63];
+        out += kAlphabet[(v >> 6) & 63];
+        out += kAlphabet[v & 63];
+    }
+    if (i < size) {
+        uint32_t v = data[i] << 16;
+        if (i + 1 < size)
+            v |= data[i + 1] << 8;
+        out += kAlphabet[(v >> 18) & 63];
+        out += kAlphabet[(v >> 12) & 63];
+        out += (i + 1 < size) ? kAlphabet[(v >> 6) & 63] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// Кодировщик кадров. Ячейка - индекс символа и (в цветном режиме) R, G, B.
+// Кадр записывается как: тип (1 - ключевой, 0 - дельта), varint длины, затем операции
+// varint h: h & 3 == 0 - пропустить h >> 2 ячеек (без изменений с прошлого кадра),
+// 1 - повтор одной ячейки h >> 2 раз, 2 - h >> 2 ячеек подряд без сжатия.
+class HtmlPlayerEncoder {
+public:
+    // keyframeInterval - период ключевых кадров; colorShift - сколько младших бит цвета
+    // отбрасывать (квантование повышает число совпадающих ячеек между кадрами)
+    explicit HtmlPlayerEncoder(bool blackWhite, int keyframeInterval = 48, int colorShift = 3)
+        : m_blackWhite(blackWhite), m_keyframeInterval(keyframeInterval), m_colorShift(colorShift),
+          m_cellSize(blackWhite ? 1 : 4) {}
+
+    // false - размер кадра отличается от первого (плеер рисует одну сетку), кадр не записан
+    bool addFrame(const AsciiFrame &frame) {
+        encodeFrame(frame, m_record);
+        if (m_record.empty())
+            return false;
+        m_data.insert(m_data.end(), m_record.begin(), m_record.end());
+        return true;
+    }
+
+    // Кодирование одного кадра в отдельную запись (тип, длина, операции) - для потоковой
+    // передачи. forceKey - принудительный ключевой кадр (например, для нового зрителя).
+    // Возвращает true для ключевого кадра; кадр другого размера пропускается (record пуст)
+    bool encodeFrame(const AsciiFrame &frame, std::vector<uint8_t> &record, bool forceKey = false) {
+        record.clear();
+        if (m_frameCount == 0) {
+            m_cols = frame.cols;
+            m_rows = frame.rows;
+        }
+        if (frame.cols != m_cols || frame.rows != m_rows)
+            return false;
+        packCells(frame, m_cur);
+
+        bool key = forceKey || m_frameCount == 0 || m_sinceKey + 1 >= m_keyframeInterval;
+        m_ops.clear();
+        if (!key) {
+            encodeOps(m_cur, &m_prev, m_ops);
+            // Слишком большая дельта (смена сцены) - выгоднее ключевой кадр
+            if (m_ops.size() * 2 > m_cur.size())
+                key = true;
+        }
+        if (key) {
+            m_ops.clear();
+            encodeOps(m_cur, nullptr, m_ops);
+        }
+        record.push_back(key ? 1 : 0);
+        putVarint(record, m_ops.size());
+        record.insert(record.end(), m_ops.begin(), m_ops.end());
+        m_prev.swap(m_cur);
+        m_sinceKey = key ? 0 : m_sinceKey + 1;
+        ++m_frameCount;
+        return key;
+    }
+
+    int columns() const { return m_cols; }
+    int rows() const { return m_rows; }
+    int cellSize() const { return m_cellSize; }
+
+    size_t frameCount() const { return m_frameCount; }
+    size_t encodedBytes() const { return m_data.size(); }
+
+    // Готовый HTML-документ с данными и декодером
+    std::string document(const std::vector<std::string> &glyphs, double fps, int fontPx = 12) const {
+        std::string glyphJson = "[";
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            if (i)
+                glyphJson += ',';
+            glyphJson += '"';
+            for (char c : glyphs[i]) {
+                if (c == '"' || c == '\\')
+                    glyphJson += '\\';
+                if (c == '<')
+                    glyphJson += "\\u003c";
+                else
+                    glyphJson += c;
+            }
+            glyphJson += '"';
+        }
+        glyphJson += ']';
+
+        std::string doc =
+            "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>ASCII</title><style>"
+            "body{margin:0;background:#000}pre{margin:0;color:#fff;font:";
+        doc += std::to_string(fontPx);
+        doc += "px/1.1 monospace}</style></head><body>";
+        doc += m_blackWhite ? "<pre id=\"a\"></pre>" : "<canvas id=\"a\"></canvas>";
+        doc += "<script>var D={w:";
+        doc += std::to_string(m_cols);
+        doc += ",h:";
+        doc += std::to_string(m_rows);
+        doc += ",n:";
+        doc += std::to_string(m_frameCount);
+        doc += ",fps:";
+        doc += std::to_string(fps > 0 ? fps : 24.0);
+        doc += ",font:";
+        doc += std::to_string(fontPx);
+        doc += ",cell:";
+        doc += std::to_string(m_cellSize);
+        doc += ",glyphs:";
+        doc += glyphJson;
+        doc += ",data:\"";
+        doc += base64Encode(m_data.data(), m_data.size());
+        doc += "\"};\n";
+        doc += kDecoderJs;
+        doc += "</script></body></html>\n";
+        return doc;
+    }
+
+private:
+    void packCells(const AsciiFrame &frame, std::vector<uint8_t> &out) const {
+        const size_t cells = static_cast<size_t>(frame.rows) * frame.cols;
+        out.resize(cells * m_cellSize);
+        if (m_blackWhite) {
+            std::memcpy(out.data(), frame.glyphs.data(), cells);
+            return;
+        }
+        const uint8_t mask = static_cast<uint8_t>(0xFF << m_colorShift);
+        const uint8_t half = m_colorShift ? static_cast<uint8_t>(1 << (m_colorShift - 1)) : 0;
+        for (int row = 0; row < frame.rows; ++row) {
+            const cv::Vec3b *colors = frame.colors.ptr<cv::Vec3b>(row);
+            for (int col = 0; col < frame.cols; ++col) {
+                size_t cell = static_cast<size_t>(row) * frame.cols + col;
+                uint8_t *dst = out.data() + cell * 4;
+                dst[0] = frame.glyphs[cell];
+                dst[1] = static_cast<uint8_t>((colors[col][2] & mask) | half);
+                dst[2] = static_cast<uint8_t>((colors[col][1] & mask) | half);
+                dst[3] = static_cast<uint8_t>((colors[col][0] & mask) | half);
+            }
+        }
+    }
+
+    bool sameCell(const std::vector<uint8_t> &a, size_t i, const std::vector<uint8_t> &b, size_t j) const {
+        return std::memcmp(a.data() + i * m_cellSize, b.data() + j * m_cellSize, m_cellSize) == 0;
+    }
+
+    void encodeOps(const std::vector<uint8_t> &cur, const std::vector<uint8_t> *prev, std::vector<uint8_t> &out) const {
+        const size_t n = cur.size() / m_cellSize;
+        auto unchanged = [&](size_t c) { return prev && sameCell(cur, c, *prev, c); };
+        size_t c = 0;
+        while (c < n) {
+            if (unchanged(c)) {
+                size_t start = c;
+                while (c < n && unchanged(c))
+                    ++c;
+                putVarint(out, ((c - start) << 2) | 0);
+                continue;
+            }
+            size_t r = c + 1;
+            while (r < n && sameCell(cur, c, cur, r) && !unchanged(r))
+                ++r;
+            if (r - c >= 3) {
+                putVarint(out, ((r - c) << 2) | 1);
+                out.insert(out.end(), cur.begin() + c * m_cellSize, cur.begin() + (c + 1) * m_cellSize);
+                c = r;
+                continue;
+            }
+            size_t start = c;
+            while (c < n && !unchanged(c)) {
+                if (c > start && c + 2 < n && sameCell(cur, c, cur, c + 1) && sameCell(cur, c, cur, c + 2))
+                    break;
+                ++c;
+            }
+            putVarint(out, ((c - start) << 2) | 2);
+            out.insert(out.end(), cur.begin() + start * m_cellSize, cur.begin() + c * m_cellSize);
+        }
+    }
+
+    static void putVarint(std::vector<uint8_t> &out, uint64_t v) {
+        while (v >= 0x80) {
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    static constexpr const char *kDecoderJs = R"JS((function(){
+var b=atob(D.data),buf=new Uint8Array(b.length);for(var i=0;i<b.length;i++)buf[i]=b.charCodeAt(i);
+var W=D.w,H=D.h,N=W*H,CS=D.cell,cells=new Uint8Array(N*CS),dirty=new Uint8Array(N),pos=0,frame=0,t0=null;
+var el=document.getElementById('a'),ctx=null,cw=0,ch=0;
+if(CS>1){ctx=el.getContext('2d');ctx.font=D.font+'px monospace';cw=ctx.measureText('M').width;ch=Math.ceil(D.font*1.1);
+el.width=Math.ceil(cw*W);el.height=ch*H;ctx.font=D.font+'px monospace';ctx.textBaseline='top';ctx.fillStyle='#000';ctx.fillRect(0,0,el.width,el.height);}
+function vint(){var v=0,m=1,x;do{x=buf[pos++];v+=(x&127)*m;m*=128;}while(x&128);return v;}
+function decode(){pos++;var len=vint(),end=pos+len,c=0,k,j;
+while(pos<end){var h=vint(),t=h%4,n=Math.floor(h/4);
+if(t===0){c+=n;}else if(t===1){for(k=0;k<n;k++,c++){for(j=0;j<CS;j++)cells[c*CS+j]=buf[pos+j];dirty[c]=1;}pos+=CS;}
+else{for(k=0;k<n;k++,c++){for(j=0;j<CS;j++)cells[c*CS+j]=buf[pos++];dirty[c]=1;}}}}
+function draw(){if(!ctx){var s='';for(var y=0;y<H;y++){for(var x=0;x<W;x++)s+=D.glyphs[cells[y*W+x]];s+='\n';}el.textContent=s;dirty.fill(0);return;}
+for(var i=0;i<N;i++){if(!dirty[i])continue;dirty[i]=0;var x=(i%W)*cw,y=Math.floor(i/W)*ch,o=i*CS,g=D.glyphs[cells[o]];
+ctx.fillStyle='#000';ctx.fillRect(x,y,cw,ch);if(g!==' '){ctx.fillStyle='rgb('+cells[o+1]+','+cells[o+2]+','+cells[o+3]+')';ctx.fillText(g,x,y);}}}
+function tick(ts){if(t0===null)t0=ts;var target=Math.floor((ts-t0)*D.fps/1000);
+if(target>=D.n){t0=ts;target=0;pos=0;frame=0;}
+var changed=false;while(frame<=target&&frame<D.n){decode();frame++;changed=true;}
+if(changed)draw();requestAnimationFrame(tick);}
+if(D.n>0)requestAnimationFrame(tick);})();
+)JS";
+
+    bool m_blackWhite;
+    int m_keyframeInterval;
+    int m_colorShift;
+    int m_cellSize;
+    int m_cols = 0;
+    int m_rows = 0;
+    size_t m_frameCount = 0;
+    int m_sinceKey = 0;
+    std::vector<uint8_t> m_prev;
+    std::vector<uint8_t> m_cur;
+    std::vector<uint8_t> m_ops;
+    std::vector<uint8_t> m_record;
+    std::vector<uint8_t> m_data;
+};
+
+#endif // HTML_PLAYER_H
@@ -0,0 +1,310 @@
+// image_loader.h
+// Загрузка изображения под нужную ширину ASCII-кадра. Файл отображается в память и
+// декодируется через imdecode без промежуточной копии. Если исходник намного больше
+// нужного, JPEG декодируется сразу в уменьшенном масштабе (IMREAD_REDUCED_COLOR_2/4/8,
+// масштабирование DCT в libjpeg), а несжатый BMP читается полосами прямо из отображения
+// с усреднением блоков, так что пиковая память не зависит от размера исходника
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Файл, отображённый в память только для чтения
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        // Путь в UTF-8 (как из QString::toStdString), поэтому широкая версия API
+        int len = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        std::wstring wide(len > 0 ? len : 1, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide[0], len);
+        HANDLE file = CreateFileW(wide.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER size;
+        if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+            m_mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping) {
+                m_data = static_cast<const uint8_t *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+                if (m_data)
+                    m_size = static_cast<size_t>(size.QuadPart);
+            }
+        }
+        CloseHandle(file);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                m_data = static_cast<const uint8_t *>(data);
+                m_size = static_cast<size_t>(st.st_size);
+                ::madvise(data, m_size, MADV_SEQUENTIAL);
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (m_data)
+            UnmapViewOfFile(m_data);
+        if (m_mapping)
+            CloseHandle(m_mapping);
+#else
+        if (m_data)
+            ::munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+// Как было загружено изображение (для статуса и отладки)
+struct ImageLoadInfo {
+    cv::Size source;       // размер в файле (0x0, если заголовок не распознан)
+    cv::Size decoded;      // размер загруженного изображения
+    int reduction = 1;     // во сколько раз уменьшено при декодировании
+    const char *method = "";
+};
+
+namespace image_detail {
+
+// Сколько пикселей исходника оставлять на ячейку по каждой оси: усреднение при
+// уменьшении до ширины кадра остаётся таким же гладким, как у полного декодирования
+static const int kPixelsPerCell = 2;
+
+inline uint32_t be16(const uint8_t *p) { return (uint32_t(p[0]) << 8) | p[1]; }
+inline uint32_t be32(const uint8_t *p) { return (be16(p) << 16) | be16(p + 2); }
+inline uint32_t le16(const uint8_t *p) { return (uint32_t(p[1]) << 8) | p[0]; }
+inline uint32_t le32(const uint8_t *p) { return (le16(p + 2) << 16) | le16(p); }
+
+inline bool isJpeg(const uint8_t *d, size_t n) { return n > 3 && d[0] == 0xFF && d[1] == 0xD8 && d[2] == 0xFF; }
+
+// Размер JPEG по маркеру SOF без декодирования
+inline bool jpegSize(const uint8_t *d, size_t n, cv::Size &size) {
+    size_t pos = 2;
+    while (pos + 4 <= n) {
+        if (d[pos] != 0xFF) {
+            ++pos;
+            continue;
+        }
+        const uint8_t marker = d[pos + 1];
+        if (marker == 0xFF) {
+            ++pos;
+            continue;
+        }
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;
+            continue;
+        }
+        const size_t len = be16(d + pos + 2);
+        const bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (sof && pos + 9 <= n) {
+            size = cv::Size(static_cast<int>(be16(d + pos + 7)), static_cast<int>(be16(d + pos + 5)));
+            return size.width > 0 && size.height > 0;
+        }
+        if (marker == 0xDA || len < 2)
+            return false;
+        pos += 2 + len;
+    }
+    return false;
+}
+
+inline bool pngSize(const uint8_t *d, size_t n, cv::Size &size) {
+    static const uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (n < 24 || std::memcmp(d, kSignature, 8) != 0 || std::memcmp(d + 12, "IHDR", 4) != 0)
+        return false;
+    size = cv::Size(static_cast<int>(be32(d + 16)), static_cast<int>(be32(d + 20)));
+    return size.width > 0 && size.height > 0;
+}
+
+// Несжатый BMP 24/32 бит, который можно читать полосами прямо из отображения
+struct BmpLayout {
+    cv::Size size;
+    size_t offset = 0;     // начало пикселей
+    size_t stride = 0;     // байт на строку (с выравниванием до 4)
+    int bytesPerPixel = 0;
+    bool bottomUp = true;
+};
+
+inline bool bmpLayout(const uint8_t *d, size_t n, BmpLayout &bmp) {
+    if (n < 54 || d[0] != 'B' || d[1] != 'M')
+        return false;
+    const uint32_t header = le32(d + 14);
+    if (header < 40)
+        return false;
+    const int32_t width = static_cast<int32_t>(le32(d + 18));
+    const int32_t height = static_cast<int32_t>(le32(d + 22));
+    const uint32_t bpp = le16(d + 28);
+    const uint32_t compression = le32(d + 30);
+    if (width <= 0 || height == 0 || (bpp != 24 && bpp != 32) || compression != 0)
+        return false;
+    bmp.size = cv::Size(width, height < 0 ? -height : height);
+    bmp.bottomUp = height > 0;
+    bmp.bytesPerPixel = static_cast<int>(bpp / 8);
+    bmp.offset = le32(d + 10);
+    bmp.stride = (static_cast<size_t>(width) * bmp.bytesPerPixel + 3) & ~size_t(3);
+    return bmp.offset + bmp.stride * bmp.size.height <= n;
+}
+
+// Уменьшение BMP в factor раз усреднением блоков factor x factor. Строки читаются по одной
+// из отображения, в памяти только строка сумм и результат
+inline void decodeBmpReduced(const uint8_t *d, const BmpLayout &bmp, int factor, cv::Mat &out) {
+    const int outW = bmp.size.width / factor;
+    const int outH = bmp.size.height / factor;
+    out.create(outH, outW, CV_8UC3);
+    std::vector<uint32_t> sums(static_cast<size_t>(outW) * 3);
+    const uint32_t area = static_cast<uint32_t>(factor) * factor;
+    for (int y = 0; y < outH; ++y) {
+        std::fill(sums.begin(), sums.end(), 0u);
+        for (int dy = 0; dy < factor; ++dy) {
+            const int srcY = y * factor + dy;
+            const int fileRow = bmp.bottomUp ? bmp.size.height - 1 - srcY : srcY;
+            const uint8_t *row = d + bmp.offset + bmp.stride * fileRow;
+            for (int x = 0; x < outW; ++x) {
+                const uint8_t *px = row + static_cast<size_t>(x) * factor * bmp.bytesPerPixel;
+                uint32_t *s = &sums[static_cast<size_t>(x) * 3];
+                for (int dx = 0; dx < factor; ++dx, px += bmp.bytesPerPixel) {
+                    s[0] += px[0];
+                    s[1] += px[1];
+                    s[2] += px[2];
+                }
+            }
+        }
+        uint8_t *dst = out.ptr<uint8_t>(y);
+        for (size_t i = 0; i < sums.size(); ++i)
+            dst[i] = static_cast<uint8_t>((sums[i] + area / 2) / area);
+    }
+}
+
+// Наибольшее уменьшение, при котором на ячейку кадра шириной cols остаётся не меньше
+// kPixelsPerCell пикселей по каждой оси. EXIF-поворот меняет оси местами, поэтому
+// проверяются обе ориентации
+inline int maxReduction(cv::Size source, int cols) {
+    if (cols <= 0 || source.width <= 0 || source.height <= 0)
+        return 1;
+    auto fits = [&](int w, int h) {
+        const int rows = asciiRowsFor(w, h, cols);
+        return std::min(w / (cols * kPixelsPerCell), h / (rows * kPixelsPerCell));
+    };
+    return std::max(1, std::min(fits(source.width, source.height), fits(source.height, source.width)));
+}
+
+} // namespace image_detail
+
+// Загрузка BGR-изображения для кадра шириной cols символов (cols <= 0 - полный размер).
+// Пустой Mat, если файл не открылся или не декодировался
+inline cv::Mat loadImageForAscii(const std::string &path, int cols, ImageLoadInfo *info = nullptr) {
+    using namespace image_detail;
+    ImageLoadInfo local;
+    ImageLoadInfo &li = info ? *info : local;
+    li = ImageLoadInfo();
+
+    MappedFile file(path);
+    if (!file.isOpen())
+        return cv::Mat();
+    const uint8_t *d = file.data();
+    const size_t n = file.size();
+
+    cv::Mat image;
+    BmpLayout bmp;
+    if (bmpLayout(d, n, bmp)) {
+        li.source = bmp.size;
+        li.reduction = maxReduction(bmp.size, cols);
+        if (li.reduction > 1) {
+            li.method = "BMP полосами";
+            decodeBmpReduced(d, bmp, li.reduction, image);
+            li.decoded = image.size();
+            return image;
+        }
+    } else if (isJpeg(d, n)) {
+        jpegSize(d, n, li.source);
+        li.reduction = maxReduction(li.source, cols);
+    } else {
+        pngSize(d, n, li.source);
+        li.reduction = maxReduction(li.source, cols);
+    }
+
+    // imdecode читает прямо из отображения; у JPEG уменьшение выполняет сам декодер
+    int flags = cv::IMREAD_COLOR;
+    li.method = "imdecode";
+    if (li.reduction >= 8) {
+        li.reduction = 8;
+        flags = cv::IMREAD_REDUCED_COLOR_8;
+    } else if (li.reduction >= 4) {
+        li.reduction = 4;
+        flags = cv::IMREAD_REDUCED_COLOR_4;
+    } else if (li.reduction >= 2) {
+        li.reduction = 2;
+        flags = cv::IMREAD_REDUCED_COLOR_2;
+    } else {
+        li.reduction = 1;
+    }
+    if (li.reduction > 1)
+        li.method = isJpeg(d, n) ? "JPEG с масштабированием DCT" : "imdecode с уменьшением";
+    const cv::Mat encoded(1, static_cast<int>(std::min<size_t>(n, INT32_MAX)), CV_8U, const_cast<uint8_t *>(d));
+    image = cv::imdecode(encoded, flags);
+    li.decoded = image.size();
+    return image;
+}
+
+// Дешевле ли превью шириной previewCols полной загрузки под cols: JPEG уменьшается
+// декодером не больше чем в 8 раз, несжатый BMP - прореживанием в любое число раз.
+// Остальные форматы декодируются целиком при любой ширине, превью для них строится
+// из уже загруженного полного изображения
+inline bool imageHasCheapPreview(const std::string &path, int previewCols, int cols) {
+    using namespace image_detail;
+    MappedFile file(path);
+    if (!file.isOpen() || previewCols <= 0 || previewCols >= cols)
+        return false;
+    const uint8_t *d = file.data();
+    const size_t n = file.size();
+    BmpLayout bmp;
+    if (bmpLayout(d, n, bmp))
+        return maxReduction(bmp.size, previewCols) > maxReduction(bmp.size, cols);
+    cv::Size source;
+    if (!isJpeg(d, n) || !jpegSize(d, n, source))
+        return false;
+    auto jpegScale = [](int reduction) { return reduction >= 8 ? 8 : reduction >= 4 ? 4 : reduction >= 2 ? 2 : 1; };
+    return jpegScale(maxReduction(source, previewCols)) > jpegScale(maxReduction(source, cols));
+}
+
+#endif // IMAGE_LOADER_H
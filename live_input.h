@@ -0,0 +1,274 @@
+// live_input.h
+// Живой вход: сырые кадры BGR/RGB/YUV заданного размера читаются из stdin или
+// именованного канала (например, `ffmpeg ... -f rawvideo - | console --live`).
+// Поток чтения всё время опустошает канал и хранит только последний кадр, поэтому
+// при медленном потребителе старые кадры отбрасываются и задержка остаётся ограниченной
+
+#ifndef LIVE_INPUT_H
+#define LIVE_INPUT_H
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Формат пикселей входного потока (имена как у -pix_fmt в ffmpeg)
+enum class LivePixelFormat { Bgr24, Rgb24, Yuv420p, Nv12, Yuyv422 };
+
+inline bool livePixelFormatFromString(const std::string &name, LivePixelFormat &format) {
+    if (name == "bgr24") format = LivePixelFormat::Bgr24;
+    else if (name == "rgb24") format = LivePixelFormat::Rgb24;
+    else if (name == "yuv420p" || name == "i420") format = LivePixelFormat::Yuv420p;
+    else if (name == "nv12") format = LivePixelFormat::Nv12;
+    else if (name == "yuyv422" || name == "yuy2") format = LivePixelFormat::Yuyv422;
+    else return false;
+    return true;
+}
+
+// Размер кадра допустим для формата: у форматов с прореженной цветностью (yuv420p
+// и nv12 по обеим осям, yuyv422 по ширине) нечётная сторона сдвинула бы поток
+inline bool liveFrameSizeValid(LivePixelFormat format, int width, int height) {
+    if (width <= 0 || height <= 0)
+        return false;
+    switch (format) {
+    case LivePixelFormat::Yuv420p:
+    case LivePixelFormat::Nv12: return width % 2 == 0 && height % 2 == 0;
+    case LivePixelFormat::Yuyv422: return width % 2 == 0;
+    default: return true;
+    }
+}
+
+// Размер одного кадра в байтах
+inline size_t liveFrameBytes(LivePixelFormat format, int width, int height) {
+    const size_t pixels = static_cast<size_t>(width) * height;
+    switch (format) {
+    case LivePixelFormat::Bgr24:
+    case LivePixelFormat::Rgb24: return pixels * 3;
+    case LivePixelFormat::Yuv420p:
+    case LivePixelFormat::Nv12: return pixels * 3 / 2;
+    case LivePixelFormat::Yuyv422: return pixels * 2;
+    }
+    return 0;
+}
+
+// Преобразование сырого кадра в BGR
+inline void liveFrameToBgr(const std::vector<uint8_t> &raw, LivePixelFormat format, int width, int height, cv::Mat &bgr) {
+    uint8_t *data = const_cast<uint8_t *>(raw.data());
+    switch (format) {
+    case LivePixelFormat::Bgr24:
+        cv::Mat(height, width, CV_8UC3, data).copyTo(bgr);
+        break;
+    case LivePixelFormat::Rgb24:
+        cv::cvtColor(cv::Mat(height, width, CV_8UC3, data), bgr, cv::COLOR_RGB2BGR);
+        break;
+    case LivePixelFormat::Yuv420p:
+        cv::cvtColor(cv::Mat(height * 3 / 2, width, CV_8UC1, data), bgr, cv::COLOR_YUV2BGR_I420);
+        break;
+    case LivePixelFormat::Nv12:
+        cv::cvtColor(cv::Mat(height * 3 / 2, width, CV_8UC1, data), bgr, cv::COLOR_YUV2BGR_NV12);
+        break;
+    case LivePixelFormat::Yuyv422:
+        cv::cvtColor(cv::Mat(height, width, CV_8UC2, data), bgr, cv::COLOR_YUV2BGR_YUYV);
+        break;
+    }
+}
+
+// Кадр живого входа: сырые байты, номер во входном потоке и момент окончания чтения
+struct LiveFrame {
+    std::vector<uint8_t> raw;
+    uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point arrived;
+};
+
+class LiveFrameReader {
+public:
+    // source - "-" для stdin или путь к именованному каналу/файлу
+    LiveFrameReader(const std::string &source, LivePixelFormat format, int width, int height)
+        : m_frameBytes(liveFrameBytes(format, width, height)) {
+        if (source.empty() || source == "-") {
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+            m_fd = _fileno(stdin);
+#else
+            m_fd = STDIN_FILENO;
+#endif
+        } else {
+#ifdef _WIN32
+            m_fd = _open(source.c_str(), _O_RDONLY | _O_BINARY);
+#else
+            m_fd = ::open(source.c_str(), O_RDONLY);
+#endif
+            m_ownsFd = m_fd >= 0;
+        }
+    }
+
+    ~LiveFrameReader() {
+        stop();
+        if (m_ownsFd) {
+#ifdef _WIN32
+            _close(m_fd);
+#else
+            ::close(m_fd);
+#endif
+        }
+    }
+
+    LiveFrameReader(const LiveFrameReader &) = delete;
+    LiveFrameReader &operator=(const LiveFrameReader &) = delete;
+
+    bool isOpen() const { return m_fd >= 0 && m_frameBytes > 0; }
+
+    void start() {
+        if (isOpen() && !m_thread.joinable())
+            m_thread = std::thread([this]() { readLoop(); });
+    }
+
+    void stop() {
+        m_stop = true;
+        m_wake.notify_all();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Ожидание кадра новее уже полученного. Возвращает false при конце потока
+    // (или по таймауту - тогда finished() ещё false)
+    bool next(LiveFrame &frame, std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait_for(lock, timeout, [this]() { return m_hasFrame || m_finished; });
+        if (!m_hasFrame)
+            return false;
+        frame.raw.swap(m_latest.raw);
+        frame.sequence = m_latest.sequence;
+        frame.arrived = m_latest.arrived;
+        m_hasFrame = false;
+        return true;
+    }
+
+    bool finished() const { return m_finished; }
+    uint64_t framesRead() const { return m_framesRead; }
+    uint64_t framesDropped() const { return m_framesDropped; }
+
+private:
+    // Чтение ровно size байт; false при конце потока или остановке.
+    // Прерывание сигналом (EINTR) - не конец потока, чтение повторяется
+    bool readExact(uint8_t *dst, size_t size) {
+        size_t done = 0;
+        while (done < size) {
+            if (m_stop)
+                return false;
+#ifndef _WIN32
+            // Опрос с таймаутом, чтобы stop() не зависал на заблокированном read
+            pollfd pfd{m_fd, POLLIN, 0};
+            int ready = ::poll(&pfd, 1, 100);
+            if (ready == 0 || (ready < 0 && errno == EINTR))
+                continue;
+            if (ready < 0)
+                return false;
+            ssize_t got = ::read(m_fd, dst + done, size - done);
+#else
+            int got = _read(m_fd, dst + done, static_cast<unsigned>(std::min<size_t>(size - done, 1 << 20)));
+#endif
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            done += static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    void readLoop() {
+        std::vector<uint8_t> buffer(m_frameBytes);
+        uint64_t sequence = 0;
+        while (readExact(buffer.data(), buffer.size())) {
+            auto arrived = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                // Непрочитанный потребителем кадр заменяется новым
+                if (m_hasFrame)
+                    ++m_framesDropped;
+                m_latest.raw.swap(buffer);
+                m_latest.sequence = sequence++;
+                m_latest.arrived = arrived;
+                m_hasFrame = true;
+                ++m_framesRead;
+            }
+            m_wake.notify_one();
+            if (buffer.size() != m_frameBytes)
+                buffer.resize(m_frameBytes);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished = true;
+        }
+        m_wake.notify_all();
+    }
+
+    size_t m_frameBytes;
+    int m_fd = -1;
+    bool m_ownsFd = false;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    LiveFrame m_latest;
+    bool m_hasFrame = false;
+    std::atomic<bool> m_finished{false};
+    std::atomic<bool> m_stop{false};
+    std::atomic<uint64_t> m_framesRead{0};
+    std::atomic<uint64_t> m_framesDropped{0};
+};
+
+// Статистика задержки от получения кадра до вывода (гистограмма по 1 мс до 2 с)
+class LatencyStats {
+public:
+    LatencyStats() : m_histogram(kBuckets, 0) {}
+
+    void add(double ms) {
+        ++m_count;
+        m_sum += ms;
+        m_max = std::max(m_max, ms);
+        ++m_histogram[std::min<size_t>(static_cast<size_t>(std::max(0.0, ms)), kBuckets - 1)];
+    }
+
+    uint64_t count() const { return m_count; }
+    double average() const { return m_count ? m_sum / m_count : 0.0; }
+    double maximum() const { return m_max; }
+
+    // Перцентиль p (0..1) с точностью до 1 мс
+    double percentile(double p) const {
+        uint64_t target = static_cast<uint64_t>(p * m_count);
+        uint64_t acc = 0;
+        for (size_t i = 0; i < kBuckets; ++i) {
+            acc += m_histogram[i];
+            if (acc > target)
+                return static_cast<double>(i + 1);
+        }
+        return m_max;
+    }
+
+private:
+    static const size_t kBuckets = 2000;
+    std::vector<uint64_t> m_histogram;
+    uint64_t m_count = 0;
+    double m_sum = 0.0;
+    double m_max = 0.0;
+};
+
+#endif // LIVE_INPUT_H
@@ -20,6 +20,7 @@
 #include <QCheckBox>
 #include <QComboBox>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QDateTime>
 #include <QUrl>
 #include <QMediaPlayer>
@@ -28,92 +29,567 @@
 #include <QPainter>
 #include <QTextDocument>
 #include <QFontMetrics>
+#include <QFontInfo>
 #include <QProcess>
 #include <QTemporaryFile>
+#include <QTemporaryDir>
 #include <QDebug>
 #include <QPalette>
 #include <QFont>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QDockWidget>
+#include <QStatusBar>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 
-// Класс для предобработки видео или GIF в ASCII-арт (аналог PreprocessingThread в Python)
+#include "ascii_core.h"
+#include "html_export.h"
+#include "html_player.h"
+#include "frame_store.h"
+#include "presentation_clock.h"
+#include "export_jobs.h"
+#include "raster_export.h"
+#include "gif_encoder.h"
+#include "adaptive_quality.h"
+#include "image_loader.h"
+#include "segment_preprocess.h"
+#include "work_scheduler.h"
+#include "terminal_export.h"
+
+// Таблица символов набора в UTF-8 для сериализаторов ядра
+static std::vector<std::string> glyphTable(const QString &asciiChars) {
+    return glyphTableFromUtf8(asciiChars.toStdString());
+}
+
+// Допуск цвета span в адаптивном режиме на ступенях "256 цветов"
+static const int kCoarseColorTolerance = 24;
+
+// Текст кадра для QTextEdit: обычный текст в черно-белом режиме, иначе компактный HTML,
+// в котором соседние символы одного цвета объединены в один span.
+// colorTolerance - допустимое отличие цвета соседних ячеек одного span (больше - короче HTML)
+static QString frameToText(const AsciiFrame &frame, const std::vector<std::string> &glyphs, bool blackWhite,
+                           int colorTolerance = HtmlOptions().colorTolerance) {
+    // Промежуточный UTF-8 текст живёт в буфере потока: выделяется только сама QString
+    thread_local std::string text;
+    if (blackWhite) {
+        text.clear();
+        text.reserve(static_cast<size_t>(frame.rows) * (frame.cols + 1));
+        for (int row = 0; row < frame.rows; ++row) {
+            const uint8_t *cells = frame.glyphs.data() + static_cast<size_t>(row) * frame.cols;
+            for (int col = 0; col < frame.cols; ++col)
+                text += glyphs[cells[col]];
+            if (row + 1 < frame.rows)
+                text += '\n';
+        }
+        return QString::fromStdString(text);
+    }
+    HtmlOptions opts;
+    opts.lineBreak = "<br>";
+    opts.colorTolerance = colorTolerance;
+    asciiFrameToHtmlBody(frame, glyphs, opts, text);
+    return QString::fromStdString(text);
+}
+
+// Ширина превью: столько колонок конвертируется и выводится за малую долю времени полного кадра
+static const int kPreviewColumns = 96;
+
+// Вывод текста кадра в поле. zoom - размер шрифта; узкое превью показывается шрифтом,
+// увеличенным во столько раз, во сколько оно уже итогового кадра, и занимает то же место
+static void showAsciiText(QTextEdit *display, const QString &text, bool blackWhite, double zoom) {
+    QFont font = display->font();
+    font.setPointSizeF(std::min(zoom, 96.0));
+    display->setFont(font);
+    if (blackWhite) {
+        display->setStyleSheet("background-color: black; color: white;");
+        display->setPlainText(text);
+    } else {
+        display->setStyleSheet("background-color: black;");
+        display->setHtml(text);
+    }
+}
+
+// Вывод кадра, итоговая ширина которого targetCols; более узкое превью растягивается шрифтом
+static void showAsciiFrame(QTextEdit *display, const AsciiFrame &frame, const std::vector<std::string> &glyphs,
+                           bool blackWhite, int targetCols, int zoom) {
+    const double scale = frame.cols > 0 ? std::max(1.0, static_cast<double>(targetCols) / frame.cols) : 1.0;
+    showAsciiText(display, frameToText(frame, glyphs, blackWhite), blackWhite, zoom * scale);
+}
+
+// Как часто во время предобработки показывается последний готовый кадр
+static const int kPreprocessPreviewIntervalMs = 250;
+
+// Период обновления загрузки планировщика в строке состояния
+static const int kSchedulerStatusIntervalMs = 500;
+
+// Заполнение списка режимов дизеринга
+static void fillDitherCombo(QComboBox *combo) {
+    combo->addItem("Без дизеринга", static_cast<int>(DitherMode::None));
+    combo->addItem("Байер (упорядоченный)", static_cast<int>(DitherMode::Ordered));
+    combo->addItem("Флойд-Стейнберг", static_cast<int>(DitherMode::FloydSteinberg));
+}
+
+// Класс для предобработки видео или GIF в ASCII-арт (аналог PreprocessingThread в Python).
+// Длинное видео делится на отрезки, каждый со своим декодером (decoders: 0 - по числу ядер).
+// Сам поток только открывает файл, строит превью и сообщает прогресс; отрезки кусками
+// декодируются на общем планировщике с приоритетом предобработки
 class PreprocessingThread : public QThread {
     Q_OBJECT
 public:
-    PreprocessingThread(const QString &videoPath, int desiredWidth, const QString &asciiChars, bool blackWhite, QObject *parent = nullptr)
+    PreprocessingThread(const QString &videoPath, int desiredWidth, const QString &asciiChars,
+                        DitherMode dither, bool stabilize, int decoders, FrameStore *store,
+                        WorkScheduler *scheduler, QObject *parent = nullptr)
         : QThread(parent), m_videoPath(videoPath), m_desiredWidth(desiredWidth), m_asciiChars(asciiChars),
-          m_blackWhite(blackWhite), m_runFlag(true) {}
-
-    void stop() { m_runFlag = false; }
+          m_dither(dither), m_stabilize(stabilize), m_decoders(decoders), m_store(store), m_scheduler(scheduler) {}
+
+    // Кооперативная отмена: отрезки останавливаются на ближайшем кадре
+    void stop() { m_cancel.cancel(); }
+
+    // Узкое превью первого кадра; читать после previewReady
+    const AsciiFrame &preview() const { return m_preview; }
+
+    // Итог предобработки для строки статуса: число декодеров и стабилизация; читать после finished
+    QString summary() const {
+        QString text = m_result.sequentialFallback
+                           ? QString("Декодер: 1 (отрезки не сошлись)")
+                           : QString("Декодеров: %1").arg(m_result.segments);
+        if (m_stabilize && m_result.frames > 0)
+            text += QString(" | Стабилизация: меняется %1% ячеек за кадр (без неё %2%)")
+                        .arg(m_result.changedRatio * 100.0, 0, 'f', 1)
+                        .arg(m_result.rawChangedRatio * 100.0, 0, 'f', 1);
+        return text;
+    }
 
 signals:
-    void finished(const std::vector<QString>& frames, double fps);
+    void finished(double fps);
     void progress(int processed, int total);
+    // Превью первого кадра готово (приходит раньше всех полных кадров)
+    void previewReady();
+    // Первые count кадров уже лежат в хранилище и их можно показывать
+    void framesReady(int count);
 
 protected:
     void run() override {
-        cv::VideoCapture cap(m_videoPath.toStdString());
-        if (!cap.isOpened()) {
-            emit finished({}, 0.0);
+        // Кадры хранятся сеткой ячеек; текст для показа и экспорта строится из них по требованию.
+        // Хранилище само выгружает кадры на диск при превышении бюджета памяти.
+        // Отрезки пишут кадры по номерам, поэтому порядок их готовности не важен
+        SegmentPreprocessOptions opts;
+        opts.width = m_desiredWidth;
+        opts.levels = static_cast<int>(glyphTable(m_asciiChars).size());
+        opts.dither = m_dither;
+        opts.segments = m_decoders;
+        opts.stabilize = m_stabilize;
+        opts.previewWidth = std::min(m_desiredWidth, kPreviewColumns);
+        opts.scheduler = m_scheduler;
+        opts.priority = TaskPriority::Bulk;
+        SegmentedPreprocessor job(m_videoPath.toStdString(), opts);
+        job.setPreviewSink([this](AsciiFrame &&frame) {
+            m_preview = std::move(frame);
+            emit previewReady();
+        });
+        m_result = job.run(
+            [this](size_t index, AsciiFrame &&frame) { m_store->put(index, std::move(frame)); },
+            [this, &job](size_t done, size_t total) {
+                if (total > 0)
+                    emit progress(static_cast<int>(std::min(done, total)), static_cast<int>(total));
+                if (job.readyFrames() > 0)
+                    emit framesReady(static_cast<int>(job.readyFrames()));
+            },
+            [this]() { return m_cancel.cancelled(); });
+        if (!m_result.opened) {
+            emit finished(0.0);
             return;
         }
-        double realFps = cap.get(cv::CAP_PROP_FPS);
-        if (realFps <= 0) realFps = 24.0;
-        int totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
-        if (totalFrames < 1)
-            totalFrames = 0;
-
-        std::vector<QString> asciiFrames;
-        int asciiLen = m_asciiChars.length();
-        int processedCount = 0;
-        cv::Mat frame;
-        while (m_runFlag && cap.read(frame)) {
-            int h = frame.rows;
-            int w = frame.cols;
-            double aspectRatio = static_cast<double>(h) / w;
-            int newH = std::max(1, static_cast<int>(m_desiredWidth * aspectRatio * 0.55));
-            cv::Mat resized;
-            cv::resize(frame, resized, cv::Size(m_desiredWidth, newH));
-            QStringList lines;
-            for (int row = 0; row < newH; ++row) {
-                QString rowStr;
-                for (int col = 0; col < m_desiredWidth; ++col) {
-                    cv::Vec3b pixel = resized.at<cv::Vec3b>(row, col);
-                    int b = pixel[0], g = pixel[1], r = pixel[2];
-                    double gray = 0.299 * r + 0.587 * g + 0.114 * b;
-                    int idx = static_cast<int>(gray / 255 * (asciiLen - 1));
-                    idx = std::max(0, std::min(idx, asciiLen - 1));
-                    QChar ch = m_asciiChars[idx];
-                    if (m_blackWhite)
-                        rowStr.append(ch);
-                    else
-                        rowStr.append(QString("<span style=\"color: rgb(%1,%2,%3)\">%4</span>")
-                                      .arg(r).arg(g).arg(b).arg(ch));
-                }
-                lines.append(rowStr);
-            }
-            QString frameText = m_blackWhite ? lines.join("\n") : lines.join("<br>");
-            asciiFrames.push_back(frameText);
-            processedCount++;
-            if (totalFrames > 0)
-                emit progress(processedCount, totalFrames);
-        }
-        cap.release();
-        emit finished(asciiFrames, realFps);
+        m_store->truncate(m_result.frames);
+        emit finished(m_result.fps);
     }
 
 private:
     QString m_videoPath;
     int m_desiredWidth;
     QString m_asciiChars;
+    DitherMode m_dither;
+    bool m_stabilize;
+    int m_decoders;
+    AsciiFrame m_preview;
+    SegmentPreprocessResult m_result;
+    FrameStore *m_store;
+    WorkScheduler *m_scheduler;
+    CancelToken m_cancel;
+};
+
+// Конвертация изображения в фоне, от грубого к точному. Сначала строится превью шириной
+// до kPreviewColumns: у JPEG и BMP из отдельного сильно уменьшенного декодирования, у
+// остальных форматов - из единственного полного декодирования, которое затем идёт и на
+// итоговый кадр, поэтому итог не становится медленнее. Текст для поля тоже готовится здесь.
+// Выполняется на общем планировщике с интерактивным приоритетом; окно держит конвертацию
+// через shared_ptr, поэтому брошенная (отменённая) может спокойно доработать
+class ImageConversion {
+public:
+    ImageConversion(const QString &imagePath, int desiredWidth, const QString &asciiChars,
+                    DitherMode dither, bool blackWhite)
+        : m_imagePath(imagePath), m_desiredWidth(desiredWidth),
+          m_glyphs(glyphTable(asciiChars)), m_dither(dither), m_blackWhite(blackWhite),
+          m_previewMs(-1), m_totalMs(0) {}
+
+    int desiredWidth() const { return m_desiredWidth; }
+    bool blackWhite() const { return m_blackWhite; }
+    // Результаты читаются после соответствующего уведомления
+    const std::vector<std::string> &glyphs() const { return m_glyphs; }
+    const QString &previewText() const { return m_previewText; }
+    const AsciiFrame &frame() const { return m_frame; }
+    const QString &text() const { return m_text; }
+    const ImageLoadInfo &loadInfo() const { return m_info; }
+    qint64 previewMs() const { return m_previewMs; }
+    qint64 totalMs() const { return m_totalMs; }
+
+    // Результат больше не нужен: работа прекращается между этапами
+    void cancel() { m_cancel.cancel(); }
+
+    // Выполнение в рабочем потоке; previewReady вызывается, когда готово превью.
+    // rowParts - на сколько частей можно делить большой кадр по строкам: интерактивной
+    // конвертации, в отличие от кусков предобработки, отдаются простаивающие ядра.
+    // false - файл не открылся или конвертация отменена
+    bool run(int rowParts, const std::function<void()> &previewReady) {
+        ascii_detail::RowPartsLimitScope rowLimit(std::max(1, rowParts));
+        return convert(previewReady);
+    }
+
+private:
+    bool convert(const std::function<void()> &previewReady) {
+        QElapsedTimer timer;
+        timer.start();
+        const std::string path = m_imagePath.toStdString();
+        const int levels = static_cast<int>(m_glyphs.size());
+        const int previewWidth = std::min(m_desiredWidth, kPreviewColumns);
+        const bool previewFirst = previewWidth < m_desiredWidth;
+        if (previewFirst && imageHasCheapPreview(path, previewWidth, m_desiredWidth)) {
+            cv::Mat reduced = loadImageForAscii(path, previewWidth);
+            if (!reduced.empty())
+                publishPreview(reduced, previewWidth, levels, timer, previewReady);
+        }
+        if (m_cancel.cancelled())
+            return false;
+        cv::Mat img = loadImageForAscii(path, m_desiredWidth, &m_info);
+        if (img.empty() || m_cancel.cancelled())
+            return false;
+        if (previewFirst && m_previewText.isEmpty())
+            publishPreview(img, previewWidth, levels, timer, previewReady);
+        convertFrame(img, m_desiredWidth, levels, m_dither, m_frame);
+        m_text = frameToText(m_frame, m_glyphs, m_blackWhite);
+        m_totalMs = timer.elapsed();
+        return !m_cancel.cancelled();
+    }
+
+    void publishPreview(const cv::Mat &img, int width, int levels, const QElapsedTimer &timer,
+                        const std::function<void()> &previewReady) {
+        convertFrame(img, width, levels, m_dither, m_previewFrame);
+        m_previewText = frameToText(m_previewFrame, m_glyphs, m_blackWhite);
+        m_previewMs = timer.elapsed();
+        previewReady();
+    }
+
+    QString m_imagePath;
+    int m_desiredWidth;
+    std::vector<std::string> m_glyphs;
+    DitherMode m_dither;
     bool m_blackWhite;
-    bool m_runFlag;
+    CancelToken m_cancel;
+    ImageLoadInfo m_info;
+    AsciiFrame m_previewFrame;
+    QString m_previewText;
+    AsciiFrame m_frame;
+    QString m_text;
+    qint64 m_previewMs;
+    qint64 m_totalMs;
+};
+
+// Отчёт о времени запуска (флаг --startup-timing): этапы с отметкой от начала main()
+// сразу выводятся в stderr, включая ленивое создание вкладок и фоновый прогрев
+class StartupTiming {
+public:
+    static void start() { s_clock.start(); }
+    static void enable() { s_enabled = true; }
+
+    static void mark(const char *stage) {
+        if(!s_enabled)
+            return;
+        QMutexLocker lock(&s_mutex);
+        std::fprintf(stderr, "[запуск] %8.1f мс  %s\n", s_clock.nsecsElapsed() / 1e6, stage);
+    }
+
+private:
+    static inline QElapsedTimer s_clock;
+    static inline std::atomic<bool> s_enabled{false};
+    static inline QMutex s_mutex;
 };
 
+// Поиск FFmpeg без кэша: запускает процесс ffmpeg -version
+static QString locateFfmpeg() {
+    QProcess process;
+    process.start("ffmpeg", QStringList() << "-version");
+    if(process.waitForFinished() && process.exitCode() == 0)
+        return "ffmpeg";
+    QString exeDir = QCoreApplication::applicationDirPath();
+#ifdef Q_OS_WIN
+    QString ffmpegPath = exeDir + "/ffmpeg/bin/ffmpeg.exe";
+#else
+    QString ffmpegPath = exeDir + "/ffmpeg/bin/ffmpeg";
+#endif
+    return QFile::exists(ffmpegPath) ? ffmpegPath : QString();
+}
+
+// Поиск FFmpeg: системный в PATH или локальный рядом с программой (пустая строка, если нет).
+// Найденный путь запоминается; отсутствие не запоминается, чтобы FFmpeg можно было
+// установить, не перезапуская программу
+static QString findFfmpeg() {
+    static QMutex mutex;
+    static QString found;
+    QMutexLocker lock(&mutex);
+    if(found.isEmpty())
+        found = locateFfmpeg();
+    return found;
+}
+
+// Прогрев после показа окна, в фоновом потоке: загрузка кодеков OpenCV, запуск его пула
+// потоков, первый проход конвертации и поиск FFmpeg. Первая конвертация и первый экспорт
+// не платят за инициализацию библиотек
+static void warmUpBackends() {
+    cv::Mat probe(64, 64, CV_8UC3, cv::Scalar(96, 128, 160));
+    std::vector<uchar> encoded;
+    if(cv::imencode(".jpg", probe, encoded))
+        cv::imdecode(encoded, cv::IMREAD_REDUCED_COLOR_2);
+    AsciiFrame frame;
+    convertFrame(probe, 16, 10, DitherMode::None, frame);
+    StartupTiming::mark("прогрев OpenCV");
+    StartupTiming::mark(findFfmpeg().isEmpty() ? "FFmpeg не найден" : "FFmpeg найден");
+}
+
+// Запуск FFmpeg с проверкой отмены; возвращает текст ошибки или пустую строку
+static QString runFfmpeg(const QString &ffmpegPath, const QStringList &args, ExportJobContext &ctx) {
+    QProcess process;
+    process.start(ffmpegPath, args);
+    if(!process.waitForStarted())
+        return QString("Не удалось запустить FFmpeg: %1").arg(ffmpegPath);
+    while(!process.waitForFinished(200)) {
+        if(process.state() == QProcess::NotRunning)
+            break;
+        if(ctx.cancelled()) {
+            process.kill();
+            process.waitForFinished();
+            return "Отменено";
+        }
+    }
+    if(process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0)
+        return QString::fromLocal8Bit(process.readAllStandardError());
+    return QString();
+}
+
+// Параметры растрового экспорта (видео и GIF); кадры разделяются с вкладкой через shared_ptr
+struct RasterExportParams {
+    std::shared_ptr<FrameStore> frames;
+    std::vector<std::string> glyphs;
+    bool blackWhite = false;
+    QFont font;
+    int columns = 0;
+    double fps = 24.0;
+    QString output;
+    QString audioSource;  // исходный файл для звуковой дорожки (пусто - без звука)
+};
+
+// Растеризация всех кадров во временный видеофайл; progressShare - доля общего прогресса
+static QString writeRasterVideo(const RasterExportParams &params, const QString &tempVideo, int fourcc,
+                                cv::Size &size, ExportJobContext &ctx, double progressShare) {
+    QFontMetrics fm(params.font);
+    int width = fm.averageCharWidth() * params.columns;
+    int height = fm.height() * params.frames->at(0).rows;
+    if(width <= 0 || height <= 0)
+        return QString("Некорректные размеры видео: %1x%2").arg(width).arg(height);
+    size = cv::Size(width, height);
+    cv::VideoWriter out(tempVideo.toStdString(), fourcc, params.fps, size);
+    if(!out.isOpened())
+        return "Не удалось инициализировать VideoWriter.";
+    const size_t total = params.frames->size();
+    // Кадры растеризуются пачками заданиями того же планировщика, на котором идёт экспорт
+    // (атлас символов общий, буферы по одному на место в пачке), а в VideoWriter
+    // попадают строго по порядку
+    GlyphAtlas atlas(params.glyphs, params.font);
+    const size_t batch = static_cast<size_t>(std::max(2, ctx.scheduler().workerCount())) * 2;
+    std::vector<cv::Mat> images(batch);
+    for (size_t start = 0; start < total; start += batch) {
+        if(ctx.cancelled())
+            return "Отменено";
+        const int count = static_cast<int>(std::min(batch, total - start));
+        ctx.scheduler().parallelFor(count, [&](int k) {
+            atlas.render(params.frames->at(start + k), params.blackWhite, size, images[k]);
+        });
+        for (int k = 0; k < count; ++k)
+            out.write(images[k]);
+        ctx.setProgress(progressShare * (start + count) / total, "Растеризация");
+    }
+    out.release();
+    return QString();
+}
+
+// Экспорт видео со звуком: растеризация, извлечение звука и сборка через FFmpeg
+static QString runVideoExport(const RasterExportParams &params, ExportJobContext &ctx) {
+    QTemporaryDir tempDir;
+    if(!tempDir.isValid())
+        return "Не удалось создать временный каталог.";
+    QString tempVideo = tempDir.filePath("temp_video.avi");
+    cv::Size size;
+    QString error = writeRasterVideo(params, tempVideo, cv::VideoWriter::fourcc('X','V','I','D'), size, ctx, 0.8);
+    if(!error.isEmpty())
+        return error;
+    QString ffmpegPath = findFfmpeg();
+    if(ffmpegPath.isEmpty())
+        return "FFmpeg не найден.\n- Системный FFmpeg отсутствует в PATH.\n- Локальный FFmpeg не найден рядом с программой.";
+    ctx.setProgress(0.85, "Извлечение звука");
+    QString audioFile = tempDir.filePath("temp_audio.mp3");
+    error = runFfmpeg(ffmpegPath, QStringList() << "-y" << "-i" << params.audioSource << "-vn" << "-acodec" << "mp3" << audioFile, ctx);
+    if(!error.isEmpty())
+        return QString("Не удалось извлечь аудио:\n%1").arg(error);
+    ctx.setProgress(0.9, "Сборка видео");
+    error = runFfmpeg(ffmpegPath, QStringList() << "-y" << "-i" << tempVideo << "-i" << audioFile << "-c:v" << "libx264"
+                                                << "-c:a" << "aac" << "-shortest" << params.output, ctx);
+    if(!error.isEmpty())
+        return QString("Не удалось объединить видео и аудио:\n%1").arg(error);
+    ctx.setProgress(1.0, "Готово");
+    return QString();
+}
+
+// Экспорт GIF встроенным кодировщиком (без FFmpeg): общая палитра из цветов ячеек,
+// кадры - прямоугольники изменений; растеризация и LZW-сжатие идут параллельно пачками
+static QString runGifExport(const RasterExportParams &params, ExportJobContext &ctx) {
+    const size_t total = params.frames->size();
+    QFontMetrics fm(params.font);
+    int width = fm.averageCharWidth() * params.columns;
+    int height = fm.height() * params.frames->at(0).rows;
+    if(width <= 0 || height <= 0)
+        return QString("Некорректные размеры GIF: %1x%2").arg(width).arg(height);
+    const cv::Size size(width, height);
+
+    GifPalette palette;
+    if(params.blackWhite) {
+        palette = GifPalette({cv::Vec3b(0, 0, 0), cv::Vec3b(255, 255, 255)});
+    } else {
+        GifPaletteBuilder builder;
+        for (size_t i = 0; i < total; ++i) {
+            if(ctx.cancelled())
+                return "Отменено";
+            builder.add(params.frames->at(i).colors);
+            ctx.setProgress(0.1 * (i + 1) / total, "Построение палитры");
+        }
+        palette = builder.build();
+    }
+    const int minCodeSize = gifMinCodeSize(palette);
+
+    GifWriter writer;
+    if(!writer.open(QFile::encodeName(params.output).toStdString(), width, height, palette))
+        return QString("Не удалось открыть файл:\n%1").arg(params.output);
+
+    GlyphAtlas atlas(params.glyphs, params.font);
+    const double fps = params.fps > 0 ? params.fps : 24.0;
+    const size_t batch = static_cast<size_t>(std::max(2, ctx.scheduler().workerCount())) * 2;
+    std::vector<AsciiFrame> asciiBatch(batch);
+    std::vector<std::vector<uint8_t>> images(batch), blocks(batch);
+    std::vector<uint8_t> previous;
+    for (size_t start = 0; start < total; start += batch) {
+        if(ctx.cancelled()) {
+            writer.close();
+            QFile::remove(params.output);
+            return "Отменено";
+        }
+        const int count = static_cast<int>(std::min(batch, total - start));
+        for (int k = 0; k < count; ++k)
+            asciiBatch[k] = params.frames->at(start + k);
+        // Части пакета - задания того же планировщика, на котором идёт экспорт
+        ctx.scheduler().parallelFor(count, [&](int k) {
+            const AsciiFrame &frame = asciiBatch[k];
+            atlas.renderIndexed(frame, size, 0, [&](int row, int col) {
+                return params.blackWhite ? uint8_t(1) : palette.indexOf(frame.colors.at<cv::Vec3b>(row, col));
+            }, images[k]);
+        });
+        // Кадры сжимаются независимо: каждому нужен только предыдущий растр
+        ctx.scheduler().parallelFor(count, [&](int k) {
+            const uint8_t *prev = k > 0 ? images[k - 1].data() : (previous.empty() ? nullptr : previous.data());
+            encodeGifFrame(images[k].data(), prev, width, height, palette.transparentIndex(), minCodeSize, blocks[k]);
+        });
+        for (int k = 0; k < count; ++k) {
+            const size_t i = start + k;
+            int delay = static_cast<int>(std::llround((i + 1) * 100.0 / fps) - std::llround(i * 100.0 / fps));
+            writer.addFrame(blocks[k], delay);
+        }
+        previous.swap(images[count - 1]);
+        ctx.setProgress(0.1 + 0.9 * (start + count) / total, "Кодирование GIF");
+    }
+    if(!writer.close())
+        return QString("Не удалось записать GIF:\n%1").arg(params.output);
+    ctx.setProgress(1.0, "Готово");
+    return QString();
+}
+
+// Экспорт HTML-плеера: только кодирование кадров, без растеризации
+static QString runHtmlPlayerExport(const std::shared_ptr<FrameStore> &frames, const std::vector<std::string> &glyphs,
+                                   double fps, bool blackWhite, int fontPx, const QString &fileName,
+                                   ExportJobContext &ctx) {
+    HtmlPlayerEncoder encoder(blackWhite);
+    const size_t total = frames->size();
+    for (size_t i = 0; i < total; ++i) {
+        if(ctx.cancelled())
+            return "Отменено";
+        const AsciiFrame frame = frames->at(i);
+        if(!encoder.addFrame(frame))
+            return QString("Кадр %1 другого размера (%2x%3 вместо %4x%5): HTML-плеер хранит одну сетку")
+                .arg(i + 1).arg(frame.cols).arg(frame.rows).arg(encoder.columns()).arg(encoder.rows());
+        ctx.setProgress(0.95 * (i + 1) / total, "Кодирование кадров");
+    }
+    std::string html = encoder.document(glyphs, fps, fontPx);
+    QFile file(fileName);
+    if(!file.open(QIODevice::WriteOnly))
+        return QString("Не удалось открыть файл:\n%1").arg(fileName);
+    file.write(html.data(), static_cast<qint64>(html.size()));
+    file.close();
+    ctx.setProgress(1.0, "Готово");
+    return QString();
+}
+
+// Экспорт для терминала (.ans или asciinema .cast): кадры по одному читаются из хранилища,
+// дельта-кодируются и сразу пишутся в файл, без растеризации
+static QString runTerminalExport(const std::shared_ptr<FrameStore> &frames, const std::vector<std::string> &glyphs,
+                                 double fps, bool blackWhite, const QString &fileName, ExportJobContext &ctx) {
+    TerminalExportWriter::Options opts;
+    opts.glyphs = glyphs;
+    opts.depth = blackWhite ? ColorDepth::Mono : ColorDepth::TrueColor;
+    opts.format = terminalExportFormatForPath(fileName.toStdString());
+    opts.title = QFileInfo(fileName).completeBaseName().toStdString();
+    TerminalExportWriter writer(opts);
+    if(!writer.open(fileName.toStdString()))
+        return QString("Не удалось открыть файл:\n%1").arg(fileName);
+    const size_t total = frames->size();
+    for (size_t i = 0; i < total; ++i) {
+        if(ctx.cancelled())
+            return "Отменено";
+        if(!writer.addFrame(frames->at(i), i / fps))
+            return QString("Не удалось записать файл:\n%1").arg(fileName);
+        ctx.setProgress(static_cast<double>(i + 1) / total, "Запись кадров");
+    }
+    if(!writer.close(total / fps))
+        return QString("Не удалось записать файл:\n%1").arg(fileName);
+    ctx.setProgress(1.0, "Готово");
+    return QString();
+}
+
 // Главное окно приложения
 class AsciiArtApp : public QMainWindow {
     Q_OBJECT
@@ -134,6 +610,10 @@ public:
 
         m_monospaceFont = QFont("Courier New", 10);
 
+        // Один планировщик на все вкладки и фоновые задания: потоков по числу ядер.
+        // Кадр внутри задания не делится по строкам - ядра уже поделены между заданиями
+        m_scheduler = std::make_unique<WorkScheduler>(0, []() { ascii_detail::rowPartsLimit() = 1; });
+
         m_tabWidget = new QTabWidget(this);
         setCentralWidget(m_tabWidget);
 
@@ -151,36 +631,67 @@ public:
         connect(btnClose, &QPushButton::clicked, this, &QWidget::close);
         m_tabWidget->setCornerWidget(btnClose, Qt::TopRightCorner);
 
+        // Вкладки видео и GIF (и всё мультимедиа) создаются при первом открытии:
+        // тому, кто конвертирует одно изображение, они не нужны
+        m_videoTabReady = false;
+        m_gifTabReady = false;
         initImageTab();
-        initVideoTab();
-        initGifTab();
-
-        m_player = new QMediaPlayer(this);
-        m_audioOutput = new QAudioOutput(this);
-        m_player->setAudioOutput(m_audioOutput);
-
-        m_playTimer = new QTimer(this);
-        m_playTimer->setInterval(15);
-        connect(m_playTimer, &QTimer::timeout, this, &AsciiArtApp::showNextFrame);
-
-        m_gifPlayTimer = new QTimer(this);
-        m_gifPlayTimer->setInterval(15);
-        connect(m_gifPlayTimer, &QTimer::timeout, this, &AsciiArtApp::showNextGifFrame);
+        connect(m_tabWidget, &QTabWidget::currentChanged, this, &AsciiArtApp::ensureTab);
+
+        // Экспорт выполняется фоновыми заданиями; их список - в нижней панели
+        m_exportJobs = new ExportJobManager(m_scheduler.get(), this);
+        QDockWidget *exportDock = new QDockWidget("Экспорт", this);
+        exportDock->setWidget(new ExportJobsPanel(m_exportJobs));
+        addDockWidget(Qt::BottomDockWidgetArea, exportDock);
+        connect(m_exportJobs, &ExportJobManager::jobFinished, this,
+                [this](int, bool ok, bool cancelled, const QString &message) {
+            if(ok)
+                statusBar()->showMessage("Экспорт завершён", 5000);
+            else if(!cancelled)
+                statusBar()->showMessage(QString("Ошибка экспорта: %1").arg(message.left(200)), 10000);
+        });
+
+        // Загрузка планировщика в строке состояния
+        m_schedulerStatus = new QLabel;
+        m_schedulerStatus->setToolTip("Заняты потоков из общего числа и ожидающие задания по приоритетам:\n"
+                                      "интерактивные / экспорт / предобработка");
+        statusBar()->addPermanentWidget(m_schedulerStatus);
+        QTimer *schedulerTimer = new QTimer(this);
+        connect(schedulerTimer, &QTimer::timeout, this, &AsciiArtApp::updateSchedulerStatus);
+        schedulerTimer->start(kSchedulerStatusIntervalMs);
+        updateSchedulerStatus();
+
+        m_player = nullptr;
+        m_audioOutput = nullptr;
+        m_playTimer = nullptr;
+        m_gifPlayTimer = nullptr;
 
         m_preprocThread = nullptr;
         m_videoFps = 24.0;
-        m_currentFrameIndex = 0;
+        m_videoLength = 0;
+        m_videoTargetWidth = 0;
+        m_currentFrameIndex = -1;
 
         m_gifPreprocThread = nullptr;
         m_gifFps = 24.0;
-        m_currentGifFrameIndex = 0;
+        m_gifLength = 0;
+        m_gifTargetWidth = 0;
+        m_currentGifFrameIndex = -1;
 
         m_imgBlackWhite = false;
+        m_imgFrameBlackWhite = false;
         m_videoBlackWhite = false;
+        m_videoAdaptive = false;
+        m_videoStabilize = false;
         m_gifBlackWhite = false;
+        m_gifStabilize = false;
     }
 
     ~AsciiArtApp() {
+        // Вся работа отменяется, затем планировщик дожидается своих очередей
+        if(m_imgConversion)
+            m_imgConversion->cancel();
+        m_exportJobs->cancelAll();
         if(m_preprocThread) {
             m_preprocThread->stop();
             m_preprocThread->wait();
@@ -191,14 +702,19 @@ public:
             m_gifPreprocThread->wait();
             delete m_gifPreprocThread;
         }
+        m_scheduler->shutdown();
         if(m_player)
             m_player->stop();
     }
 
+    WorkScheduler &scheduler() { return *m_scheduler; }
+
 protected:
     void closeEvent(QCloseEvent *event) override {
-        m_playTimer->stop();
-        m_gifPlayTimer->stop();
+        if(m_playTimer)
+            m_playTimer->stop();
+        if(m_gifPlayTimer)
+            m_gifPlayTimer->stop();
         if(m_preprocThread) {
             m_preprocThread->stop();
             m_preprocThread->wait();
@@ -213,6 +729,30 @@ protected:
     }
 
 private slots:
+    void updateSchedulerStatus() {
+        const WorkScheduler::Stats stats = m_scheduler->stats();
+        m_schedulerStatus->setText(QString("Потоки: %1 из %2 (загрузка %3%) | Очередь: %4 / %5 / %6")
+                                       .arg(stats.busy).arg(stats.workers)
+                                       .arg(static_cast<int>(std::lround(stats.utilization * 100)))
+                                       .arg(stats.queued[static_cast<int>(TaskPriority::Interactive)])
+                                       .arg(stats.queued[static_cast<int>(TaskPriority::Normal)])
+                                       .arg(stats.queued[static_cast<int>(TaskPriority::Bulk)]));
+    }
+
+    // Построение вкладки при первом переходе на неё
+    void ensureTab(int index) {
+        QWidget *tab = m_tabWidget->widget(index);
+        if(tab == m_videoTab && !m_videoTabReady) {
+            m_videoTabReady = true;
+            initVideoTab();
+            StartupTiming::mark("вкладка видео построена");
+        } else if(tab == m_gifTab && !m_gifTabReady) {
+            m_gifTabReady = true;
+            initGifTab();
+            StartupTiming::mark("вкладка GIF построена");
+        }
+    }
+
     // Слоты для обработки вкладки "Изображение в ASCII"
     void updateImgCharset(int index) {
         QString preset = m_imgPresetCombo->itemData(index).toString();
@@ -232,66 +772,84 @@ private slots:
             QMessageBox::warning(this, "Ошибка", "Сначала выберите изображение.");
             return;
         }
-        cv::Mat img = cv::imread(m_currentImagePath.toStdString());
-        if(img.empty()){
-            QMessageBox::warning(this, "Ошибка", "Не удалось открыть изображение.");
-            return;
-        }
         int dw = m_imgSpinWidth->value();
         QString asciiChars = m_imgCharsetEdit->text();
         if(asciiChars.isEmpty()){
             QMessageBox::warning(this, "Ошибка", "Набор символов пуст.");
             return;
         }
-        int h = img.rows, w = img.cols;
-        double aspect = static_cast<double>(h) / w;
-        int newH = std::max(1, static_cast<int>(dw * aspect * 0.55));
-        cv::Mat resized;
-        cv::resize(img, resized, cv::Size(dw, newH));
-        QStringList lines;
-        int length = asciiChars.length();
         m_progressImage->setValue(0);
-        for (int row = 0; row < newH; ++row) {
-            QString rowStr;
-            for (int col = 0; col < dw; ++col) {
-                cv::Vec3b pixel = resized.at<cv::Vec3b>(row, col);
-                int b = pixel[0], g = pixel[1], r = pixel[2];
-                double gray = 0.299*r + 0.587*g + 0.114*b;
-                int idx = static_cast<int>(gray / 255 * (length - 1));
-                idx = std::max(0, std::min(idx, length - 1));
-                QChar ch = asciiChars[idx];
-                if(m_imgBlackWhite)
-                    rowStr.append(ch);
-                else
-                    rowStr.append(QString("<span style=\"color: rgb(%1,%2,%3)\">%4</span>")
-                                  .arg(r).arg(g).arg(b).arg(ch));
-            }
-            lines.append(rowStr);
-            int progress = (row + 1) * 100 / newH;
-            m_progressImage->setValue(progress);
-            qApp->processEvents();
-        }
-        if(m_imgBlackWhite) {
-            m_imgAsciiDisplay->setStyleSheet("background-color: black; color: white;");
-            m_imgAsciiDisplay->setPlainText(lines.join("\n"));
-        } else {
-            m_imgAsciiDisplay->setStyleSheet("background-color: black;");
-            m_imgAsciiDisplay->setHtml(lines.join("<br>"));
+        // Прежняя конвертация больше не нужна: она прервётся на ближайшем этапе
+        if(m_imgConversion)
+            m_imgConversion->cancel();
+        // Декодируется только нужное для ширины dw разрешение; сначала приходит узкое превью.
+        // Результаты возвращаются в поток окна очередью событий
+        DitherMode dither = static_cast<DitherMode>(m_imgDitherCombo->currentData().toInt());
+        auto conversion = std::make_shared<ImageConversion>(m_currentImagePath, dw, asciiChars, dither, m_imgBlackWhite);
+        m_imgConversion = conversion;
+        m_scheduler->submit([this, conversion]() {
+            // Свой поток и простаивающие рабочие: помощники строк не превышают числа ядер
+            const int rowParts = 1 + m_scheduler->idleWorkers();
+            const bool ok = conversion->run(rowParts, [this, conversion]() {
+                QMetaObject::invokeMethod(this, [this, conversion]() { onImagePreviewReady(conversion); },
+                                          Qt::QueuedConnection);
+            });
+            QMetaObject::invokeMethod(this, [this, conversion, ok]() { onImageConverted(conversion, ok); },
+                                      Qt::QueuedConnection);
+        }, TaskPriority::Interactive);
+    }
+
+    void onImagePreviewReady(const std::shared_ptr<ImageConversion> &conversion) {
+        if(conversion != m_imgConversion)
+            return;
+        const double scale = static_cast<double>(conversion->desiredWidth()) /
+                             std::max(1, kPreviewColumns);
+        showAsciiText(m_imgAsciiDisplay, conversion->previewText(), conversion->blackWhite(),
+                      m_imgZoomSlider->value() * scale);
+        m_progressImage->setValue(50);
+        statusBar()->showMessage(QString("Превью через %1 мс").arg(conversion->previewMs()), 5000);
+    }
+
+    void onImageConverted(const std::shared_ptr<ImageConversion> &conversion, bool ok) {
+        if(conversion != m_imgConversion)
+            return;
+        m_imgConversion.reset();
+        if(!ok) {
+            m_progressImage->setValue(0);
+            onImgZoomChanged(m_imgZoomSlider->value());
+            QMessageBox::warning(this, "Ошибка", "Не удалось открыть изображение.");
+            return;
         }
+        m_imgGlyphs = conversion->glyphs();
+        m_imgFrame = conversion->frame();
+        m_imgFrameBlackWhite = conversion->blackWhite();
+        showAsciiText(m_imgAsciiDisplay, conversion->text(), conversion->blackWhite(), m_imgZoomSlider->value());
+        m_progressImage->setValue(100);
+        QString status = QString("Готово за %1 мс").arg(conversion->totalMs());
+        if(conversion->previewMs() >= 0)
+            status += QString(" (превью через %1 мс)").arg(conversion->previewMs());
+        if(conversion->loadInfo().reduction > 1)
+            status += QString(" | %1, уменьшение в %2 раз").arg(QString::fromUtf8(conversion->loadInfo().method))
+                          .arg(conversion->loadInfo().reduction);
+        statusBar()->showMessage(status, 5000);
     }
 
     void saveHtmlImage() {
-        QString htmlCode = m_imgAsciiDisplay->toHtml();
-        if(htmlCode.trimmed().isEmpty()){
+        if(m_imgFrame.glyphs.empty()){
             QMessageBox::information(this, "Пусто", "Нет ASCII-арта.");
             return;
         }
         QString fileName = QFileDialog::getSaveFileName(this, "Сохранить HTML", "", "HTML файлы (*.html)");
         if(!fileName.isEmpty()){
+            // Документ строится напрямую из символов и цветов ячеек, минуя QTextEdit::toHtml()
+            HtmlOptions opts;
+            opts.blackWhite = m_imgFrameBlackWhite;
+            opts.usePalette = m_imgHtmlPaletteCheck->isChecked();
+            QString fontCss = QString("%1pt/1.1 monospace").arg(m_imgAsciiDisplay->font().pointSize());
+            std::string html = asciiFrameToHtmlDocument(m_imgFrame, m_imgGlyphs, opts, fontCss.toStdString());
             QFile file(fileName);
-            if(file.open(QIODevice::WriteOnly | QIODevice::Text)){
-                QTextStream out(&file);
-                out << htmlCode;
+            if(file.open(QIODevice::WriteOnly)){
+                file.write(html.data(), static_cast<qint64>(html.size()));
                 file.close();
                 QMessageBox::information(this, "Успех", QString("Сохранено:\n%1").arg(fileName));
             }
@@ -387,67 +945,139 @@ private slots:
             m_preprocThread->wait();
             delete m_preprocThread;
         }
-        m_preprocThread = new PreprocessingThread(m_currentVideoPath, w, chars, m_videoBlackWhite, this);
+        m_videoGlyphs = glyphTable(chars);
+        // Новое хранилище: задания экспорта продолжают работать со старым, пока не завершатся
+        m_asciiFrames = std::make_shared<FrameStore>(static_cast<qint64>(m_videoBudgetSpin->value()) * 1024 * 1024);
+        m_preprocThread = new PreprocessingThread(m_currentVideoPath, w, chars,
+                                                   static_cast<DitherMode>(m_videoDitherCombo->currentData().toInt()),
+                                                   m_videoStabilize, m_videoDecodersSpin->value(),
+                                                   m_asciiFrames.get(), m_scheduler.get(), this);
         connect(m_preprocThread, &PreprocessingThread::finished, this, &AsciiArtApp::onPreprocessingFinished);
         connect(m_preprocThread, &PreprocessingThread::progress, this, &AsciiArtApp::onPreprocessingProgress);
+        connect(m_preprocThread, &PreprocessingThread::previewReady, this, &AsciiArtApp::onVideoPreviewReady);
+        connect(m_preprocThread, &PreprocessingThread::framesReady, this, &AsciiArtApp::onVideoFramesReady);
+        m_videoTargetWidth = w;
+        m_videoPreviewTimer.invalidate();
         m_preprocThread->start();
     }
 
-    void onPreprocessingFinished(const std::vector<QString> &frames, double fps) {
-        m_asciiFrames = frames;
+    void onPreprocessingFinished(double fps) {
         m_videoFps = fps;
-        m_videoLength = frames.size();
+        m_videoLength = m_asciiFrames->size();
+        m_videoStoreStatus->setText(frameStoreStatus(m_asciiFrames->stats()));
         if(m_preprocThread) {
             m_preprocThread->wait();
+            m_videoStoreStatus->setText(m_videoStoreStatus->text() + " | " + m_preprocThread->summary());
             delete m_preprocThread;
             m_preprocThread = nullptr;
         }
-        if(m_asciiFrames.empty() || m_videoLength == 0){
+        if(m_asciiFrames->empty() || m_videoLength == 0){
             QMessageBox::warning(this, "Ошибка", "Не удалось получить кадры из видео.");
             m_btnPreprocPlay->setEnabled(true);
             m_btnStop->setEnabled(false);
             return;
         }
         m_progressVideo->setValue(100);
-        m_videoStartTime = QDateTime::currentMSecsSinceEpoch();
-        m_currentFrameIndex = 0;
+        m_currentFrameIndex = -1;
         m_videoAsciiDisplay->clear();
-        m_playTimer->start();
+        onVideoZoomChanged(m_videoZoomSlider->value());
+        ensureMediaPlayer();
         m_player->setSource(QUrl::fromLocalFile(m_currentVideoPath));
         m_player->play();
+        // Часы идут по позиции звука; пока плеер загружается, они стоят
+        m_videoClock.start(m_player);
+        m_videoQuality = AdaptiveQuality(AdaptiveQuality::Options(), ColorDepth::TrueColor);
+        m_videoQuality.setTargetFps(m_videoFps);
+        showNextFrame();
     }
 
     void onPreprocessingProgress(int processed, int total) {
         if(total > 0) {
             int percentage = processed * 100 / total;
             m_progressVideo->setValue(percentage);
+            if(processed % 25 == 0)
+                m_videoStoreStatus->setText(frameStoreStatus(m_asciiFrames->stats()));
         } else {
             m_progressVideo->setValue(0);
         }
     }
 
+    // Первый кадр в узкой ширине, пока отрезки только переходят к своему началу
+    void onVideoPreviewReady() {
+        if(!m_preprocThread || m_videoPreviewTimer.isValid())
+            return;
+        showAsciiFrame(m_videoAsciiDisplay, m_preprocThread->preview(), m_videoGlyphs, m_videoBlackWhite,
+                       m_videoTargetWidth, m_videoZoomSlider->value());
+    }
+
+    // Полная ширина догоняет превью: последний кадр из готового начала
+    void onVideoFramesReady(int count) {
+        if(!m_preprocThread || count <= 0)
+            return;
+        if(m_videoPreviewTimer.isValid() && m_videoPreviewTimer.elapsed() < kPreprocessPreviewIntervalMs)
+            return;
+        m_videoPreviewTimer.start();
+        showAsciiFrame(m_videoAsciiDisplay, m_asciiFrames->at(count - 1), m_videoGlyphs, m_videoBlackWhite,
+                       m_videoTargetWidth, m_videoZoomSlider->value());
+    }
+
     void showNextFrame() {
-        qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-        qint64 elapsed = currentTime - m_videoStartTime;
-        int frameIndex = static_cast<int>(elapsed / 1000.0 * m_videoFps);
+        int frameIndex = static_cast<int>(m_videoClock.positionMs() * m_videoFps / 1000.0);
         if(frameIndex >= static_cast<int>(m_videoLength)) {
             stopVideo();
             return;
         }
-        if(frameIndex != m_currentFrameIndex) {
-            if(m_videoBlackWhite){
-                m_videoAsciiDisplay->setStyleSheet("background-color: black; color: white;");
-                m_videoAsciiDisplay->setPlainText(m_asciiFrames[frameIndex]);
-            } else {
-                m_videoAsciiDisplay->setStyleSheet("background-color: black;");
-                m_videoAsciiDisplay->setHtml(m_asciiFrames[frameIndex]);
-            }
+        // В адаптивном режиме показывается каждый step-й кадр
+        const int step = m_videoAdaptive ? m_videoQuality.frameStep() : 1;
+        frameIndex -= frameIndex % step;
+        if(frameIndex > m_currentFrameIndex) {
+            QElapsedTimer cost;
+            cost.start();
+            const AsciiFrame frame = m_asciiFrames->at(frameIndex);
+            presentVideoFrame(frame);
+            m_videoClock.notePresented(frameIndex, m_videoFps, frameIndex - m_currentFrameIndex - 1);
             m_currentFrameIndex = frameIndex;
+            if(m_videoAdaptive)
+                m_videoQuality.addSample(cost.nsecsElapsed() / 1e6);
+            if(frameIndex % 30 < step) {
+                m_videoStoreStatus->setText(frameStoreStatus(m_asciiFrames->stats()));
+                m_videoSyncStatus->setText(m_videoClock.statusText());
+                m_videoQualityStatus->setText(m_videoAdaptive
+                    ? QString::fromStdString("Адаптивное " + m_videoQuality.statusText(frame.cols))
+                    : QString());
+            }
+        }
+        m_playTimer->start(m_videoClock.msUntilFrame((m_currentFrameIndex / step + 1) * step, m_videoFps));
+    }
+
+    // Вывод кадра в виджет. Адаптивный режим сужает кадр, укрупняет цветовые span
+    // (аналог 256 цветов) или переходит на простой текст
+    void presentVideoFrame(const AsciiFrame &frame) {
+        bool blackWhite = m_videoBlackWhite;
+        int tolerance = HtmlOptions().colorTolerance;
+        const AsciiFrame *shown = &frame;
+        if(m_videoAdaptive) {
+            blackWhite = blackWhite || m_videoQuality.depth() == ColorDepth::Mono;
+            if(m_videoQuality.depth() == ColorDepth::Ansi256)
+                tolerance = kCoarseColorTolerance;
+            int cols = m_videoQuality.width(frame.cols);
+            if(cols < frame.cols) {
+                downscaleAsciiFrame(frame, cols, m_videoScaledFrame);
+                shown = &m_videoScaledFrame;
+            }
+        }
+        if(blackWhite){
+            m_videoAsciiDisplay->setStyleSheet("background-color: black; color: white;");
+            m_videoAsciiDisplay->setPlainText(frameToText(*shown, m_videoGlyphs, true));
+        } else {
+            m_videoAsciiDisplay->setStyleSheet("background-color: black;");
+            m_videoAsciiDisplay->setHtml(frameToText(*shown, m_videoGlyphs, false, tolerance));
         }
     }
 
     void stopVideo() {
         m_playTimer->stop();
+        m_videoSyncStatus->setText(m_videoClock.statusText());
         if(m_player)
             m_player->stop();
         m_btnPreprocPlay->setEnabled(true);
@@ -457,6 +1087,7 @@ private slots:
             m_preprocThread->wait();
             delete m_preprocThread;
             m_preprocThread = nullptr;
+            onVideoZoomChanged(m_videoZoomSlider->value());
         }
     }
 
@@ -467,111 +1098,66 @@ private slots:
     }
 
     void saveVideoWithAudio() {
-        try {
-            if(m_asciiFrames.empty()){
-                QMessageBox::warning(this, "Ошибка", "Нет обработанных кадров для сохранения видео.");
-                return;
-            }
-            QString fileName = QFileDialog::getSaveFileName(this, "Сохранить видео", "", "Видео файлы (*.mp4)");
-            if(fileName.isEmpty())
-                return;
-            if(!fileName.endsWith(".mp4", Qt::CaseInsensitive))
-                fileName += ".mp4";
-
-            QFont font = m_videoAsciiDisplay->font();
-            QFontMetrics fm(font);
-            int charWidth = fm.averageCharWidth();
-            int expectedWidth = m_videoSpinWidth->value();
-            int width = charWidth * expectedWidth;
-            QString firstFrame = m_asciiFrames[0];
-            QStringList lines = m_videoBlackWhite ? firstFrame.split("\n") : firstFrame.split("<br>");
-            int height = fm.height() * lines.size();
-
-            if(width <= 0 || height <= 0){
-                QMessageBox::critical(this, "Ошибка", QString("Некорректные размеры видео: %1x%2").arg(width).arg(height));
-                return;
-            }
+        if(!m_asciiFrames || m_asciiFrames->empty()){
+            QMessageBox::warning(this, "Ошибка", "Нет обработанных кадров для сохранения видео.");
+            return;
+        }
+        QString fileName = QFileDialog::getSaveFileName(this, "Сохранить видео", "", "Видео файлы (*.mp4)");
+        if(fileName.isEmpty())
+            return;
+        if(!fileName.endsWith(".mp4", Qt::CaseInsensitive))
+            fileName += ".mp4";
+        RasterExportParams params;
+        params.frames = m_asciiFrames;
+        params.glyphs = m_videoGlyphs;
+        params.blackWhite = m_videoBlackWhite;
+        params.font = m_videoAsciiDisplay->font();
+        params.columns = m_videoSpinWidth->value();
+        params.fps = m_videoFps;
+        params.output = fileName;
+        params.audioSource = m_currentVideoPath;
+        m_exportJobs->submit(QString("Видео: %1").arg(QFileInfo(fileName).fileName()),
+                             [params](ExportJobContext &ctx) { return runVideoExport(params, ctx); });
+    }
 
-            QString tempVideo = QDir::tempPath() + "/temp_video.avi";
-            int fourcc = cv::VideoWriter::fourcc('X','V','I','D');
-            cv::VideoWriter out(tempVideo.toStdString(), fourcc, m_videoFps, cv::Size(width, height));
-            if(!out.isOpened()){
-                QMessageBox::critical(this, "Ошибка", "Не удалось инициализировать VideoWriter.");
-                return;
-            }
-            for (const auto &frameText : m_asciiFrames) {
-                QImage image(width, height, QImage::Format_ARGB32);
-                image.fill(Qt::black);
-                QPainter painter(&image);
-                painter.setFont(font);
-                if(m_videoBlackWhite){
-                    painter.setPen(Qt::white);
-                    int y = fm.ascent();
-                    QStringList textLines = frameText.split("\n");
-                    for(const QString &line : textLines) {
-                        painter.drawText(0, y, line.left(expectedWidth));
-                        y += fm.height();
-                    }
-                } else {
-                    QTextDocument doc;
-                    doc.setHtml(frameText);
-                    doc.setDefaultFont(font);
-                    doc.setTextWidth(width);
-                    doc.drawContents(&painter);
-                }
-                painter.end();
-                QImage rgbImage = image.convertToFormat(QImage::Format_RGB32);
-                // Преобразование QImage в cv::Mat
-                cv::Mat mat(rgbImage.height(), rgbImage.width(), CV_8UC4, const_cast<uchar*>(rgbImage.bits()), rgbImage.bytesPerLine());
-                cv::Mat frameBGR;
-                cv::cvtColor(mat, frameBGR, cv::COLOR_BGRA2BGR);
-                out.write(frameBGR);
-            }
-            out.release();
+    // Экспорт в самодостаточный HTML-плеер (без растеризации и FFmpeg); fontPx - размер шрифта поля в пикселях
+    void saveHtmlPlayer(const std::shared_ptr<FrameStore> &frames, const std::vector<std::string> &glyphs,
+                        double fps, bool blackWhite, int fontPx) {
+        if(!frames || frames->empty()){
+            QMessageBox::warning(this, "Ошибка", "Нет обработанных кадров для сохранения.");
+            return;
+        }
+        QString fileName = QFileDialog::getSaveFileName(this, "Сохранить HTML-плеер", "", "HTML файлы (*.html)");
+        if(fileName.isEmpty())
+            return;
+        if(!fileName.endsWith(".html", Qt::CaseInsensitive))
+            fileName += ".html";
+        m_exportJobs->submit(QString("HTML: %1").arg(QFileInfo(fileName).fileName()),
+                             [=](ExportJobContext &ctx) {
+            return runHtmlPlayerExport(frames, glyphs, fps, blackWhite, fontPx, fileName, ctx);
+        });
+    }
 
-            // Используем QProcess для вызова ffmpeg
-            QString ffmpegPath = "ffmpeg";
-            QProcess process;
-            process.start(ffmpegPath, QStringList() << "-version");
-            process.waitForFinished();
-            if(process.exitCode() != 0) {
-#ifdef Q_OS_WIN
-                QString exeDir = QCoreApplication::applicationDirPath();
-                ffmpegPath = exeDir + "/ffmpeg/bin/ffmpeg.exe";
-#else
-                QString exeDir = QCoreApplication::applicationDirPath();
-                ffmpegPath = exeDir + "/ffmpeg/bin/ffmpeg";
-#endif
-                if(!QFile::exists(ffmpegPath)) {
-                    QMessageBox::critical(this, "Ошибка", QString("FFmpeg не найден.\n- Системный FFmpeg отсутствует в PATH.\n- Локальный FFmpeg не найден по пути: %1").arg(ffmpegPath));
-                    return;
-                }
-            }
-            QString audioFile = QDir::tempPath() + "/temp_audio.mp3";
-            QStringList audioCmd;
-            audioCmd << "-y" << "-i" << m_currentVideoPath << "-vn" << "-acodec" << "mp3" << audioFile;
-            process.start(ffmpegPath, audioCmd);
-            process.waitForFinished();
-            if(process.exitCode() != 0) {
-                QString errorMsg = process.readAllStandardError();
-                QMessageBox::critical(this, "Ошибка", QString("Не удалось извлечь аудио:\n%1").arg(errorMsg));
-                return;
-            }
-            QStringList mergeCmd;
-            mergeCmd << "-y" << "-i" << tempVideo << "-i" << audioFile << "-c:v" << "libx264" << "-c:a" << "aac" << "-shortest" << fileName;
-            process.start(ffmpegPath, mergeCmd);
-            process.waitForFinished();
-            if(process.exitCode() != 0) {
-                QString errorMsg = process.readAllStandardError();
-                QMessageBox::critical(this, "Ошибка", QString("Не удалось объединить видео и аудио:\n%1").arg(errorMsg));
-                return;
-            }
-            QFile::remove(tempVideo);
-            QFile::remove(audioFile);
-            QMessageBox::information(this, "Успех", QString("Видео сохранено:\n%1").arg(fileName));
-        } catch (...) {
-            QMessageBox::critical(this, "Ошибка", "Произошла ошибка при сохранении видео.");
+    // Экспорт для терминала: поток ANSI (проигрывается через cat) или запись asciinema
+    void saveTerminalRecording(const std::shared_ptr<FrameStore> &frames, const std::vector<std::string> &glyphs,
+                               double fps, bool blackWhite) {
+        if(!frames || frames->empty()){
+            QMessageBox::warning(this, "Ошибка", "Нет обработанных кадров для сохранения.");
+            return;
         }
+        QString filter;
+        QString fileName = QFileDialog::getSaveFileName(this, "Сохранить для терминала", "",
+                                                        "ANSI (*.ans);;asciinema (*.cast)", &filter);
+        if(fileName.isEmpty())
+            return;
+        if(!fileName.endsWith(".ans", Qt::CaseInsensitive) && !fileName.endsWith(".cast", Qt::CaseInsensitive))
+            fileName += filter.contains("cast") ? ".cast" : ".ans";
+        if(fps <= 0)
+            fps = 24.0;
+        m_exportJobs->submit(QString("Терминал: %1").arg(QFileInfo(fileName).fileName()),
+                             [=](ExportJobContext &ctx) {
+            return runTerminalExport(frames, glyphs, fps, blackWhite, fileName, ctx);
+        });
     }
 
     // Слоты для вкладки "GIF в ASCII"
@@ -608,63 +1194,101 @@ private slots:
             m_gifPreprocThread->wait();
             delete m_gifPreprocThread;
         }
-        m_gifPreprocThread = new PreprocessingThread(m_currentGifPath, w, chars, m_gifBlackWhite, this);
+        m_gifGlyphs = glyphTable(chars);
+        m_gifAsciiFrames = std::make_shared<FrameStore>(static_cast<qint64>(m_gifBudgetSpin->value()) * 1024 * 1024);
+        // GIF декодируется одним декодером: переход к кадру GIF требует декодировать все предыдущие
+        m_gifPreprocThread = new PreprocessingThread(m_currentGifPath, w, chars,
+                                                      static_cast<DitherMode>(m_gifDitherCombo->currentData().toInt()),
+                                                      m_gifStabilize, 1, m_gifAsciiFrames.get(),
+                                                      m_scheduler.get(), this);
         connect(m_gifPreprocThread, &PreprocessingThread::finished, this, &AsciiArtApp::onGifPreprocessingFinished);
         connect(m_gifPreprocThread, &PreprocessingThread::progress, this, &AsciiArtApp::onGifPreprocessingProgress);
+        connect(m_gifPreprocThread, &PreprocessingThread::previewReady, this, &AsciiArtApp::onGifPreviewReady);
+        connect(m_gifPreprocThread, &PreprocessingThread::framesReady, this, &AsciiArtApp::onGifFramesReady);
+        m_gifTargetWidth = w;
+        m_gifPreviewTimer.invalidate();
         m_gifPreprocThread->start();
     }
 
-    void onGifPreprocessingFinished(const std::vector<QString> &frames, double fps) {
-        m_gifAsciiFrames = frames;
+    void onGifPreprocessingFinished(double fps) {
         m_gifFps = fps;
-        m_gifLength = frames.size();
+        m_gifLength = m_gifAsciiFrames->size();
+        m_gifStoreStatus->setText(frameStoreStatus(m_gifAsciiFrames->stats()));
         if(m_gifPreprocThread) {
             m_gifPreprocThread->wait();
+            m_gifStoreStatus->setText(m_gifStoreStatus->text() + " | " + m_gifPreprocThread->summary());
             delete m_gifPreprocThread;
             m_gifPreprocThread = nullptr;
         }
-        if(m_gifAsciiFrames.empty() || m_gifLength == 0){
+        if(m_gifAsciiFrames->empty() || m_gifLength == 0){
             QMessageBox::warning(this, "Ошибка", "Не удалось получить кадры из GIF.");
             m_btnPreprocGif->setEnabled(true);
             m_btnStopGif->setEnabled(false);
             return;
         }
         m_progressGif->setValue(100);
-        m_gifStartTime = QDateTime::currentMSecsSinceEpoch();
-        m_currentGifFrameIndex = 0;
+        m_currentGifFrameIndex = -1;
         m_gifAsciiDisplay->clear();
-        m_gifPlayTimer->start();
+        onGifZoomChanged(m_gifZoomSlider->value());
+        m_gifClock.start();
+        showNextGifFrame();
     }
 
     void onGifPreprocessingProgress(int processed, int total) {
         if(total > 0) {
             int percentage = processed * 100 / total;
             m_progressGif->setValue(percentage);
+            if(processed % 25 == 0)
+                m_gifStoreStatus->setText(frameStoreStatus(m_gifAsciiFrames->stats()));
         } else {
             m_progressGif->setValue(0);
         }
     }
 
+    void onGifPreviewReady() {
+        if(!m_gifPreprocThread || m_gifPreviewTimer.isValid())
+            return;
+        showAsciiFrame(m_gifAsciiDisplay, m_gifPreprocThread->preview(), m_gifGlyphs, m_gifBlackWhite,
+                       m_gifTargetWidth, m_gifZoomSlider->value());
+    }
+
+    void onGifFramesReady(int count) {
+        if(!m_gifPreprocThread || count <= 0)
+            return;
+        if(m_gifPreviewTimer.isValid() && m_gifPreviewTimer.elapsed() < kPreprocessPreviewIntervalMs)
+            return;
+        m_gifPreviewTimer.start();
+        showAsciiFrame(m_gifAsciiDisplay, m_gifAsciiFrames->at(count - 1), m_gifGlyphs, m_gifBlackWhite,
+                       m_gifTargetWidth, m_gifZoomSlider->value());
+    }
+
     void showNextGifFrame() {
         if(m_gifLength == 0)
             return;
-        qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-        qint64 elapsed = currentTime - m_gifStartTime;
-        int frameIndex = static_cast<int>((elapsed / 1000.0 * m_gifFps)) % m_gifLength;
-        if(frameIndex != m_currentGifFrameIndex) {
+        // Индекс считается без учёта зацикливания, чтобы пропуски на стыке тоже учитывались
+        qint64 absIndex = static_cast<qint64>(m_gifClock.positionMs() * m_gifFps / 1000.0);
+        if(absIndex > m_currentGifFrameIndex) {
+            int frameIndex = static_cast<int>(absIndex % static_cast<qint64>(m_gifLength));
             if(m_gifBlackWhite){
                 m_gifAsciiDisplay->setStyleSheet("background-color: black; color: white;");
-                m_gifAsciiDisplay->setPlainText(m_gifAsciiFrames[frameIndex]);
+                m_gifAsciiDisplay->setPlainText(frameToText(m_gifAsciiFrames->at(frameIndex), m_gifGlyphs, true));
             } else {
                 m_gifAsciiDisplay->setStyleSheet("background-color: black;");
-                m_gifAsciiDisplay->setHtml(m_gifAsciiFrames[frameIndex]);
+                m_gifAsciiDisplay->setHtml(frameToText(m_gifAsciiFrames->at(frameIndex), m_gifGlyphs, false));
+            }
+            m_gifClock.notePresented(absIndex, m_gifFps, absIndex - m_currentGifFrameIndex - 1);
+            m_currentGifFrameIndex = absIndex;
+            if(frameIndex % 30 == 0) {
+                m_gifStoreStatus->setText(frameStoreStatus(m_gifAsciiFrames->stats()));
+                m_gifSyncStatus->setText(m_gifClock.statusText());
             }
-            m_currentGifFrameIndex = frameIndex;
         }
+        m_gifPlayTimer->start(m_gifClock.msUntilFrame(m_currentGifFrameIndex + 1, m_gifFps));
     }
 
     void stopGif() {
         m_gifPlayTimer->stop();
+        m_gifSyncStatus->setText(m_gifClock.statusText());
         m_btnPreprocGif->setEnabled(true);
         m_btnStopGif->setEnabled(false);
         if(m_gifPreprocThread) {
@@ -672,6 +1296,7 @@ private slots:
             m_gifPreprocThread->wait();
             delete m_gifPreprocThread;
             m_gifPreprocThread = nullptr;
+            onGifZoomChanged(m_gifZoomSlider->value());
         }
     }
 
@@ -682,88 +1307,25 @@ private slots:
     }
 
     void saveGif() {
-        try {
-            if(m_gifAsciiFrames.empty()){
-                QMessageBox::warning(this, "Ошибка", "Нет обработанных кадров для сохранения GIF.");
-                return;
-            }
-            QString fileName = QFileDialog::getSaveFileName(this, "Сохранить GIF", "", "GIF файлы (*.gif)");
-            if(fileName.isEmpty())
-                return;
-            if(!fileName.endsWith(".gif", Qt::CaseInsensitive))
-                fileName += ".gif";
-
-            QFont font = m_gifAsciiDisplay->font();
-            QFontMetrics fm(font);
-            int expectedWidth = m_gifSpinWidth->value();
-            QString firstFrame = m_gifAsciiFrames[0];
-            QStringList lines = m_gifBlackWhite ? firstFrame.split("\n") : firstFrame.split("<br>");
-            int lineCount = lines.size();
-            int charWidth = fm.averageCharWidth();
-            int width = charWidth * expectedWidth;
-            int height = fm.height() * lineCount;
-
-            QString tempVideo = QDir::tempPath() + "/temp_gif_video.mp4";
-            int fourcc = cv::VideoWriter::fourcc('m','p','4','v');
-            cv::VideoWriter out(tempVideo.toStdString(), fourcc, m_gifFps, cv::Size(width, height));
-            for (const auto &frameText : m_gifAsciiFrames) {
-                QImage image(width, height, QImage::Format_ARGB32);
-                image.fill(Qt::black);
-                QPainter painter(&image);
-                painter.setFont(font);
-                if(m_gifBlackWhite) {
-                    painter.setPen(Qt::white);
-                    int y = fm.ascent();
-                    QStringList textLines = frameText.split("\n");
-                    for(const QString &line : textLines) {
-                        painter.drawText(0, y, line.left(expectedWidth));
-                        y += fm.height();
-                    }
-                } else {
-                    QTextDocument doc;
-                    doc.setHtml(frameText);
-                    doc.setDefaultFont(font);
-                    doc.setTextWidth(width);
-                    doc.drawContents(&painter);
-                }
-                painter.end();
-                QImage rgbImage = image.convertToFormat(QImage::Format_RGB32);
-                cv::Mat mat(rgbImage.height(), rgbImage.width(), CV_8UC4, const_cast<uchar*>(rgbImage.bits()), rgbImage.bytesPerLine());
-                cv::Mat frameBGR;
-                cv::cvtColor(mat, frameBGR, cv::COLOR_BGRA2BGR);
-                out.write(frameBGR);
-            }
-            out.release();
-
-            QString ffmpegPath = "ffmpeg";
-            QProcess process;
-            process.start(ffmpegPath, QStringList() << "-version");
-            process.waitForFinished();
-            if(process.exitCode() != 0) {
-#ifdef Q_OS_WIN
-                QString exeDir = QCoreApplication::applicationDirPath();
-                ffmpegPath = exeDir + "/ffmpeg/bin/ffmpeg.exe";
-#else
-                QString exeDir = QCoreApplication::applicationDirPath();
-                ffmpegPath = exeDir + "/ffmpeg/bin/ffmpeg";
-#endif
-                if(!QFile::exists(ffmpegPath)) {
-                    QMessageBox::critical(this, "Ошибка", QString("FFmpeg не найден.\n- Системный FFmpeg отсутствует в PATH.\n- Локальный FFmpeg не найден по пути: %1").arg(ffmpegPath));
-                    return;
-                }
-            }
-            QStringList cmd;
-            cmd << "-y" << "-i" << tempVideo << "-vf" << QString("fps=%1,scale=%2:-1:flags=lanczos").arg(m_gifFps).arg(width) << fileName;
-            process.start(ffmpegPath, cmd);
-            process.waitForFinished();
-            QFile::remove(tempVideo);
-            if(process.exitCode() == 0)
-                QMessageBox::information(this, "Успех", QString("GIF сохранён:\n%1").arg(fileName));
-            else
-                QMessageBox::critical(this, "Ошибка", QString("Не удалось сохранить GIF.\n%1").arg(process.readAllStandardError()));
-        } catch (...) {
-            QMessageBox::critical(this, "Ошибка", "Произошла ошибка при сохранении GIF.");
+        if(!m_gifAsciiFrames || m_gifAsciiFrames->empty()){
+            QMessageBox::warning(this, "Ошибка", "Нет обработанных кадров для сохранения GIF.");
+            return;
         }
+        QString fileName = QFileDialog::getSaveFileName(this, "Сохранить GIF", "", "GIF файлы (*.gif)");
+        if(fileName.isEmpty())
+            return;
+        if(!fileName.endsWith(".gif", Qt::CaseInsensitive))
+            fileName += ".gif";
+        RasterExportParams params;
+        params.frames = m_gifAsciiFrames;
+        params.glyphs = m_gifGlyphs;
+        params.blackWhite = m_gifBlackWhite;
+        params.font = m_gifAsciiDisplay->font();
+        params.columns = m_gifSpinWidth->value();
+        params.fps = m_gifFps;
+        params.output = fileName;
+        m_exportJobs->submit(QString("GIF: %1").arg(QFileInfo(fileName).fileName()),
+                             [params](ExportJobContext &ctx) { return runGifExport(params, ctx); });
     }
 
     // Инициализация пользовательского интерфейса
@@ -803,6 +1365,10 @@ private slots:
         connect(imgBwCheckbox, &QCheckBox::toggled, [this](bool checked){ m_imgBlackWhite = checked; });
         topLayout->addWidget(imgBwCheckbox);
 
+        m_imgDitherCombo = new QComboBox;
+        fillDitherCombo(m_imgDitherCombo);
+        topLayout->addWidget(m_imgDitherCombo);
+
         QPushButton *btnConvertImg = new QPushButton("Конвертировать");
         connect(btnConvertImg, &QPushButton::clicked, this, &AsciiArtApp::convertImageToAscii);
         topLayout->addWidget(btnConvertImg);
@@ -831,9 +1397,13 @@ private slots:
         m_progressImage->setFixedHeight(10);
         layout->addWidget(m_progressImage);
 
+        QHBoxLayout *htmlLayout = new QHBoxLayout;
         QPushButton *btnSaveImg = new QPushButton("Сохранить HTML");
         connect(btnSaveImg, &QPushButton::clicked, this, &AsciiArtApp::saveHtmlImage);
-        layout->addWidget(btnSaveImg);
+        htmlLayout->addWidget(btnSaveImg, 1);
+        m_imgHtmlPaletteCheck = new QCheckBox("Палитра CSS-классов");
+        htmlLayout->addWidget(m_imgHtmlPaletteCheck);
+        layout->addLayout(htmlLayout);
 
         QPushButton *btnSaveImgAsPic = new QPushButton("Сохранить как изображение");
         connect(btnSaveImgAsPic, &QPushButton::clicked, this, &AsciiArtApp::saveImageAsPicture);
@@ -855,6 +1425,17 @@ private slots:
         m_videoSpinWidth->setRange(10, 400);
         m_videoSpinWidth->setValue(78);
         videoWidthForm->addRow("Символов:", m_videoSpinWidth);
+        m_videoBudgetSpin = new QSpinBox;
+        m_videoBudgetSpin->setRange(16, 16384);
+        m_videoBudgetSpin->setValue(256);
+        m_videoBudgetSpin->setToolTip("Бюджет памяти для кадров; остальные кадры выгружаются во временный файл");
+        videoWidthForm->addRow("Память, МБ:", m_videoBudgetSpin);
+        m_videoDecodersSpin = new QSpinBox;
+        m_videoDecodersSpin->setRange(0, 16);
+        m_videoDecodersSpin->setValue(0);
+        m_videoDecodersSpin->setSpecialValueText("авто");
+        m_videoDecodersSpin->setToolTip("Сколько отрезков видео декодировать параллельно (авто - по числу ядер)");
+        videoWidthForm->addRow("Декодеров:", m_videoDecodersSpin);
         videoWidthGroup->setLayout(videoWidthForm);
         controlsLayout->addWidget(videoWidthGroup);
 
@@ -876,6 +1457,24 @@ private slots:
         connect(videoBwCheckbox, &QCheckBox::toggled, [this](bool checked){ m_videoBlackWhite = checked; });
         controlsLayout->addWidget(videoBwCheckbox);
 
+        m_videoDitherCombo = new QComboBox;
+        fillDitherCombo(m_videoDitherCombo);
+        controlsLayout->addWidget(m_videoDitherCombo);
+
+        QCheckBox *videoAdaptiveCheckbox = new QCheckBox("Адаптивное качество");
+        videoAdaptiveCheckbox->setToolTip("Снижать ширину, цвет и частоту показа, если вывод не успевает за видео");
+        connect(videoAdaptiveCheckbox, &QCheckBox::toggled, [this](bool checked){
+            m_videoAdaptive = checked;
+            m_videoQuality.reset();
+            m_videoQualityStatus->clear();
+        });
+        controlsLayout->addWidget(videoAdaptiveCheckbox);
+
+        QCheckBox *videoStabilizeCheckbox = new QCheckBox("Стабилизация кадров");
+        videoStabilizeCheckbox->setToolTip("Не переключать символы и цвета от шума и артефактов сжатия (применяется при следующей предобработке)");
+        connect(videoStabilizeCheckbox, &QCheckBox::toggled, [this](bool checked){ m_videoStabilize = checked; });
+        controlsLayout->addWidget(videoStabilizeCheckbox);
+
         m_btnPreprocPlay = new QPushButton("Воспроизвести");
         connect(m_btnPreprocPlay, &QPushButton::clicked, this, &AsciiArtApp::startPreprocessing);
         controlsLayout->addWidget(m_btnPreprocPlay);
@@ -891,6 +1490,13 @@ private slots:
         m_progressVideo->setValue(0);
         layout->addWidget(m_progressVideo);
 
+        m_videoStoreStatus = new QLabel;
+        layout->addWidget(m_videoStoreStatus);
+        m_videoSyncStatus = new QLabel;
+        layout->addWidget(m_videoSyncStatus);
+        m_videoQualityStatus = new QLabel;
+        layout->addWidget(m_videoQualityStatus);
+
         QHBoxLayout *videoZoomLayout = new QHBoxLayout;
         QLabel *videoZoomLabel = new QLabel("Масштаб:");
         m_videoZoomSlider = new QSlider(Qt::Horizontal);
@@ -911,6 +1517,36 @@ private slots:
         QPushButton *btnSaveVideo = new QPushButton("Сохранить видео");
         connect(btnSaveVideo, &QPushButton::clicked, this, &AsciiArtApp::saveVideoWithAudio);
         layout->addWidget(btnSaveVideo);
+
+        QPushButton *btnSaveVideoHtml = new QPushButton("Сохранить HTML-плеер");
+        connect(btnSaveVideoHtml, &QPushButton::clicked, this, [this]() {
+            saveHtmlPlayer(m_asciiFrames, m_videoGlyphs, m_videoFps, m_videoBlackWhite,
+                           QFontInfo(m_videoAsciiDisplay->font()).pixelSize());
+        });
+        layout->addWidget(btnSaveVideoHtml);
+
+        QPushButton *btnSaveVideoTerminal = new QPushButton("Сохранить для терминала (.ans / .cast)");
+        connect(btnSaveVideoTerminal, &QPushButton::clicked, this, [this]() {
+            saveTerminalRecording(m_asciiFrames, m_videoGlyphs, m_videoFps, m_videoBlackWhite);
+        });
+        layout->addWidget(btnSaveVideoTerminal);
+
+        // Однократный точный таймер: каждый кадр планируется ровно к своему сроку
+        m_playTimer = new QTimer(this);
+        m_playTimer->setSingleShot(true);
+        m_playTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_playTimer, &QTimer::timeout, this, &AsciiArtApp::showNextFrame);
+    }
+
+    // Плеер звука создаётся перед первым воспроизведением видео: инициализация
+    // мультимедийного бэкенда заметно удлиняет запуск
+    void ensureMediaPlayer() {
+        if(m_player)
+            return;
+        m_player = new QMediaPlayer(this);
+        m_audioOutput = new QAudioOutput(this);
+        m_player->setAudioOutput(m_audioOutput);
+        StartupTiming::mark("мультимедиа инициализированы");
     }
 
     void initGifTab() {
@@ -928,6 +1564,11 @@ private slots:
         m_gifSpinWidth->setRange(10, 400);
         m_gifSpinWidth->setValue(78);
         gifWidthForm->addRow("Символов:", m_gifSpinWidth);
+        m_gifBudgetSpin = new QSpinBox;
+        m_gifBudgetSpin->setRange(16, 16384);
+        m_gifBudgetSpin->setValue(256);
+        m_gifBudgetSpin->setToolTip("Бюджет памяти для кадров; остальные кадры выгружаются во временный файл");
+        gifWidthForm->addRow("Память, МБ:", m_gifBudgetSpin);
         gifWidthGroup->setLayout(gifWidthForm);
         controlsLayout->addWidget(gifWidthGroup);
 
@@ -949,6 +1590,15 @@ private slots:
         connect(gifBwCheckbox, &QCheckBox::toggled, [this](bool checked){ m_gifBlackWhite = checked; });
         controlsLayout->addWidget(gifBwCheckbox);
 
+        m_gifDitherCombo = new QComboBox;
+        fillDitherCombo(m_gifDitherCombo);
+        controlsLayout->addWidget(m_gifDitherCombo);
+
+        QCheckBox *gifStabilizeCheckbox = new QCheckBox("Стабилизация кадров");
+        gifStabilizeCheckbox->setToolTip("Не переключать символы и цвета от шума и артефактов сжатия");
+        connect(gifStabilizeCheckbox, &QCheckBox::toggled, [this](bool checked){ m_gifStabilize = checked; });
+        controlsLayout->addWidget(gifStabilizeCheckbox);
+
         m_btnPreprocGif = new QPushButton("Конвертировать");
         connect(m_btnPreprocGif, &QPushButton::clicked, this, &AsciiArtApp::startPreprocessingGif);
         controlsLayout->addWidget(m_btnPreprocGif);
@@ -964,6 +1614,11 @@ private slots:
         m_progressGif->setValue(0);
         layout->addWidget(m_progressGif);
 
+        m_gifStoreStatus = new QLabel;
+        layout->addWidget(m_gifStoreStatus);
+        m_gifSyncStatus = new QLabel;
+        layout->addWidget(m_gifSyncStatus);
+
         QHBoxLayout *gifZoomLayout = new QHBoxLayout;
         QLabel *gifZoomLabel = new QLabel("Масштаб:");
         m_gifZoomSlider = new QSlider(Qt::Horizontal);
@@ -984,30 +1639,60 @@ private slots:
         QPushButton *btnSaveGif = new QPushButton("Сохранить GIF");
         connect(btnSaveGif, &QPushButton::clicked, this, &AsciiArtApp::saveGif);
         layout->addWidget(btnSaveGif);
+
+        QPushButton *btnSaveGifHtml = new QPushButton("Сохранить HTML-плеер");
+        connect(btnSaveGifHtml, &QPushButton::clicked, this, [this]() {
+            saveHtmlPlayer(m_gifAsciiFrames, m_gifGlyphs, m_gifFps, m_gifBlackWhite,
+                           QFontInfo(m_gifAsciiDisplay->font()).pixelSize());
+        });
+        layout->addWidget(btnSaveGifHtml);
+
+        QPushButton *btnSaveGifTerminal = new QPushButton("Сохранить для терминала (.ans / .cast)");
+        connect(btnSaveGifTerminal, &QPushButton::clicked, this, [this]() {
+            saveTerminalRecording(m_gifAsciiFrames, m_gifGlyphs, m_gifFps, m_gifBlackWhite);
+        });
+        layout->addWidget(btnSaveGifTerminal);
+
+        m_gifPlayTimer = new QTimer(this);
+        m_gifPlayTimer->setSingleShot(true);
+        m_gifPlayTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_gifPlayTimer, &QTimer::timeout, this, &AsciiArtApp::showNextGifFrame);
     }
 
 private:
     // Основные элементы интерфейса
     QTabWidget *m_tabWidget;
+    std::unique_ptr<WorkScheduler> m_scheduler;
+    QLabel *m_schedulerStatus;
+    ExportJobManager *m_exportJobs;
     QWidget *m_imageTab;
     QWidget *m_videoTab;
     QWidget *m_gifTab;
+    bool m_videoTabReady;
+    bool m_gifTabReady;
     QFont m_monospaceFont;
 
     // Элементы вкладки "Изображение в ASCII"
     QSpinBox *m_imgSpinWidth;
     QLineEdit *m_imgCharsetEdit;
     QComboBox *m_imgPresetCombo;
+    QComboBox *m_imgDitherCombo;
     QTextEdit *m_imgAsciiDisplay;
     QProgressBar *m_progressImage;
     QSlider *m_imgZoomSlider;
+    QCheckBox *m_imgHtmlPaletteCheck;
     QString m_currentImagePath;
     bool m_imgBlackWhite;
+    AsciiFrame m_imgFrame;
+    std::vector<std::string> m_imgGlyphs;
+    bool m_imgFrameBlackWhite;
+    std::shared_ptr<ImageConversion> m_imgConversion;
 
     // Элементы вкладки "Видео в ASCII"
     QSpinBox *m_videoSpinWidth;
     QLineEdit *m_videoCharsetEdit;
     QComboBox *m_videoPresetCombo;
+    QComboBox *m_videoDitherCombo;
     QTextEdit *m_videoAsciiDisplay;
     QProgressBar *m_progressVideo;
     QSlider *m_videoZoomSlider;
@@ -1017,18 +1702,31 @@ private:
     QMediaPlayer *m_player;
     QAudioOutput *m_audioOutput;
     QTimer *m_playTimer;
-    qint64 m_videoStartTime;
+    PresentationClock m_videoClock;
     int m_currentFrameIndex;
     double m_videoFps;
     size_t m_videoLength;
-    std::vector<QString> m_asciiFrames;
+    int m_videoTargetWidth;                 // ширина кадров идущей предобработки
+    QElapsedTimer m_videoPreviewTimer;      // последний показ готового кадра во время предобработки
+    std::shared_ptr<FrameStore> m_asciiFrames;
+    QSpinBox *m_videoBudgetSpin;
+    QSpinBox *m_videoDecodersSpin;
+    QLabel *m_videoStoreStatus;
+    QLabel *m_videoSyncStatus;
+    QLabel *m_videoQualityStatus;
+    std::vector<std::string> m_videoGlyphs;
     bool m_videoBlackWhite;
+    bool m_videoAdaptive;
+    bool m_videoStabilize;
+    AdaptiveQuality m_videoQuality;
+    AsciiFrame m_videoScaledFrame;
     PreprocessingThread *m_preprocThread;
 
     // Элементы вкладки "GIF в ASCII"
     QSpinBox *m_gifSpinWidth;
     QLineEdit *m_gifCharsetEdit;
     QComboBox *m_gifPresetCombo;
+    QComboBox *m_gifDitherCombo;
     QTextEdit *m_gifAsciiDisplay;
     QProgressBar *m_progressGif;
     QSlider *m_gifZoomSlider;
@@ -1036,20 +1734,38 @@ private:
     QPushButton *m_btnStopGif;
     QString m_currentGifPath;
     QTimer *m_gifPlayTimer;
-    qint64 m_gifStartTime;
-    int m_currentGifFrameIndex;
+    PresentationClock m_gifClock;
+    qint64 m_currentGifFrameIndex;
     double m_gifFps;
     size_t m_gifLength;
-    std::vector<QString> m_gifAsciiFrames;
+    int m_gifTargetWidth;
+    QElapsedTimer m_gifPreviewTimer;
+    std::shared_ptr<FrameStore> m_gifAsciiFrames;
+    QSpinBox *m_gifBudgetSpin;
+    QLabel *m_gifStoreStatus;
+    QLabel *m_gifSyncStatus;
+    std::vector<std::string> m_gifGlyphs;
     bool m_gifBlackWhite;
+    bool m_gifStabilize;
     PreprocessingThread *m_gifPreprocThread;
 };
 
 #include "main.moc"
 
 int main(int argc, char *argv[]) {
+    StartupTiming::start();
     QApplication app(argc, argv);
+    if(app.arguments().contains("--startup-timing"))
+        StartupTiming::enable();
+    StartupTiming::mark("QApplication создан");
     AsciiArtApp window;
+    StartupTiming::mark("окно построено");
     window.show();
+    // Первый проход цикла событий: окно отрисовано и принимает ввод. Прогрев
+    // библиотек начинается только после этого и идёт в фоне
+    QTimer::singleShot(0, &window, [&window]() {
+        StartupTiming::mark("окно готово к вводу");
+        window.scheduler().post(warmUpBackends, TaskPriority::Bulk);
+    });
     return app.exec();
 }
@@ -19,6 +19,18 @@ from PyQt6.QtWidgets import (
 )
 from PyQt6.QtMultimedia import QMediaPlayer, QAudioOutput
 
+# C++-ядро конвертации (модуль asciiart_native собирается CMake вместе с приложением,
+# его нужно положить рядом с main.py или в PYTHONPATH). Без него работает код на Python
+try:
+    import asciiart_native as native
+except ImportError:
+    native = None
+
+
+# Ядро работает с наборами от 2 до 256 символов, остальные обрабатываются на Python
+def use_native(ascii_chars):
+    return native is not None and 2 <= len(ascii_chars) <= 256
+
 logging.basicConfig(
     filename='save_video_log.txt',
     level=logging.INFO,
@@ -43,8 +55,12 @@ class PreprocessingThread(QThread):
         self.ascii_chars = ascii_chars
         self.black_white = black_white
         self._run_flag = True
+        self._native_job = None
 
     def run(self):
+        if use_native(self.ascii_chars):
+            self.run_native()
+            return
         cap = cv2.VideoCapture(self.video_path)
         if not cap.isOpened():
             self.finished.emit([], 0.0)
@@ -97,8 +113,22 @@ class PreprocessingThread(QThread):
         cap.release()
         self.finished.emit(ascii_frames, real_fps)
 
+    # Декодирование и конвертация в C++ без GIL: интерфейс остаётся отзывчивым
+    def run_native(self):
+        job = native.VideoPreprocessor(self.video_path, self.desired_width, self.ascii_chars,
+                                       black_white=self.black_white)
+        self._native_job = job
+        if not self._run_flag:
+            job.stop()
+        ascii_frames, real_fps = job.run(self.progress.emit)
+        self._native_job = None
+        self.finished.emit(ascii_frames, real_fps)
+
     def stop(self):
         self._run_flag = False
+        job = self._native_job
+        if job is not None:
+            job.stop()
 
 # Главное окно приложения
 class AsciiArtApp(QMainWindow):
@@ -277,17 +307,33 @@ class AsciiArtApp(QMainWindow):
         if not self.current_image_path:
             QMessageBox.warning(self, "Ошибка", "Сначала выберите изображение.")
             return
-        img = imread_unicode(self.current_image_path)
-        if img is None:
-            QMessageBox.warning(self, "Ошибка", "Не удалось открыть изображение.")
-            return
-
         dw = self.img_spin_width.value()
         ascii_chars = self.img_charset_edit.text()
         if not ascii_chars:
             QMessageBox.warning(self, "Ошибка", "Набор символов пуст.")
             return
 
+        # Ядро декодирует только нужное для ширины разрешение
+        if use_native(ascii_chars):
+            img = native.load_image(self.current_image_path, dw)
+        else:
+            img = imread_unicode(self.current_image_path)
+        if img is None:
+            QMessageBox.warning(self, "Ошибка", "Не удалось открыть изображение.")
+            return
+
+        if use_native(ascii_chars):
+            frame = native.convert_frame(img, dw, len(ascii_chars))
+            text = native.frame_text(frame, ascii_chars, self.img_black_white)
+            self.progress_image.setValue(100)
+            if self.img_black_white:
+                self.img_ascii_display.setStyleSheet("background-color: black; color: white;")
+                self.img_ascii_display.setPlainText(text)
+            else:
+                self.img_ascii_display.setStyleSheet("background-color: black;")
+                self.img_ascii_display.setHtml(text)
+            return
+
         h, w = img.shape[:2]
         aspect = h / w
         new_h = max(1, int(dw * aspect * 0.55))
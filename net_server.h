@@ -0,0 +1,392 @@
+// net_server.h
+// Однопоточный сетевой цикл для потоковых режимов консольной утилиты: неблокирующие
+// сокеты, epoll на Linux (poll на остальных POSIX-системах) и очереди отправки из
+// разделяемых буферов - закодированный один раз кадр уходит всем клиентам без копирования.
+// Состояние соединений меняется только в потоке цикла; другие потоки передают
+// работу через post()
+
+#ifndef NET_SERVER_H
+#define NET_SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+// Неизменяемый буфер, разделяемый очередями всех клиентов
+using SharedBuffer = std::shared_ptr<const std::string>;
+
+inline SharedBuffer makeSharedBuffer(std::string data) {
+    return std::make_shared<const std::string>(std::move(data));
+}
+
+class NetServer {
+public:
+    struct Counters {
+        uint64_t accepted = 0;
+        uint64_t bytesSent = 0;
+        uint64_t framesDropped = 0;   // кадров пропущено из-за переполненных очередей
+    };
+
+    NetServer() = default;
+    // Наследник обязан остановить цикл в своём деструкторе: к этому месту его обработчики
+    // уже разрушены, здесь stop() лишь страховка для явно остановленного сервера
+    virtual ~NetServer() {
+        stop();
+        for (auto &entry : m_connections)
+            ::close(entry.first);
+        if (m_listenFd >= 0)
+            ::close(m_listenFd);
+        if (m_wakeRead >= 0) {
+            ::close(m_wakeRead);
+            ::close(m_wakeWrite);
+        }
+#ifdef __linux__
+        if (m_epollFd >= 0)
+            ::close(m_epollFd);
+#endif
+    }
+
+    NetServer(const NetServer &) = delete;
+    NetServer &operator=(const NetServer &) = delete;
+
+    // Открытие порта на всех интерфейсах; error получает текст ошибки
+    bool listen(int port, std::string &error) {
+        std::signal(SIGPIPE, SIG_IGN);
+        m_listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenFd < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        int one = 1;
+        ::setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (::bind(m_listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+            ::listen(m_listenFd, 512) < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        setNonBlocking(m_listenFd);
+        int pipeFds[2];
+        if (::pipe(pipeFds) < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        m_wakeRead = pipeFds[0];
+        m_wakeWrite = pipeFds[1];
+        setNonBlocking(m_wakeRead);
+        setNonBlocking(m_wakeWrite);
+#ifdef __linux__
+        m_epollFd = ::epoll_create1(0);
+        if (m_epollFd < 0) {
+            error = std::strerror(errno);
+            return false;
+        }
+        watch(m_listenFd, EPOLLIN, EPOLL_CTL_ADD);
+        watch(m_wakeRead, EPOLLIN, EPOLL_CTL_ADD);
+#endif
+        return true;
+    }
+
+    void start() {
+        if (!m_thread.joinable())
+            m_thread = std::thread([this]() { loop(); });
+    }
+
+    void stop() {
+        m_stop = true;
+        wake();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Выполнение задачи в потоке сетевого цикла
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m_taskMutex);
+            m_tasks.push_back(std::move(task));
+        }
+        wake();
+    }
+
+    size_t clientCount() const { return m_clientCount; }
+    Counters counters() const {
+        Counters c;
+        c.accepted = m_accepted;
+        c.bytesSent = m_bytesSent;
+        c.framesDropped = m_framesDropped;
+        return c;
+    }
+
+protected:
+    struct Connection {
+        virtual ~Connection() = default;
+        int fd = -1;
+        std::string inbox;                 // принятые, ещё не разобранные байты
+        std::deque<SharedBuffer> queue;    // очередь отправки
+        size_t offset = 0;                 // отправлено байт из queue.front()
+        size_t queuedBytes = 0;            // не отправлено байт во всей очереди
+        bool closeAfterFlush = false;
+        bool closed = false;
+        bool wantWrite = false;
+    };
+
+    virtual std::unique_ptr<Connection> createConnection() { return std::make_unique<Connection>(); }
+    // Новые данные в c.inbox; обработчик удаляет разобранную часть
+    virtual void onData(Connection &c) = 0;
+    virtual void onClosed(Connection &) {}
+    // Вызывается раз в цикл (не реже чем раз в 200 мс)
+    virtual void onIdle() {}
+
+    // Постановка буфера в очередь клиента и попытка сразу отправить
+    void send(Connection &c, const SharedBuffer &buffer) {
+        if (c.closed || !buffer || buffer->empty())
+            return;
+        c.queue.push_back(buffer);
+        c.queuedBytes += buffer->size();
+        flush(c);
+    }
+
+    // Сброс очереди клиента, кроме частично отправленного буфера (его нельзя прервать
+    // посреди сообщения). Возвращает число отброшенных буферов
+    size_t dropQueued(Connection &c) {
+        size_t keep = c.offset > 0 ? 1 : 0;
+        size_t dropped = c.queue.size() - keep;
+        while (c.queue.size() > keep) {
+            c.queuedBytes -= c.queue.back()->size();
+            c.queue.pop_back();
+        }
+        if (keep)
+            c.queuedBytes = c.queue.front()->size() - c.offset;
+        m_framesDropped += dropped;
+        return dropped;
+    }
+
+    void closeConnection(Connection &c) { c.closed = true; }
+
+    template <typename Fn>
+    void forEachConnection(Fn fn) {
+        for (auto &entry : m_connections) {
+            if (!entry.second->closed)
+                fn(*entry.second);
+        }
+    }
+
+private:
+    static void setNonBlocking(int fd) {
+        int flags = ::fcntl(fd, F_GETFL, 0);
+        ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+
+    void wake() {
+        if (m_wakeWrite >= 0) {
+            char byte = 1;
+            ssize_t ignored = ::write(m_wakeWrite, &byte, 1);
+            (void)ignored;
+        }
+    }
+
+#ifdef __linux__
+    void watch(int fd, uint32_t events, int op) {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        ::epoll_ctl(m_epollFd, op, fd, &ev);
+    }
+#endif
+
+    void updateInterest(Connection &c) {
+        bool want = !c.queue.empty();
+        if (want == c.wantWrite)
+            return;
+        c.wantWrite = want;
+#ifdef __linux__
+        watch(c.fd, EPOLLIN | (want ? static_cast<uint32_t>(EPOLLOUT) : 0u), EPOLL_CTL_MOD);
+#endif
+    }
+
+    void flush(Connection &c) {
+        while (!c.queue.empty()) {
+            const std::string &front = *c.queue.front();
+#ifdef MSG_NOSIGNAL
+            ssize_t sent = ::send(c.fd, front.data() + c.offset, front.size() - c.offset, MSG_NOSIGNAL);
+#else
+            ssize_t sent = ::send(c.fd, front.data() + c.offset, front.size() - c.offset, 0);
+#endif
+            if (sent < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    c.closed = true;
+                break;
+            }
+            c.offset += static_cast<size_t>(sent);
+            c.queuedBytes -= static_cast<size_t>(sent);
+            m_bytesSent += static_cast<uint64_t>(sent);
+            if (c.offset == front.size()) {
+                c.queue.pop_front();
+                c.offset = 0;
+            }
+        }
+        if (c.queue.empty() && c.closeAfterFlush)
+            c.closed = true;
+        if (!c.closed)
+            updateInterest(c);
+    }
+
+    void acceptClients() {
+        for (;;) {
+            int fd = ::accept(m_listenFd, nullptr, nullptr);
+            if (fd < 0)
+                return;
+            setNonBlocking(fd);
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+            ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            std::unique_ptr<Connection> c = createConnection();
+            c->fd = fd;
+#ifdef __linux__
+            watch(fd, EPOLLIN, EPOLL_CTL_ADD);
+#endif
+            m_connections[fd] = std::move(c);
+            ++m_accepted;
+            m_clientCount = m_connections.size();
+        }
+    }
+
+    void readFrom(Connection &c) {
+        char buf[16384];
+        for (;;) {
+            ssize_t got = ::recv(c.fd, buf, sizeof(buf), 0);
+            if (got > 0) {
+                c.inbox.append(buf, static_cast<size_t>(got));
+                continue;
+            }
+            if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                c.closed = true;
+            break;
+        }
+        if (!c.inbox.empty())
+            onData(c);
+        // Клиент, присылающий данные, которые протокол не разбирает, отключается
+        if (c.inbox.size() > kMaxInbox)
+            c.closed = true;
+    }
+
+    void runTasks() {
+        char drain[256];
+        while (::read(m_wakeRead, drain, sizeof(drain)) > 0) {
+        }
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(m_taskMutex);
+            tasks.swap(m_tasks);
+        }
+        for (auto &task : tasks)
+            task();
+    }
+
+    void handle(int fd, bool readable, bool writable) {
+        if (fd == m_listenFd) {
+            acceptClients();
+            return;
+        }
+        if (fd == m_wakeRead) {
+            runTasks();
+            return;
+        }
+        auto it = m_connections.find(fd);
+        if (it == m_connections.end() || it->second->closed)
+            return;
+        if (readable)
+            readFrom(*it->second);
+        if (writable && !it->second->closed)
+            flush(*it->second);
+    }
+
+    void sweep() {
+        for (auto it = m_connections.begin(); it != m_connections.end();) {
+            if (!it->second->closed) {
+                ++it;
+                continue;
+            }
+#ifdef __linux__
+            ::epoll_ctl(m_epollFd, EPOLL_CTL_DEL, it->first, nullptr);
+#endif
+            ::close(it->first);
+            onClosed(*it->second);
+            it = m_connections.erase(it);
+        }
+        m_clientCount = m_connections.size();
+    }
+
+    void loop() {
+        while (!m_stop) {
+#ifdef __linux__
+            epoll_event events[256];
+            int n = ::epoll_wait(m_epollFd, events, 256, 200);
+            for (int i = 0; i < n; ++i) {
+                handle(events[i].data.fd, (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0,
+                       (events[i].events & EPOLLOUT) != 0);
+            }
+#else
+            std::vector<pollfd> fds;
+            fds.push_back({m_listenFd, POLLIN, 0});
+            fds.push_back({m_wakeRead, POLLIN, 0});
+            for (auto &entry : m_connections)
+                fds.push_back({entry.first, static_cast<short>(POLLIN | (entry.second->queue.empty() ? 0 : POLLOUT)), 0});
+            int n = ::poll(fds.data(), fds.size(), 200);
+            for (size_t i = 0; n > 0 && i < fds.size(); ++i) {
+                if (fds[i].revents)
+                    handle(fds[i].fd, (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0,
+                           (fds[i].revents & POLLOUT) != 0);
+            }
+#endif
+            onIdle();
+            sweep();
+        }
+    }
+
+    static const size_t kMaxInbox = 64 * 1024;
+
+    int m_listenFd = -1;
+    int m_wakeRead = -1;
+    int m_wakeWrite = -1;
+#ifdef __linux__
+    int m_epollFd = -1;
+#endif
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::mutex m_taskMutex;
+    std::vector<std::function<void()>> m_tasks;
+    std::map<int, std::unique_ptr<Connection>> m_connections;
+    std::atomic<size_t> m_clientCount{0};
+    std::atomic<uint64_t> m_accepted{0};
+    std::atomic<uint64_t> m_bytesSent{0};
+    std::atomic<uint64_t> m_framesDropped{0};
+};
+
+#endif // NET_SERVER_H
@@ -0,0 +1,114 @@
+// presentation_clock.h
+// Часы воспроизведения ASCII-кадров: ведутся по позиции QMediaPlayer, если есть звук,
+// иначе по монотонному таймеру. Считают расхождение, опоздавшие и пропущенные кадры
+
+#ifndef PRESENTATION_CLOCK_H
+#define PRESENTATION_CLOCK_H
+
+#include <QElapsedTimer>
+#include <QMediaPlayer>
+#include <QString>
+
+#include <algorithm>
+#include <cmath>
+
+class PresentationClock {
+public:
+    struct Stats {
+        quint64 presented = 0;
+        quint64 late = 0;       // показаны позже, чем через один кадр после своего срока
+        quint64 dropped = 0;    // пропущены, потому что их срок уже прошёл
+        double avgDriftMs = 0.0;  // среднее |момент показа - срок кадра|
+        double maxDriftMs = 0.0;
+        bool audioDriven = false;
+    };
+
+    // audio - плеер, по позиции которого идут часы (nullptr - только монотонный таймер)
+    void start(QMediaPlayer *audio = nullptr) {
+        m_audio = audio;
+        m_mono.start();
+        m_lastPos = 0;
+        m_lastMono = 0;
+        m_lastAudioPos = -1;
+        m_audioAnchor = 0;
+        m_stats = Stats();
+        m_driftSumMs = 0.0;
+    }
+
+    // Текущая позиция воспроизведения в мс. Пока звук загружается или буферизуется,
+    // часы стоят, поэтому задержка запуска плеера не учитывается дважды
+    qint64 positionMs() {
+        qint64 now = m_mono.elapsed();
+        qint64 pos;
+        if (m_audio && waitingForAudio()) {
+            pos = m_lastPos;
+        } else if (m_audio && m_audio->hasAudio() && m_audio->playbackState() == QMediaPlayer::PlayingState) {
+            // Позиция плеера обновляется порциями; между обновлениями досчитываем
+            // монотонным таймером, но не дальше kMaxExtrapolationMs
+            qint64 audioPos = m_audio->position();
+            if (audioPos != m_lastAudioPos) {
+                m_lastAudioPos = audioPos;
+                m_audioAnchor = now;
+            }
+            pos = audioPos + std::min(now - m_audioAnchor, kMaxExtrapolationMs);
+            m_stats.audioDriven = true;
+        } else {
+            pos = m_lastPos + (now - m_lastMono);
+        }
+        m_lastPos = pos;
+        m_lastMono = now;
+        return pos;
+    }
+
+    // Задержка (мс) до срока кадра с индексом index
+    int msUntilFrame(qint64 index, double fps) {
+        qint64 deadline = static_cast<qint64>(std::ceil(index * 1000.0 / fps));
+        return static_cast<int>(std::clamp<qint64>(deadline - positionMs(), 1, 1000));
+    }
+
+    // Учёт показанного кадра: skipped - сколько кадров перед ним не были показаны
+    void notePresented(qint64 index, double fps, qint64 skipped) {
+        double deadline = index * 1000.0 / fps;
+        double drift = std::abs(static_cast<double>(m_lastPos) - deadline);
+        ++m_stats.presented;
+        m_stats.dropped += static_cast<quint64>(std::max<qint64>(0, skipped));
+        if (static_cast<double>(m_lastPos) - deadline > 1000.0 / fps)
+            ++m_stats.late;
+        m_driftSumMs += drift;
+        m_stats.avgDriftMs = m_driftSumMs / m_stats.presented;
+        m_stats.maxDriftMs = std::max(m_stats.maxDriftMs, drift);
+    }
+
+    const Stats &stats() const { return m_stats; }
+
+    QString statusText() const {
+        return QString("Часы: %1 | показано: %2 | опоздали: %3 | пропущено: %4 | расхождение: ср. %5 мс, макс. %6 мс")
+            .arg(m_stats.audioDriven ? "звук" : "монотонные")
+            .arg(m_stats.presented)
+            .arg(m_stats.late)
+            .arg(m_stats.dropped)
+            .arg(m_stats.avgDriftMs, 0, 'f', 1)
+            .arg(m_stats.maxDriftMs, 0, 'f', 1);
+    }
+
+private:
+    static constexpr qint64 kMaxExtrapolationMs = 250;
+
+    // BufferingMedia - данных достаточно и звук продолжает играть, поэтому часы не держим
+    bool waitingForAudio() const {
+        QMediaPlayer::MediaStatus status = m_audio->mediaStatus();
+        return status == QMediaPlayer::LoadingMedia || status == QMediaPlayer::StalledMedia ||
+               (status == QMediaPlayer::LoadedMedia && m_audio->playbackState() != QMediaPlayer::PlayingState);
+    }
+
+    QMediaPlayer *m_audio = nullptr;
+    QElapsedTimer m_mono;
+    qint64 m_lastPos = 0;
+    qint64 m_lastMono = 0;
+    qint64 m_lastAudioPos = -1;
+    qint64 m_audioAnchor = 0;
+    double m_driftSumMs = 0.0;
+    Stats m_stats;
+};
+
+#endif // PRESENTATION_CLOCK_H
@@ -0,0 +1,133 @@
+// raster_export.h
+// Растеризация ASCII-кадров для экспорта: атлас символов отрисовывается один раз, после
+// чего кадры собираются копированием масок. Атлас только читается, поэтому один экземпляр
+// обслуживает задания планировщика, растеризующие пачку кадров параллельно
+
+#ifndef RASTER_EXPORT_H
+#define RASTER_EXPORT_H
+
+#include <QFont>
+#include <QFontMetrics>
+#include <QImage>
+#include <QPainter>
+#include <QString>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+
+// Маски покрытия символов набора, отрисованные один раз шрифтом экспорта.
+// Кадр собирается копированием масок, окрашенных цветом ячейки, без QPainter на каждый кадр
+class GlyphAtlas {
+public:
+    GlyphAtlas(const std::vector<std::string> &glyphs, const QFont &font) {
+        QFontMetrics fm(font);
+        m_cellW = std::max(1, fm.averageCharWidth());
+        m_cellH = std::max(1, fm.height());
+        m_count = std::max<size_t>(1, glyphs.size());
+        const size_t cellPixels = static_cast<size_t>(m_cellW) * m_cellH;
+        m_masks.assign(m_count * cellPixels, 0);
+        m_blank.assign(m_count, true);
+
+        QImage sheet(m_cellW * static_cast<int>(m_count), m_cellH, QImage::Format_RGB32);
+        sheet.fill(Qt::black);
+        QPainter painter(&sheet);
+        painter.setFont(font);
+        painter.setPen(Qt::white);
+        for (size_t i = 0; i < glyphs.size(); ++i) {
+            int x = static_cast<int>(i) * m_cellW;
+            painter.setClipRect(x, 0, m_cellW, m_cellH);
+            painter.drawText(x, fm.ascent(), QString::fromStdString(glyphs[i]));
+        }
+        painter.end();
+
+        for (size_t i = 0; i < m_count; ++i) {
+            uint8_t *mask = m_masks.data() + i * cellPixels;
+            for (int y = 0; y < m_cellH; ++y) {
+                const QRgb *src = reinterpret_cast<const QRgb *>(sheet.constScanLine(y)) + i * m_cellW;
+                for (int x = 0; x < m_cellW; ++x) {
+                    mask[y * m_cellW + x] = static_cast<uint8_t>(qRed(src[x]));
+                    if (mask[y * m_cellW + x])
+                        m_blank[i] = false;
+                }
+            }
+        }
+    }
+
+    int cellWidth() const { return m_cellW; }
+    int cellHeight() const { return m_cellH; }
+
+    // Отрисовка кадра в BGR-изображение size; out переиспользуется между кадрами
+    void render(const AsciiFrame &frame, bool blackWhite, cv::Size size, cv::Mat &out) const {
+        out.create(size, CV_8UC3);
+        out.setTo(cv::Scalar::all(0));
+        const int rows = std::min(frame.rows, size.height / m_cellH);
+        const int cols = std::min(frame.cols, size.width / m_cellW);
+        const size_t cellPixels = static_cast<size_t>(m_cellW) * m_cellH;
+        for (int row = 0; row < rows; ++row) {
+            const uint8_t *cells = frame.glyphs.data() + static_cast<size_t>(row) * frame.cols;
+            const cv::Vec3b *colors = blackWhite ? nullptr : frame.colors.ptr<cv::Vec3b>(row);
+            for (int col = 0; col < cols; ++col) {
+                const size_t glyph = std::min<size_t>(cells[col], m_count - 1);
+                if (m_blank[glyph])
+                    continue;
+                const uint8_t *mask = m_masks.data() + glyph * cellPixels;
+                const int b = colors ? colors[col][0] : 255;
+                const int g = colors ? colors[col][1] : 255;
+                const int r = colors ? colors[col][2] : 255;
+                for (int y = 0; y < m_cellH; ++y) {
+                    uint8_t *dst = out.ptr<uint8_t>(row * m_cellH + y) + col * m_cellW * 3;
+                    const uint8_t *src = mask + y * m_cellW;
+                    for (int x = 0; x < m_cellW; ++x) {
+                        const int a = src[x];
+                        dst[x * 3 + 0] = static_cast<uint8_t>((a * b + 127) / 255);
+                        dst[x * 3 + 1] = static_cast<uint8_t>((a * g + 127) / 255);
+                        dst[x * 3 + 2] = static_cast<uint8_t>((a * r + 127) / 255);
+                    }
+                }
+            }
+        }
+    }
+
+    // Отрисовка в индексированное изображение (для GIF): пиксели с покрытием не меньше
+    // половины получают индекс cellIndex(row, col), остальные - background. Без сглаживания
+    // в кадре нет промежуточных цветов, и текст остаётся резким
+    template <typename CellIndex>
+    void renderIndexed(const AsciiFrame &frame, cv::Size size, uint8_t background, CellIndex cellIndex,
+                       std::vector<uint8_t> &out) const {
+        out.assign(static_cast<size_t>(size.width) * size.height, background);
+        const int rows = std::min(frame.rows, size.height / m_cellH);
+        const int cols = std::min(frame.cols, size.width / m_cellW);
+        const size_t cellPixels = static_cast<size_t>(m_cellW) * m_cellH;
+        for (int row = 0; row < rows; ++row) {
+            const uint8_t *cells = frame.glyphs.data() + static_cast<size_t>(row) * frame.cols;
+            for (int col = 0; col < cols; ++col) {
+                const size_t glyph = std::min<size_t>(cells[col], m_count - 1);
+                if (m_blank[glyph])
+                    continue;
+                const uint8_t *mask = m_masks.data() + glyph * cellPixels;
+                const uint8_t index = cellIndex(row, col);
+                for (int y = 0; y < m_cellH; ++y) {
+                    uint8_t *dst = out.data() + static_cast<size_t>(row * m_cellH + y) * size.width + col * m_cellW;
+                    const uint8_t *src = mask + y * m_cellW;
+                    for (int x = 0; x < m_cellW; ++x) {
+                        if (src[x] >= 128)
+                            dst[x] = index;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    int m_cellW = 1;
+    int m_cellH = 1;
+    size_t m_count = 1;
+    std::vector<uint8_t> m_masks;
+    std::vector<bool> m_blank;
+};
+
+#endif // RASTER_EXPORT_H
@@ -0,0 +1,154 @@
+// rendition_ladder.h
+// Лестница вариантов: один декодированный кадр даёт сразу несколько ширин, наборов символов
+// и глубин цвета. Ширины строятся пирамидой усреднения по площади - самая широкая из
+// источника, каждая следующая из ближайшей более широкой, - поэтому полный кадр
+// уменьшается один раз. Варианты с одинаковыми шириной, числом символов и дизерингом
+// делят один AsciiFrame: набор символов и глубина цвета влияют только на вывод в приёмник
+
+#ifndef RENDITION_LADDER_H
+#define RENDITION_LADDER_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ascii_core.h"
+
+// Вариант вывода. Приёмник получает кадр, действительный только на время вызова;
+// false из приёмника - ошибка записи, она возвращается из RenditionLadder::process
+struct Rendition {
+    using Sink = std::function<bool(const AsciiFrame &frame, double ptsMs)>;
+
+    int width = 80;
+    std::vector<std::string> glyphs;   // набор символов (от тёмных к светлым)
+    DitherMode dither = DitherMode::None;
+    ColorDepth depth = ColorDepth::TrueColor;
+    Sink sink;
+};
+
+// Разбор описания "80,160:256,320:mono": ширина и необязательная глубина цвета
+// (truecolor|256|mono, по умолчанию defaultDepth). Пустой результат - ошибка разбора
+inline std::vector<std::pair<int, ColorDepth>> parseRenditionList(const std::string &spec, ColorDepth defaultDepth) {
+    std::vector<std::pair<int, ColorDepth>> list;
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos)
+            end = spec.size();
+        const std::string item = spec.substr(pos, end - pos);
+        const size_t colon = item.find(':');
+        const int width = std::atoi(item.substr(0, colon).c_str());
+        if (width <= 0)
+            return {};
+        ColorDepth depth = defaultDepth;
+        if (colon != std::string::npos) {
+            const std::string name = item.substr(colon + 1);
+            if (name == "256")
+                depth = ColorDepth::Ansi256;
+            else if (name == "mono")
+                depth = ColorDepth::Mono;
+            else if (name == "truecolor")
+                depth = ColorDepth::TrueColor;
+            else
+                return {};
+        }
+        list.emplace_back(width, depth);
+        pos = end + 1;
+    }
+    return list;
+}
+
+class RenditionLadder {
+public:
+    // stabilize - временная стабилизация каждого различного кадра (для видео)
+    explicit RenditionLadder(std::vector<Rendition> renditions, bool stabilize = false,
+                             StabilizerOptions stabilizer = StabilizerOptions())
+        : m_renditions(std::move(renditions)) {
+        for (Rendition &r : m_renditions)
+            r.width = std::max(1, r.width);
+
+        // Ширины пирамиды по убыванию
+        for (const Rendition &r : m_renditions)
+            m_widths.push_back(r.width);
+        std::sort(m_widths.begin(), m_widths.end(), [](int a, int b) { return a > b; });
+        m_widths.erase(std::unique(m_widths.begin(), m_widths.end()), m_widths.end());
+        m_levels.resize(m_widths.size());
+
+        // Различные кадры: ширина, число символов и дизеринг
+        for (Rendition &r : m_renditions) {
+            const int levels = static_cast<int>(std::max<size_t>(1, r.glyphs.size()));
+            const int level = static_cast<int>(std::find(m_widths.begin(), m_widths.end(), r.width) - m_widths.begin());
+            auto same = std::find_if(m_mapped.begin(), m_mapped.end(), [&](const Mapped &m) {
+                return m.level == level && m.levels == levels && m.dither == r.dither;
+            });
+            if (same == m_mapped.end()) {
+                Mapped m;
+                m.level = level;
+                m.levels = levels;
+                m.dither = r.dither;
+                if (stabilize)
+                    m.stabilizer = std::make_unique<TemporalStabilizer>(stabilizer);
+                m_mapped.push_back(std::move(m));
+                same = m_mapped.end() - 1;
+            }
+            m_owner.push_back(static_cast<size_t>(same - m_mapped.begin()));
+        }
+    }
+
+    // Один исходный BGR-кадр во все варианты. false - хотя бы один приёмник сообщил об ошибке
+    bool process(const cv::Mat &bgr, double ptsMs) {
+        if (bgr.empty())
+            return true;
+        for (size_t i = 0; i < m_widths.size(); ++i) {
+            const cv::Size size(m_widths[i], asciiRowsFor(bgr.cols, bgr.rows, m_widths[i]));
+            const cv::Mat &from = i == 0 ? bgr : m_levels[i - 1];
+            // Уменьшение - усреднение по площади; увеличение (ширина больше источника) - билинейное
+            const bool shrink = size.width <= from.cols && size.height <= from.rows;
+            cv::resize(from, m_levels[i], size, 0, 0, shrink ? cv::INTER_AREA : cv::INTER_LINEAR);
+        }
+        for (Mapped &m : m_mapped) {
+            const cv::Mat &level = m_levels[m.level];
+            level.copyTo(m.frame.colors);
+            m.frame.cols = level.cols;
+            m.frame.rows = level.rows;
+            mapGlyphs(m.frame.colors, m.levels, m.dither, m.frame.glyphs);
+            if (m.stabilizer)
+                m.stabilizer->apply(m.frame, m.levels);
+        }
+        bool ok = true;
+        for (size_t i = 0; i < m_renditions.size(); ++i) {
+            if (m_renditions[i].sink && !m_renditions[i].sink(m_mapped[m_owner[i]].frame, ptsMs))
+                ok = false;
+        }
+        return ok;
+    }
+
+    const std::vector<Rendition> &renditions() const { return m_renditions; }
+    // Сколько кадров на самом деле строится и сколько раз уменьшается исходник
+    size_t distinctFrames() const { return m_mapped.size(); }
+    size_t pyramidLevels() const { return m_widths.size(); }
+
+    // Кадр варианта после последнего process (например, для хеша в замерах)
+    const AsciiFrame &frameFor(size_t rendition) const { return m_mapped[m_owner[rendition]].frame; }
+
+private:
+    struct Mapped {
+        int level = 0;
+        int levels = 1;
+        DitherMode dither = DitherMode::None;
+        AsciiFrame frame;
+        std::unique_ptr<TemporalStabilizer> stabilizer;
+    };
+
+    std::vector<Rendition> m_renditions;
+    std::vector<int> m_widths;        // ширины пирамиды по убыванию
+    std::vector<cv::Mat> m_levels;    // уровни пирамиды, BGR, одна ячейка на пиксель
+    std::vector<Mapped> m_mapped;
+    std::vector<size_t> m_owner;      // вариант -> индекс в m_mapped
+};
+
+#endif // RENDITION_LADDER_H
@@ -0,0 +1,366 @@
+// segment_preprocess.h
+// Предобработка длинного видео несколькими декодерами. Источник делится на N отрезков
+// по номерам кадров, у каждого отрезка свой VideoCapture и свой поток конвертации.
+// Бэкенд FFmpeg при переходе к кадру начинает декодирование с предшествующего ключевого
+// кадра, поэтому лишняя работа отрезка - не больше одной группы кадров. Фактическое
+// начало отрезка берётся у декодера после перехода, конец отрезка - начало следующего,
+// так что кадры сшиваются без пропусков и повторов. Если отрезки не сошлись (неточный
+// переход, меньше кадров, чем обещал контейнер), видео переконвертируется одним декодером
+
+#ifndef SEGMENT_PREPROCESS_H
+#define SEGMENT_PREPROCESS_H
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ascii_core.h"
+#include "work_scheduler.h"
+
+struct SegmentPreprocessOptions {
+    int width = 100;
+    int levels = 10;
+    DitherMode dither = DitherMode::None;
+    int segments = 0;              // число декодеров (0 - по числу ядер, 1 - последовательно)
+    int minSegmentFrames = 240;    // отрезки короче не выделяются: переход и запуск декодера дороже
+    bool stabilize = false;        // временная стабилизация (своя в каждом отрезке)
+    StabilizerOptions stabilizer;
+    int previewWidth = 0;          // ширина превью первого кадра (0 - без превью)
+    WorkScheduler *scheduler = nullptr;  // общий планировщик (nullptr - свой поток на отрезок)
+    TaskPriority priority = TaskPriority::Bulk;
+};
+
+struct SegmentPreprocessResult {
+    bool opened = false;
+    double fps = 0.0;
+    size_t frames = 0;              // число кадров без пропусков (при отмене - готовое начало)
+    std::vector<double> ptsMs;      // метки времени кадров по данным контейнера
+    int segments = 0;               // сколько декодеров работало
+    bool sequentialFallback = false;
+    bool cancelled = false;
+    double changedRatio = 0.0;      // средние доли изменившихся ячеек при стабилизации
+    double rawChangedRatio = 0.0;
+};
+
+class SegmentedPreprocessor {
+public:
+    // Кадр с номером index; вызывается из потоков отрезков, в произвольном порядке.
+    // После отката на один декодер кадры приходят заново и заменяют прежние
+    using FrameSink = std::function<void(size_t index, AsciiFrame &&frame)>;
+    // Сколько кадров готово из ориентировочного общего числа (0, если неизвестно);
+    // вызывается в потоке run()
+    using ProgressFn = std::function<void(size_t done, size_t total)>;
+    using CancelledFn = std::function<bool()>;
+    // Узкое превью первого кадра: вызывается в потоке run() сразу после открытия файла,
+    // до перехода декодеров к своим отрезкам. Тот же кадр затем конвертируется в полную ширину
+    using PreviewFn = std::function<void(AsciiFrame &&frame)>;
+
+    SegmentedPreprocessor(std::string path, SegmentPreprocessOptions opts)
+        : m_path(std::move(path)), m_opts(opts) {}
+
+    void setPreviewSink(PreviewFn preview) { m_preview = std::move(preview); }
+
+    // Сколько первых кадров уже готово подряд (для показа во время предобработки);
+    // обновляется перед каждым вызовом ProgressFn. После отката на один декодер
+    // отсчёт начинается заново, но прежние кадры в приёмнике остаются верными
+    size_t readyFrames() const { return m_ready.load(); }
+
+    SegmentPreprocessResult run(const FrameSink &sink, const ProgressFn &progress = ProgressFn(),
+                                const CancelledFn &cancelled = CancelledFn()) {
+        SegmentPreprocessResult result;
+        m_stop = false;
+        m_done = 0;
+        m_ready = 0;
+
+        auto probe = std::make_unique<Segment>();
+        if (!probe->cap.open(m_path))
+            return result;
+        result.opened = true;
+        result.fps = probe->cap.get(cv::CAP_PROP_FPS);
+        if (result.fps <= 0) result.fps = 24.0;
+        m_total = static_cast<size_t>(std::max(0.0, probe->cap.get(cv::CAP_PROP_FRAME_COUNT)));
+        if (m_preview && m_opts.previewWidth > 0 && probe->cap.read(probe->first) && !probe->first.empty()) {
+            // Первый кадр читается один раз: узкая копия для превью, полная - в начало отрезка 0
+            probe->firstPts = probe->cap.get(cv::CAP_PROP_POS_MSEC);
+            AsciiFrame preview;
+            convertFrame(probe->first, std::min(m_opts.previewWidth, m_opts.width), m_opts.levels, m_opts.dither,
+                         preview);
+            m_preview(std::move(preview));
+        }
+
+        std::vector<std::unique_ptr<Segment>> segments;
+        segments.push_back(std::move(probe));
+        const int count = segmentCount();
+        if (count > 1) {
+            // Открытие и переход к началу отрезков тоже идут параллельно: переход
+            // декодирует кадры от ближайшего ключевого
+            for (int k = 1; k < count; ++k) {
+                auto seg = std::make_unique<Segment>();
+                seg->start = m_total * k / count;
+                segments.push_back(std::move(seg));
+            }
+            if (m_opts.scheduler) {
+                TaskGroup openers(*m_opts.scheduler);
+                for (int k = 1; k < count; ++k)
+                    openers.post([this, seg = segments[k].get()]() { seekSegment(*seg); }, m_opts.priority);
+                openers.wait();
+            } else {
+                std::vector<std::thread> openers;
+                for (int k = 1; k < count; ++k)
+                    openers.emplace_back([this, seg = segments[k].get()]() { seekSegment(*seg); });
+                for (std::thread &t : openers)
+                    t.join();
+            }
+            // Отрезки, которые не открылись или начались не после предыдущего, отбрасываются:
+            // их кадры достанутся предыдущему отрезку
+            std::vector<std::unique_ptr<Segment>> valid;
+            for (auto &seg : segments) {
+                if (seg->valid && (valid.empty() || seg->start > valid.back()->start))
+                    valid.push_back(std::move(seg));
+            }
+            segments.swap(valid);
+        }
+        for (size_t k = 0; k < segments.size(); ++k)
+            segments[k]->end = k + 1 < segments.size() ? segments[k + 1]->start : kOpenEnd;
+
+        result.segments = static_cast<int>(segments.size());
+        decodeAll(segments, sink, progress, cancelled);
+
+        if (!m_stop && segments.size() > 1 && !stitched(segments, result.fps)) {
+            // Отрезки не сошлись - один декодер с начала, кадры перезаписываются
+            segments.clear();
+            auto seg = std::make_unique<Segment>();
+            seg->valid = seg->cap.open(m_path);
+            seg->end = kOpenEnd;
+            segments.push_back(std::move(seg));
+            m_done = 0;
+            m_ready = 0;
+            result.sequentialFallback = true;
+            result.segments = 1;
+            if (segments[0]->valid)
+                decodeAll(segments, sink, progress, cancelled);
+        }
+
+        // Сшивка: при отмене остаётся только непрерывное начало
+        result.cancelled = m_stop;
+        double changedSum = 0.0, rawSum = 0.0;
+        uint64_t stabilized = 0;
+        for (const auto &seg : segments) {
+            result.ptsMs.insert(result.ptsMs.end(), seg->pts.begin(), seg->pts.end());
+            changedSum += seg->stabilizer.averageChangedRatio() * seg->stabilizer.frames();
+            rawSum += seg->stabilizer.averageRawChangedRatio() * seg->stabilizer.frames();
+            stabilized += seg->stabilizer.frames();
+            if (seg->end != kOpenEnd && seg->pts.size() != seg->end - seg->start)
+                break;
+        }
+        result.frames = result.ptsMs.size();
+        if (stabilized > 0) {
+            result.changedRatio = changedSum / stabilized;
+            result.rawChangedRatio = rawSum / stabilized;
+        }
+        m_ready = result.frames;
+        if (progress)
+            progress(result.frames, std::max(m_total, result.frames));
+        return result;
+    }
+
+private:
+    static constexpr size_t kOpenEnd = std::numeric_limits<size_t>::max();
+
+    struct Segment {
+        cv::VideoCapture cap;
+        size_t start = 0;           // номер первого кадра
+        size_t end = kOpenEnd;      // номер кадра после последнего (kOpenEnd - до конца файла)
+        bool valid = true;
+        std::vector<double> pts;
+        std::atomic<size_t> produced{0};  // кадров отдано приёмнику
+        cv::Mat first;              // уже прочитанный первый кадр (после превью)
+        double firstPts = 0.0;
+        TemporalStabilizer stabilizer;
+        size_t next = 0;            // номер следующего кадра при декодировании кусками
+        cv::Mat image;
+    };
+
+    // Кадров отрезка на одно задание планировщика: между кусками успевают задания
+    // с более высоким приоритетом и куски других предобработок
+    static constexpr size_t kChunkFrames = 16;
+
+    int segmentCount() const {
+        int count = m_opts.segments > 0 ? m_opts.segments
+                                        : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        count = std::min(count, 16);
+        if (m_total == 0)
+            return 1;
+        const size_t bySize = m_total / static_cast<size_t>(std::max(1, m_opts.minSegmentFrames));
+        return static_cast<int>(std::max<size_t>(1, std::min<size_t>(count, bySize)));
+    }
+
+    // Открытие декодера отрезка и переход к его первому кадру. Если декодер встал раньше
+    // нужного кадра, недостающие кадры пропускаются; если позже - отрезок начинается там
+    void seekSegment(Segment &seg) {
+        seg.valid = seg.cap.open(m_path) && seg.cap.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(seg.start));
+        if (!seg.valid)
+            return;
+        const double pos = seg.cap.get(cv::CAP_PROP_POS_FRAMES);
+        if (pos < 0) {
+            seg.valid = false;
+            return;
+        }
+        size_t at = static_cast<size_t>(pos + 0.5);
+        while (at < seg.start && seg.cap.grab())
+            ++at;
+        seg.valid = at >= seg.start && at < m_total;
+        seg.start = at;
+    }
+
+    // Декодирование и конвертация отрезков: кусками на общем планировщике или каждый
+    // в своём потоке; поток run() сообщает общий прогресс и передаёт отмену
+    void decodeAll(const std::vector<std::unique_ptr<Segment>> &segments, const FrameSink &sink,
+                   const ProgressFn &progress, const CancelledFn &cancelled) {
+        for (const auto &seg : segments)
+            beginSegment(*seg);
+        if (m_opts.scheduler) {
+            TaskGroup group(*m_opts.scheduler);
+            for (const auto &seg : segments)
+                scheduleChunk(group, seg.get(), sink);
+            for (;;) {
+                const bool finished = group.waitFor(std::chrono::milliseconds(100));
+                if (cancelled && cancelled())
+                    m_stop = true;
+                if (progress) {
+                    m_ready = readyPrefix(segments);
+                    progress(m_done.load(), m_total);
+                }
+                if (finished)
+                    return;
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t running = segments.size();
+        std::vector<std::thread> workers;
+        for (const auto &segPtr : segments) {
+            Segment *seg = segPtr.get();
+            workers.emplace_back([&, seg]() {
+                decodeChunk(*seg, sink, kOpenEnd);
+                std::lock_guard<std::mutex> lock(mutex);
+                --running;
+                finished.notify_one();
+            });
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (running > 0) {
+                finished.wait_for(lock, std::chrono::milliseconds(100));
+                if (cancelled && cancelled())
+                    m_stop = true;
+                if (progress) {
+                    m_ready = readyPrefix(segments);
+                    lock.unlock();
+                    progress(m_done.load(), m_total);
+                    lock.lock();
+                }
+            }
+        }
+        for (std::thread &t : workers)
+            t.join();
+    }
+
+    // Следующий кусок отрезка - в конец общей очереди, после уже ждущих заданий
+    void scheduleChunk(TaskGroup &group, Segment *seg, const FrameSink &sink) {
+        group.post([this, &group, seg, &sink]() {
+            if (!decodeChunk(*seg, sink, kChunkFrames))
+                scheduleChunk(group, seg, sink);
+        }, m_opts.priority);
+    }
+
+    void beginSegment(Segment &seg) {
+        seg.pts.clear();
+        seg.produced = 0;
+        seg.stabilizer = TemporalStabilizer(m_opts.stabilizer);
+        seg.next = seg.start;
+    }
+
+    // До maxFrames кадров отрезка с seg.next; true - отрезок закончен (или отменён)
+    bool decodeChunk(Segment &seg, const FrameSink &sink, size_t maxFrames) {
+        for (size_t n = 0; n < maxFrames; ++n) {
+            if (seg.next >= seg.end || m_stop)
+                break;
+            if (!seg.first.empty()) {
+                seg.image = seg.first;
+                seg.first.release();
+                seg.pts.push_back(seg.firstPts);
+            } else if (!seg.cap.read(seg.image) || seg.image.empty()) {
+                break;
+            } else {
+                seg.pts.push_back(seg.cap.get(cv::CAP_PROP_POS_MSEC));
+            }
+            AsciiFrame frame;
+            convertFrame(seg.image, m_opts.width, m_opts.levels, m_opts.dither, frame);
+            if (m_opts.stabilize)
+                seg.stabilizer.apply(frame, m_opts.levels);
+            sink(seg.next, std::move(frame));
+            ++seg.next;
+            ++seg.produced;
+            ++m_done;
+            if (n + 1 == maxFrames)
+                return false;
+        }
+        seg.cap.release();
+        seg.image.release();
+        return true;
+    }
+
+    // Число кадров с начала видео, готовых без пропусков: отрезки идут подряд, и следующий
+    // учитывается, только если предыдущий уже дошёл до его начала
+    static size_t readyPrefix(const std::vector<std::unique_ptr<Segment>> &segments) {
+        size_t ready = 0;
+        for (const auto &seg : segments) {
+            const size_t produced = seg->produced.load();
+            ready += produced;
+            if (seg->end == kOpenEnd || produced != seg->end - seg->start)
+                break;
+        }
+        return ready;
+    }
+
+    // Каждый отрезок, кроме последнего, дошёл ровно до начала следующего, и метки
+    // времени на стыках возрастают не больше чем на полтора кадра: неточный переход,
+    // который сообщил верный номер, но встал дальше, иначе потерял бы кадры на стыке
+    static bool stitched(const std::vector<std::unique_ptr<Segment>> &segments, double fps) {
+        const double maxGapMs = 1.5 * 1000.0 / fps;
+        for (size_t k = 0; k + 1 < segments.size(); ++k) {
+            const Segment &cur = *segments[k];
+            const Segment &next = *segments[k + 1];
+            if (cur.pts.size() != cur.end - cur.start || cur.pts.empty())
+                return false;
+            if (!next.pts.empty() &&
+                (next.pts.front() <= cur.pts.back() || next.pts.front() - cur.pts.back() > maxGapMs))
+                return false;
+        }
+        return true;
+    }
+
+    std::string m_path;
+    SegmentPreprocessOptions m_opts;
+    size_t m_total = 0;
+    std::atomic<bool> m_stop{false};
+    std::atomic<size_t> m_done{0};
+    std::atomic<size_t> m_ready{0};
+    PreviewFn m_preview;
+};
+
+#endif // SEGMENT_PREPROCESS_H
@@ -0,0 +1,264 @@
+// term_stream.h
+// TCP-сервер трансляции в терминалы (в духе telnet/netcat: `nc localhost 9000`).
+// Клиент может прислать строку "<ширина> [truecolor|256|mono]", по умолчанию
+// используются параметры сервера. Конвертация и дельта-кодирование выполняются
+// один раз на кадр для каждой используемой пары (ширина, цвет), клиенты получают
+// общие буферы. Клиент с переполненной очередью теряет её и получает следующий
+// полный кадр, поэтому стоимость CPU зависит от числа разных конфигураций, а не клиентов
+
+#ifndef TERM_STREAM_H
+#define TERM_STREAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+#include "ansi_export.h"
+#include "net_server.h"
+
+// Ключ общей отрисовки: ширина в символах и глубина цвета
+struct TerminalRenderKey {
+    int width = 80;
+    ColorDepth depth = ColorDepth::TrueColor;
+
+    bool operator<(const TerminalRenderKey &o) const {
+        return width != o.width ? width < o.width : static_cast<int>(depth) < static_cast<int>(o.depth);
+    }
+    bool operator==(const TerminalRenderKey &o) const { return width == o.width && depth == o.depth; }
+};
+
+class TerminalStreamServer : public NetServer {
+public:
+    struct Options {
+        std::vector<std::string> glyphs;
+        DitherMode dither = DitherMode::None;
+        TerminalRenderKey defaults;
+        int maxWidth = 400;
+        size_t maxQueuedBytes = 256 * 1024;
+        bool stabilize = false;          // временная стабилизация перед дельта-кодированием
+        StabilizerOptions stabilizer;
+    };
+
+    explicit TerminalStreamServer(Options opts) : m_opts(std::move(opts)) {}
+
+    // Цикл останавливается до разрушения членов: он вызывает переопределённые обработчики
+    ~TerminalStreamServer() override { stop(); }
+
+    // Публикация исходного BGR-кадра (из потока источника)
+    void publish(const cv::Mat &bgr) {
+        std::map<TerminalRenderKey, bool> keys;  // ключ -> нужен полный кадр
+        {
+            std::lock_guard<std::mutex> lock(m_keysMutex);
+            for (auto &entry : m_keys) {
+                keys[entry.first] = entry.second.needFull;
+                entry.second.needFull = false;
+            }
+        }
+        // Состояние кодировщиков неиспользуемых конфигураций больше не нужно
+        for (auto it = m_renderState.begin(); it != m_renderState.end();) {
+            if (keys.count(it->first))
+                ++it;
+            else
+                it = m_renderState.erase(it);
+        }
+
+        auto rendered = std::make_shared<std::vector<Rendered>>();
+        for (const auto &entry : keys) {
+            const TerminalRenderKey &key = entry.first;
+            RenderState &state = m_renderState[key];
+            if (!state.encoder) {
+                state.encoder = std::make_unique<AnsiDeltaEncoder>(m_opts.glyphs, key.depth, m_opts.dither);
+                state.stabilizer = TemporalStabilizer(m_opts.stabilizer);
+            }
+            AsciiFrame &frame = state.frame;
+            convertFrame(bgr, key.width, static_cast<int>(m_opts.glyphs.size()), m_opts.dither, frame);
+            if (m_opts.stabilize)
+                state.stabilizer.apply(frame, static_cast<int>(m_opts.glyphs.size()));
+            std::string delta, full;
+            bool deltaIsFull = state.encoder->encode(frame, &delta, entry.second ? &full : nullptr);
+            Rendered r;
+            r.key = key;
+            r.delta = makeSharedBuffer(std::move(delta));
+            if (deltaIsFull)
+                r.full = r.delta;
+            else if (entry.second)
+                r.full = makeSharedBuffer(std::move(full));
+            rendered->push_back(std::move(r));
+            ++m_renders;
+        }
+        ++m_published;
+        post([this, rendered]() { distribute(*rendered); });
+    }
+
+    std::string statusLine() const {
+        Counters c = counters();
+        size_t configs;
+        {
+            std::lock_guard<std::mutex> lock(m_keysMutex);
+            configs = m_keys.size();
+        }
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "клиентов: %zu | конфигураций: %zu | кадров: %llu | отрисовок: %llu | отправлено: %.1f МБ | сброшено из очередей: %llu",
+                      clientCount(), configs, static_cast<unsigned long long>(m_published.load()),
+                      static_cast<unsigned long long>(m_renders.load()), c.bytesSent / (1024.0 * 1024.0),
+                      static_cast<unsigned long long>(c.framesDropped));
+        return line;
+    }
+
+protected:
+    struct TerminalConnection : Connection {
+        TerminalRenderKey key;
+        bool attached = false;
+        bool synced = false;   // получил все кадры своей конфигурации с последнего полного
+    };
+
+    struct Rendered {
+        TerminalRenderKey key;
+        SharedBuffer delta;
+        SharedBuffer full;     // пусто, если полный кадр никому не нужен
+    };
+
+    std::unique_ptr<Connection> createConnection() override {
+        auto c = std::make_unique<TerminalConnection>();
+        c->key = m_opts.defaults;
+        return c;
+    }
+
+    void onData(Connection &c) override {
+        TerminalConnection &t = static_cast<TerminalConnection &>(c);
+        if (!t.attached) {
+            send(t, makeSharedBuffer("ASCII-трансляция: отправьте \"<ширина> [truecolor|256|mono]\" и Enter для смены вида, q - выход\r\n"));
+            attach(t, t.key);
+        }
+        size_t eol;
+        while ((eol = t.inbox.find('\n')) != std::string::npos) {
+            std::string line = t.inbox.substr(0, eol);
+            t.inbox.erase(0, eol + 1);
+            handleCommand(t, line);
+        }
+    }
+
+    void onClosed(Connection &c) override {
+        TerminalConnection &t = static_cast<TerminalConnection &>(c);
+        if (t.attached)
+            detach(t.key);
+    }
+
+    // Клиенты nc ничего не присылают при подключении - подключаем их по первому кадру
+    void onIdle() override {
+        forEachConnection([this](Connection &c) {
+            TerminalConnection &t = static_cast<TerminalConnection &>(c);
+            if (!t.attached)
+                onData(t);
+        });
+    }
+
+private:
+    void handleCommand(TerminalConnection &t, const std::string &line) {
+        std::string clean;
+        for (char ch : line) {
+            // Отбрасываем управляющие байты telnet и прочий мусор
+            if (std::isalnum(static_cast<unsigned char>(ch)) || ch == ' ')
+                clean += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+        }
+        if (clean == "q" || clean == "quit") {
+            send(t, makeSharedBuffer("\033[0m\033[?25h\r\n"));
+            t.closeAfterFlush = true;
+            return;
+        }
+        TerminalRenderKey key = t.key;
+        std::istringstream words(clean);
+        std::string word;
+        while (words >> word) {
+            if (std::isdigit(static_cast<unsigned char>(word[0])))
+                key.width = std::clamp(std::atoi(word.c_str()), 10, m_opts.maxWidth);
+            else if (word == "256")
+                key.depth = ColorDepth::Ansi256;
+            else if (word == "truecolor" || word == "24bit")
+                key.depth = ColorDepth::TrueColor;
+            else if (word == "mono")
+                key.depth = ColorDepth::Mono;
+        }
+        if (!(key == t.key)) {
+            detach(t.key);
+            attach(t, key);
+        }
+    }
+
+    void attach(TerminalConnection &t, const TerminalRenderKey &key) {
+        t.key = key;
+        t.attached = true;
+        t.synced = false;
+        std::lock_guard<std::mutex> lock(m_keysMutex);
+        KeyUsage &usage = m_keys[key];
+        ++usage.clients;
+        usage.needFull = true;
+    }
+
+    void detach(const TerminalRenderKey &key) {
+        std::lock_guard<std::mutex> lock(m_keysMutex);
+        auto it = m_keys.find(key);
+        if (it != m_keys.end() && --it->second.clients <= 0)
+            m_keys.erase(it);
+    }
+
+    void requestFull(const TerminalRenderKey &key) {
+        std::lock_guard<std::mutex> lock(m_keysMutex);
+        auto it = m_keys.find(key);
+        if (it != m_keys.end())
+            it->second.needFull = true;
+    }
+
+    void distribute(const std::vector<Rendered> &rendered) {
+        forEachConnection([&](Connection &c) {
+            TerminalConnection &t = static_cast<TerminalConnection &>(c);
+            if (!t.attached)
+                return;
+            auto it = std::find_if(rendered.begin(), rendered.end(), [&](const Rendered &r) { return r.key == t.key; });
+            if (it == rendered.end())
+                return;
+            if (t.synced && t.queuedBytes > m_opts.maxQueuedBytes) {
+                dropQueued(t);
+                t.synced = false;
+            }
+            if (t.synced) {
+                send(t, it->delta);
+            } else if (it->full && t.queuedBytes <= m_opts.maxQueuedBytes) {
+                send(t, it->full);
+                t.synced = true;
+            } else {
+                requestFull(t.key);
+            }
+        });
+    }
+
+    struct KeyUsage {
+        int clients = 0;
+        bool needFull = false;
+    };
+
+    // Состояние отрисовки одной конфигурации между кадрами
+    struct RenderState {
+        std::unique_ptr<AnsiDeltaEncoder> encoder;
+        TemporalStabilizer stabilizer;
+        AsciiFrame frame;   // сетка последнего кадра, её память переиспользуется
+    };
+
+    Options m_opts;
+    mutable std::mutex m_keysMutex;
+    std::map<TerminalRenderKey, KeyUsage> m_keys;            // по клиентам (поток цикла)
+    std::map<TerminalRenderKey, RenderState> m_renderState;  // поток источника
+    std::atomic<uint64_t> m_published{0};
+    std::atomic<uint64_t> m_renders{0};
+};
+
+#endif // TERM_STREAM_H
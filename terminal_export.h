@@ -0,0 +1,164 @@
+// terminal_export.h
+// Экспорт анимации для терминала без растеризации: поток ANSI-кадров (.ans, проигрывается
+// через cat) и запись asciinema v2 (.cast, с метками времени). Кадры дельта-кодируются
+// AnsiDeltaEncoder и пишутся в файл сразу, поэтому память не зависит от длины ролика
+
+#ifndef TERMINAL_EXPORT_H
+#define TERMINAL_EXPORT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ascii_core.h"
+#include "ansi_export.h"
+
+enum class TerminalExportFormat {
+    Ansi,       // сырой поток ANSI-последовательностей
+    Asciinema   // asciinema v2: строка заголовка JSON и события [время, "o", данные]
+};
+
+// Формат по расширению файла: .cast - asciinema, остальное - ANSI
+inline TerminalExportFormat terminalExportFormatForPath(const std::string &path) {
+    const size_t dot = path.find_last_of('.');
+    std::string ext = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+    for (char &c : ext)
+        c = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    return ext == "cast" ? TerminalExportFormat::Asciinema : TerminalExportFormat::Ansi;
+}
+
+namespace terminal_export_detail {
+
+// Строка JSON в кавычках; UTF-8 символов набора переносится как есть
+inline void appendJsonString(std::string &out, const std::string &text) {
+    out += '"';
+    for (unsigned char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char esc[8];
+                std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                out += esc;
+            } else {
+                out += static_cast<char>(c);
+            }
+        }
+    }
+    out += '"';
+}
+
+} // namespace terminal_export_detail
+
+class TerminalExportWriter {
+public:
+    struct Options {
+        std::vector<std::string> glyphs;
+        ColorDepth depth = ColorDepth::TrueColor;
+        DitherMode dither = DitherMode::None;
+        TerminalExportFormat format = TerminalExportFormat::Ansi;
+        std::string title;          // заголовок записи asciinema (пусто - без заголовка)
+    };
+
+    explicit TerminalExportWriter(Options opts)
+        : m_opts(std::move(opts)), m_encoder(m_opts.glyphs, m_opts.depth, m_opts.dither) {}
+
+    bool open(const std::string &path) {
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        return static_cast<bool>(m_file);
+    }
+
+    // Кадр с моментом показа timeSec от начала записи. Кадр без изменений ничего не пишет
+    bool addFrame(const AsciiFrame &frame, double timeSec) {
+        if (m_opts.format == TerminalExportFormat::Asciinema) {
+            if (!m_headerWritten)
+                writeHeader(frame.cols, frame.rows);
+            else if (frame.cols != m_cols || frame.rows != m_rows)
+                writeEvent(timeSec, "r", std::to_string(frame.cols) + "x" + std::to_string(frame.rows + 1));
+        }
+        m_cols = frame.cols;
+        m_rows = frame.rows;
+        m_encoder.encode(frame, &m_delta);
+        ++m_frames;
+        if (!m_delta.empty())
+            writeOutput(timeSec, m_delta);
+        m_lastTime = timeSec;
+        return static_cast<bool>(m_file);
+    }
+
+    // Завершение: курсор под кадром и снова видим. endSec - конец последнего кадра
+    bool close(double endSec) {
+        if (!m_file.is_open())
+            return false;
+        if (m_opts.format == TerminalExportFormat::Asciinema && !m_headerWritten)
+            writeHeader(80, 23);
+        std::string tail = "\033[0m\033[";
+        tail += std::to_string(m_rows + 1);
+        tail += ";1H\033[?25h";
+        writeOutput(std::max(endSec, m_lastTime), tail);
+        m_file.close();
+        return !m_file.fail();
+    }
+
+    uint64_t bytesWritten() const { return m_bytes; }
+    size_t framesWritten() const { return m_frames; }
+
+private:
+    // Высота на строку больше кадра: после записи курсор стоит под ним
+    void writeHeader(int cols, int rows) {
+        std::string line = "{\"version\": 2, \"width\": " + std::to_string(cols) +
+                           ", \"height\": " + std::to_string(rows + 1) +
+                           ", \"timestamp\": " + std::to_string(static_cast<long long>(std::time(nullptr)));
+        if (!m_opts.title.empty()) {
+            line += ", \"title\": ";
+            terminal_export_detail::appendJsonString(line, m_opts.title);
+        }
+        line += ", \"env\": {\"TERM\": \"xterm-256color\"}}\n";
+        write(line);
+        m_headerWritten = true;
+    }
+
+    void writeOutput(double timeSec, const std::string &data) {
+        if (m_opts.format == TerminalExportFormat::Asciinema)
+            writeEvent(timeSec, "o", data);
+        else
+            write(data);
+    }
+
+    void writeEvent(double timeSec, const char *type, const std::string &data) {
+        char stamp[48];
+        std::snprintf(stamp, sizeof(stamp), "[%.6f, \"%s\", ", std::max(0.0, timeSec), type);
+        m_line = stamp;
+        terminal_export_detail::appendJsonString(m_line, data);
+        m_line += "]\n";
+        write(m_line);
+    }
+
+    void write(const std::string &data) {
+        m_file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        m_bytes += data.size();
+    }
+
+    Options m_opts;
+    AnsiDeltaEncoder m_encoder;
+    std::ofstream m_file;
+    std::string m_delta;
+    std::string m_line;
+    bool m_headerWritten = false;
+    int m_cols = 0;
+    int m_rows = 0;
+    double m_lastTime = 0.0;
+    uint64_t m_bytes = 0;
+    size_t m_frames = 0;
+};
+
+#endif // TERMINAL_EXPORT_H
@@ -0,0 +1,785 @@
+// watch_daemon.h
+// Демон каталогов для консольной утилиты: следит за каталогами (inotify на Linux, иначе
+// периодический обход), ставит новые и изменённые изображения и видео в очередь и
+// конвертирует их пулом рабочих потоков. Очередь упорядочена по приоритету: изображения
+// раньше видео, меньшие файлы раньше больших. Одинаковое содержимое конвертируется
+// один раз - файлы сравниваются по хешу, результаты для копий связываются жёсткими
+// ссылками. Выходные файлы пишутся во временные и переименовываются, поэтому читатель
+// каталога результатов никогда не видит недописанный файл. Число потоков ограничено
+// пулом, память - суммой оценок выполняемых заданий; очередь хранит только пути, так
+// что всплеск из тысяч файлов не расходует ни ядер, ни памяти сверх лимитов. Один путь
+// не конвертируется двумя потоками сразу: изменение во время задания ставит файл
+// в очередь заново только после его завершения
+
+#ifndef WATCH_DAEMON_H
+#define WATCH_DAEMON_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "ascii_core.h"
+#include "ansi_export.h"
+#include "html_export.h"
+#include "html_player.h"
+#include "image_loader.h"
+#include "terminal_export.h"
+
+struct WatchDaemonOptions {
+    std::vector<std::string> dirs;        // наблюдаемые каталоги (без вложенных)
+    std::string outputDir = "ascii_out";  // куда писать результаты <имя файла>.<формат>; при нескольких
+                                          // каталогах - в подкаталог с именем наблюдаемого
+    std::vector<std::string> formats = {"ans", "html"};  // txt (только изображения), ans, cast, html
+    int width = 80;
+    std::vector<std::string> glyphs;
+    DitherMode dither = DitherMode::None;
+    ColorDepth depth = ColorDepth::TrueColor;
+    int workers = 0;                      // 0 - по числу ядер
+    uint64_t memoryBudget = 1ull << 30;   // сумма оценок памяти выполняемых заданий
+    size_t maxQueued = 100000;            // сверх этого события откладываются до обхода
+    std::string statsPath;                // журнал JSON-строк: задания и сводки (пусто - не писать)
+    int statsIntervalMs = 1000;
+    int rescanIntervalMs = 2000;          // период обхода без inotify
+};
+
+namespace watch_detail {
+
+using Clock = std::chrono::steady_clock;
+
+inline std::string lowerExtension(const std::string &name) {
+    const size_t dot = name.find_last_of('.');
+    std::string ext = dot == std::string::npos ? std::string() : name.substr(dot + 1);
+    for (char &c : ext)
+        c = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    return ext;
+}
+
+// 0 - не медиафайл, 1 - изображение, 2 - видео или GIF
+inline int mediaKind(const std::string &name) {
+    static const char *images[] = {"jpg", "jpeg", "png", "bmp", "tiff"};
+    static const char *videos[] = {"gif", "mp4", "avi", "mov", "mkv", "wmv"};
+    const std::string ext = lowerExtension(name);
+    for (const char *e : images)
+        if (ext == e)
+            return 1;
+    for (const char *e : videos)
+        if (ext == e)
+            return 2;
+    return 0;
+}
+
+inline std::string fileName(const std::string &path) {
+    const size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// FNV-1a 64 содержимого; 0 - файл не прочитан
+inline uint64_t contentHash(const std::string &path) {
+    MappedFile file(path);
+    if (!file.isOpen())
+        return 0;
+    uint64_t h = 1469598103934665603ull;
+    const uint8_t *p = file.data();
+    for (size_t i = 0; i < file.size(); ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h ? h : 1;
+}
+
+// Выходной файл: пишется во временный рядом и переименовывается при commit.
+// Без commit временный файл удаляется
+class AtomicOutput {
+public:
+    explicit AtomicOutput(const std::string &path) : m_path(path) {
+        static std::atomic<uint64_t> counter{0};
+        const size_t slash = path.find_last_of('/');
+        const std::string dir = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+        m_temp = dir + "." + fileName(path) + "." + std::to_string(::getpid()) + "." +
+                 std::to_string(counter.fetch_add(1)) + ".tmp";
+    }
+    ~AtomicOutput() {
+        if (!m_committed)
+            ::unlink(m_temp.c_str());
+    }
+    AtomicOutput(const AtomicOutput &) = delete;
+    AtomicOutput &operator=(const AtomicOutput &) = delete;
+
+    const std::string &tempPath() const { return m_temp; }
+
+    bool write(const std::string &data) {
+        std::ofstream out(m_temp, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        out.close();
+        return !out.fail();
+    }
+
+    bool commit() {
+        m_committed = ::rename(m_temp.c_str(), m_path.c_str()) == 0;
+        return m_committed;
+    }
+
+    // Готовый файл src под именем path: жёсткая ссылка, при неудаче - копия
+    bool linkFrom(const std::string &src) {
+        ::unlink(m_temp.c_str());
+        if (::link(src.c_str(), m_temp.c_str()) != 0) {
+            std::ifstream in(src, std::ios::binary);
+            std::ofstream out(m_temp, std::ios::binary | std::ios::trunc);
+            out << in.rdbuf();
+            out.close();
+            if (!in || out.fail())
+                return false;
+        }
+        return commit();
+    }
+
+private:
+    std::string m_path;
+    std::string m_temp;
+    bool m_committed = false;
+};
+
+inline double percentile(std::vector<double> values, double p) {
+    if (values.empty())
+        return 0.0;
+    const size_t k = std::min(values.size() - 1, static_cast<size_t>(p * (values.size() - 1) + 0.5));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+} // namespace watch_detail
+
+class WatchDaemon {
+public:
+    struct Stats {
+        size_t queued = 0;
+        size_t running = 0;
+        uint64_t converted = 0;
+        uint64_t deduplicated = 0;   // содержимое уже конвертировано под другим именем
+        uint64_t unchanged = 0;      // событие без изменения содержимого
+        uint64_t failed = 0;
+        uint64_t memoryInUse = 0;
+    };
+
+    explicit WatchDaemon(WatchDaemonOptions opts) : m_opts(std::move(opts)) {
+        if (m_opts.workers <= 0)
+            m_opts.workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        if (m_opts.glyphs.empty())
+            m_opts.glyphs = glyphTableFromUtf8(" .:-=+*#%@");
+    }
+
+    ~WatchDaemon() { stop(); }
+
+    WatchDaemon(const WatchDaemon &) = delete;
+    WatchDaemon &operator=(const WatchDaemon &) = delete;
+
+    // Каталог результатов, наблюдение, рабочие потоки и первый обход. false - ошибка в error
+    bool start(std::string &error) {
+        ::mkdir(m_opts.outputDir.c_str(), 0755);
+        struct stat st;
+        if (::stat(m_opts.outputDir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+            error = "не удалось создать каталог " + m_opts.outputDir;
+            return false;
+        }
+        if (!m_opts.statsPath.empty()) {
+            m_statsFile = std::fopen(m_opts.statsPath.c_str(), "a");
+            if (!m_statsFile) {
+                error = "не удалось открыть " + m_opts.statsPath;
+                return false;
+            }
+        }
+#ifdef __linux__
+        m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+        std::set<std::string> usedSubdirs;
+        for (const std::string &dir : m_opts.dirs) {
+            if (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+                error = "нет каталога " + dir;
+                return false;
+            }
+            // Одноимённые файлы разных каталогов не должны затирать результаты друг друга
+            if (m_opts.dirs.size() > 1) {
+                const std::string sub = outputSubdir(dir, usedSubdirs);
+                const std::string subPath = m_opts.outputDir + "/" + sub;
+                ::mkdir(subPath.c_str(), 0755);
+                if (::stat(subPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+                    error = "не удалось создать каталог " + subPath;
+                    return false;
+                }
+                m_outputSubdirs[dir] = sub;
+            }
+#ifdef __linux__
+            if (m_inotify >= 0) {
+                const int wd = ::inotify_add_watch(m_inotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if (wd >= 0)
+                    m_watches[wd] = dir;
+            }
+#endif
+        }
+
+        // Потоки пула делят ядра между файлами, поэтому разбиение кадра по строкам
+        // внутри задания ограничено оставшейся долей ядер, а собственный пул OpenCV
+        // при нескольких рабочих отключён
+        const int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        const int rowLimit = std::max(1, hardware / m_opts.workers);
+        if (m_opts.workers > 1)
+            cv::setNumThreads(1);
+        m_started = watch_detail::Clock::now();
+        m_lastStats = m_started;
+        for (int i = 0; i < m_opts.workers; ++i) {
+            m_threads.emplace_back([this, rowLimit]() {
+                ascii_detail::rowPartsLimit() = rowLimit;
+                workerLoop();
+            });
+        }
+        rescan();
+        return true;
+    }
+
+    // Одна итерация цикла наблюдения: события, отложенный обход, сводка статистики.
+    // Ждёт события не дольше timeoutMs
+    void poll(int timeoutMs) {
+        bool needRescan = false;
+#ifdef __linux__
+        if (m_inotify >= 0) {
+            struct pollfd pfd = {m_inotify, POLLIN, 0};
+            if (::poll(&pfd, 1, timeoutMs) > 0)
+                needRescan = readEvents();
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        }
+#else
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+#endif
+        const auto now = watch_detail::Clock::now();
+        const bool periodic = m_inotify < 0 && now - m_lastRescan >= std::chrono::milliseconds(m_opts.rescanIntervalMs);
+        bool deferredReady = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            deferredReady = m_deferred && m_queue.size() < m_opts.maxQueued / 2;
+        }
+        if (needRescan || periodic || deferredReady)
+            rescan();
+        if (now - m_lastStats >= std::chrono::milliseconds(m_opts.statsIntervalMs)) {
+            writeStats(now);
+            m_lastStats = now;
+        }
+    }
+
+    // Поставить файл в очередь (или обновить ожидающее задание). false - не медиафайл
+    // или очередь переполнена (файл подберёт следующий обход)
+    bool enqueue(const std::string &path) {
+        const int kind = watch_detail::mediaKind(path);
+        struct stat st;
+        if (!kind || ::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+            return false;
+        const FileState state{static_cast<uint64_t>(st.st_size), static_cast<int64_t>(st.st_mtime)};
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping)
+            return false;
+        if (m_runningPaths.count(path)) {
+            // Файл сейчас конвертируется: повтор встанет в очередь после завершения задания
+            m_rerun.insert(path);
+            m_known[path] = state;
+            return true;
+        }
+        auto pending = m_pending.find(path);
+        if (pending != m_pending.end()) {
+            // Файл ещё дописывается или заменён повторно: новый размер, прежнее место в очереди
+            Job job = *pending->second;
+            m_queue.erase(pending->second);
+            job.size = state.size;
+            job.memory = memoryEstimate(job.still, job.size);
+            pending->second = m_queue.insert(job).first;
+            m_known[path] = state;
+            return true;
+        }
+        if (m_queue.size() >= m_opts.maxQueued) {
+            m_deferred = true;
+            return false;
+        }
+        Job job;
+        job.path = path;
+        job.still = kind == 1;
+        job.size = state.size;
+        job.seq = ++m_seq;
+        job.queued = watch_detail::Clock::now();
+        job.memory = memoryEstimate(job.still, job.size);
+        m_pending[path] = m_queue.insert(job).first;
+        m_known[path] = state;
+        m_wake.notify_one();
+        return true;
+    }
+
+    // Прекратить приём, отменить очередь и дождаться выполняемых заданий
+    // (видео прерывается на ближайшем кадре, его временные файлы удаляются)
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping && m_threads.empty())
+                return;
+            m_stopping = true;
+            m_queue.clear();
+            m_pending.clear();
+            m_rerun.clear();
+        }
+        m_wake.notify_all();
+        m_doneHash.notify_all();
+        for (std::thread &t : m_threads)
+            t.join();
+        m_threads.clear();
+        writeStats(watch_detail::Clock::now());
+#ifdef __linux__
+        if (m_inotify >= 0)
+            ::close(m_inotify);
+        m_inotify = -1;
+#endif
+        if (m_statsFile)
+            std::fclose(m_statsFile);
+        m_statsFile = nullptr;
+    }
+
+    // Очередь пуста и ничего не выполняется
+    bool idle() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.empty() && m_running == 0 && !m_deferred;
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Stats s = m_stats;
+        s.queued = m_queue.size();
+        s.running = m_running;
+        s.memoryInUse = m_memoryInUse;
+        return s;
+    }
+
+private:
+    struct FileState {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        bool operator==(const FileState &o) const { return size == o.size && mtime == o.mtime; }
+    };
+
+    struct Job {
+        std::string path;
+        bool still = true;
+        uint64_t size = 0;
+        uint64_t seq = 0;
+        uint64_t memory = 0;
+        watch_detail::Clock::time_point queued;
+    };
+
+    // Изображения раньше видео, меньшие раньше больших, при равенстве - по порядку поступления
+    struct JobOrder {
+        bool operator()(const Job &a, const Job &b) const {
+            if (a.still != b.still)
+                return a.still;
+            if (a.size != b.size)
+                return a.size < b.size;
+            return a.seq < b.seq;
+        }
+    };
+
+    using Queue = std::set<Job, JobOrder>;
+
+    // Грубая оценка пиковой памяти задания: сжатое изображение раскрывается примерно
+    // вдесятеро (загрузка под ширину обычно меньше), видео - буферы декодера и кадров
+    static uint64_t memoryEstimate(bool still, uint64_t size) {
+        if (still)
+            return std::max<uint64_t>(size * 10, 4ull << 20);
+        return 96ull << 20;
+    }
+
+#ifdef __linux__
+    // true - очередь событий ядра переполнилась, нужен полный обход
+    bool readEvents() {
+        alignas(struct inotify_event) char buffer[16384];
+        bool overflow = false;
+        for (;;) {
+            const ssize_t n = ::read(m_inotify, buffer, sizeof(buffer));
+            if (n <= 0)
+                break;
+            for (char *p = buffer; p < buffer + n;) {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+                p += sizeof(struct inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow = true;
+                    continue;
+                }
+                auto dir = m_watches.find(event->wd);
+                if (dir == m_watches.end() || event->len == 0 || event->name[0] == '.')
+                    continue;
+                enqueue(dir->second + "/" + event->name);
+            }
+        }
+        return overflow;
+    }
+#endif
+
+    // Обход каталогов: в очередь попадают файлы, размер или время изменения которых
+    // отличаются от последних поставленных
+    void rescan() {
+        m_lastRescan = watch_detail::Clock::now();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_deferred = false;
+        }
+        for (const std::string &dir : m_opts.dirs) {
+            DIR *d = ::opendir(dir.c_str());
+            if (!d)
+                continue;
+            while (struct dirent *entry = ::readdir(d)) {
+                if (entry->d_name[0] == '.' || !watch_detail::mediaKind(entry->d_name))
+                    continue;
+                const std::string path = dir + "/" + entry->d_name;
+                struct stat st;
+                if (::stat(path.c_str(), &st) != 0)
+                    continue;
+                const FileState state{static_cast<uint64_t>(st.st_size), static_cast<int64_t>(st.st_mtime)};
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto known = m_known.find(path);
+                    if (known != m_known.end() && known->second == state)
+                        continue;
+                }
+                enqueue(path);
+            }
+            ::closedir(d);
+        }
+    }
+
+    // Следующее задание по приоритету, если его оценка памяти укладывается в бюджет.
+    // Единственное задание запускается при любой оценке, иначе большой файл ждал бы вечно
+    bool takeJob(std::unique_lock<std::mutex> &lock, Job &job) {
+        m_wake.wait(lock, [&]() {
+            if (m_stopping)
+                return true;
+            if (m_queue.empty())
+                return false;
+            return m_running == 0 || m_memoryInUse + m_queue.begin()->memory <= m_opts.memoryBudget;
+        });
+        if (m_stopping)
+            return false;
+        job = *m_queue.begin();
+        m_queue.erase(m_queue.begin());
+        m_pending.erase(job.path);
+        m_runningPaths.insert(job.path);
+        ++m_running;
+        m_memoryInUse += job.memory;
+        return true;
+    }
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        Job job;
+        while (takeJob(lock, job)) {
+            lock.unlock();
+            const auto startedAt = watch_detail::Clock::now();
+            const char *result = runJob(job);
+            const auto doneAt = watch_detail::Clock::now();
+            lock.lock();
+            --m_running;
+            m_memoryInUse -= job.memory;
+            m_runningPaths.erase(job.path);
+            const bool again = m_rerun.erase(job.path) > 0;
+            recordJob(job, result, startedAt, doneAt);
+            m_wake.notify_all();
+            if (again) {
+                // Файл изменился во время задания: теперь его можно ставить заново
+                lock.unlock();
+                enqueue(job.path);
+                lock.lock();
+            }
+        }
+    }
+
+    // Подкаталог результатов для каталога dir: его имя, а если оно уже занято
+    // другим каталогом - с номером
+    static std::string outputSubdir(std::string dir, std::set<std::string> &used) {
+        while (dir.size() > 1 && dir.back() == '/')
+            dir.pop_back();
+        std::string name = watch_detail::fileName(dir);
+        if (name.empty() || name == "." || name == "..")
+            name = "dir";
+        std::string sub = name;
+        for (int n = 2; used.count(sub); ++n)
+            sub = name + "_" + std::to_string(n);
+        used.insert(sub);
+        return sub;
+    }
+
+    // Имя результатов исходного файла относительно каталога результатов
+    std::string outputBase(const std::string &path) const {
+        const size_t slash = path.find_last_of('/');
+        const std::string name = watch_detail::fileName(path);
+        if (slash == std::string::npos)
+            return name;
+        auto sub = m_outputSubdirs.find(path.substr(0, slash));
+        return sub == m_outputSubdirs.end() ? name : sub->second + "/" + name;
+    }
+
+    std::string outputPath(const std::string &base, const std::string &format) const {
+        return m_opts.outputDir + "/" + base + "." + format;
+    }
+
+    // Выполнение задания; результат - converted, deduplicated, unchanged или failed
+    const char *runJob(const Job &job) {
+        const std::string base = outputBase(job.path);
+        const uint64_t hash = watch_detail::contentHash(job.path);
+        if (!hash)
+            return "failed";
+        std::string source;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // Та же копия уже конвертируется другим потоком: дождаться её результата
+            m_doneHash.wait(lock, [&]() { return m_stopping || !m_inFlight.count(hash); });
+            if (m_stopping)
+                return "failed";
+            auto current = m_outputHash.find(job.path);
+            if (current != m_outputHash.end() && current->second == hash)
+                return "unchanged";
+            auto done = m_hashSource.find(hash);
+            if (done != m_hashSource.end()) {
+                auto other = m_outputHash.find(done->second);
+                if (other != m_outputHash.end() && other->second == hash)
+                    source = done->second;
+            }
+            if (source.empty())
+                m_inFlight.insert(hash);
+        }
+
+        bool ok = true;
+        if (!source.empty()) {
+            for (const std::string &format : m_opts.formats) {
+                const std::string from = outputPath(outputBase(source), format);
+                if (::access(from.c_str(), F_OK) == 0)
+                    ok = watch_detail::AtomicOutput(outputPath(base, format)).linkFrom(from) && ok;
+            }
+        } else {
+            ok = job.still ? convertStill(job.path, base) : convertVideo(job.path, base);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (source.empty()) {
+            m_inFlight.erase(hash);
+            m_doneHash.notify_all();
+        }
+        if (!ok)
+            return "failed";
+        m_outputHash[job.path] = hash;
+        m_hashSource[hash] = job.path;
+        return source.empty() ? "converted" : "deduplicated";
+    }
+
+    bool convertStill(const std::string &path, const std::string &base) {
+        const cv::Mat img = loadImageForAscii(path, m_opts.width);
+        if (img.empty())
+            return false;
+        AsciiFrame frame;
+        convertFrame(img, m_opts.width, static_cast<int>(m_opts.glyphs.size()), m_opts.dither, frame);
+        bool ok = true;
+        for (const std::string &format : m_opts.formats) {
+            watch_detail::AtomicOutput out(outputPath(base, format));
+            if (format == "txt") {
+                ok = out.write(asciiFrameToPlain(frame, m_opts.glyphs)) && out.commit() && ok;
+            } else if (format == "ans") {
+                ok = out.write(asciiFrameToAnsi(frame, m_opts.glyphs, m_opts.depth, m_opts.dither)) && out.commit() && ok;
+            } else if (format == "html") {
+                HtmlOptions html;
+                html.blackWhite = m_opts.depth == ColorDepth::Mono;
+                ok = out.write(asciiFrameToHtmlDocument(frame, m_opts.glyphs, html)) && out.commit() && ok;
+            } else if (format == "cast") {
+                TerminalExportWriter writer(writerOptions(TerminalExportFormat::Asciinema, base));
+                ok = writer.open(out.tempPath()) && writer.addFrame(frame, 0.0) && writer.close(0.0) &&
+                     out.commit() && ok;
+            }
+        }
+        return ok;
+    }
+
+    // Видео кадр за кадром во все форматы сразу: ans и cast пишутся потоком,
+    // html - сжатые кадры плеера (txt для видео не создаётся)
+    bool convertVideo(const std::string &path, const std::string &base) {
+        cv::VideoCapture cap(path);
+        if (!cap.isOpened())
+            return false;
+        double fps = cap.get(cv::CAP_PROP_FPS);
+        if (fps <= 0) fps = 10;
+        const double intervalMs = 1000.0 / fps;
+
+        std::vector<std::unique_ptr<watch_detail::AtomicOutput>> outputs;
+        std::vector<std::unique_ptr<TerminalExportWriter>> writers;
+        std::unique_ptr<HtmlPlayerEncoder> player;
+        std::unique_ptr<watch_detail::AtomicOutput> playerOut;
+        for (const std::string &format : m_opts.formats) {
+            if (format == "ans" || format == "cast") {
+                auto out = std::make_unique<watch_detail::AtomicOutput>(outputPath(base, format));
+                auto writer = std::make_unique<TerminalExportWriter>(writerOptions(
+                    format == "cast" ? TerminalExportFormat::Asciinema : TerminalExportFormat::Ansi, base));
+                if (!writer->open(out->tempPath()))
+                    return false;
+                outputs.push_back(std::move(out));
+                writers.push_back(std::move(writer));
+            } else if (format == "html") {
+                player = std::make_unique<HtmlPlayerEncoder>(m_opts.depth == ColorDepth::Mono);
+                playerOut = std::make_unique<watch_detail::AtomicOutput>(outputPath(base, format));
+            }
+        }
+
+        const int levels = static_cast<int>(m_opts.glyphs.size());
+        AsciiFrame frame;
+        cv::Mat image;
+        int64_t index = 0;
+        double ptsMs = 0.0, firstPos = 0.0;
+        while (cap.read(image) && !image.empty()) {
+            if (m_stopping)
+                return false;
+            const double pos = cap.get(cv::CAP_PROP_POS_MSEC);
+            if (index == 0)
+                firstPos = pos;
+            ptsMs = index == 0 ? 0.0 : (pos - firstPos > ptsMs ? pos - firstPos : ptsMs + intervalMs);
+            ++index;
+            convertFrame(image, m_opts.width, levels, m_opts.dither, frame);
+            for (auto &writer : writers) {
+                if (!writer->addFrame(frame, ptsMs / 1000.0))
+                    return false;
+            }
+            if (player && !player->addFrame(frame))
+                return false;
+        }
+        if (index == 0)
+            return false;
+        bool ok = true;
+        for (size_t i = 0; i < writers.size(); ++i)
+            ok = writers[i]->close((ptsMs + intervalMs) / 1000.0) && outputs[i]->commit() && ok;
+        if (player)
+            ok = playerOut->write(player->document(m_opts.glyphs, fps)) && playerOut->commit() && ok;
+        return ok;
+    }
+
+    TerminalExportWriter::Options writerOptions(TerminalExportFormat format, const std::string &title) const {
+        TerminalExportWriter::Options o;
+        o.glyphs = m_opts.glyphs;
+        o.depth = m_opts.depth;
+        o.dither = m_opts.dither;
+        o.format = format;
+        o.title = watch_detail::fileName(title);
+        return o;
+    }
+
+    // Под m_mutex: счётчики, окно задержек для сводки и строка задания в журнал
+    void recordJob(const Job &job, const char *result, watch_detail::Clock::time_point startedAt,
+                   watch_detail::Clock::time_point doneAt) {
+        const std::string r = result;
+        if (r == "converted") ++m_stats.converted;
+        else if (r == "deduplicated") ++m_stats.deduplicated;
+        else if (r == "unchanged") ++m_stats.unchanged;
+        else ++m_stats.failed;
+        ++m_finishedSinceStats;
+
+        const double waitMs = std::chrono::duration<double, std::milli>(startedAt - job.queued).count();
+        const double totalMs = std::chrono::duration<double, std::milli>(doneAt - job.queued).count();
+        const size_t kWindow = 1024;
+        if (m_latencies.size() < kWindow) {
+            m_latencies.push_back(totalMs);
+            m_waits.push_back(waitMs);
+        } else {
+            m_latencies[m_latencyNext] = totalMs;
+            m_waits[m_latencyNext] = waitMs;
+        }
+        m_latencyNext = (m_latencyNext + 1) % kWindow;
+
+        if (!m_statsFile)
+            return;
+        std::string line = "{\"type\": \"job\", \"path\": ";
+        terminal_export_detail::appendJsonString(line, job.path);
+        char tail[160];
+        std::snprintf(tail, sizeof(tail),
+                      ", \"result\": \"%s\", \"bytes\": %llu, \"waitMs\": %.1f, \"runMs\": %.1f, \"totalMs\": %.1f}\n",
+                      result, static_cast<unsigned long long>(job.size), waitMs, totalMs - waitMs, totalMs);
+        line += tail;
+        std::fputs(line.c_str(), m_statsFile);
+    }
+
+    // Сводка: глубина очереди, пропускная способность за интервал, задержки последних заданий
+    void writeStats(watch_detail::Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_statsFile)
+            return;
+        const double intervalSec = std::chrono::duration<double>(now - m_lastStats).count();
+        const double uptimeSec = std::chrono::duration<double>(now - m_started).count();
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "{\"type\": \"stats\", \"uptimeSec\": %.1f, \"queued\": %zu, \"running\": %zu, "
+                      "\"memoryMb\": %.1f, \"converted\": %llu, \"deduplicated\": %llu, \"unchanged\": %llu, "
+                      "\"failed\": %llu, \"jobsPerSec\": %.2f, \"latencyMs\": {\"p50\": %.1f, \"p95\": %.1f, "
+                      "\"max\": %.1f}, \"waitMs\": {\"p50\": %.1f, \"p95\": %.1f}}\n",
+                      uptimeSec, m_queue.size(), m_running, m_memoryInUse / (1024.0 * 1024.0),
+                      static_cast<unsigned long long>(m_stats.converted),
+                      static_cast<unsigned long long>(m_stats.deduplicated),
+                      static_cast<unsigned long long>(m_stats.unchanged),
+                      static_cast<unsigned long long>(m_stats.failed),
+                      intervalSec > 0 ? m_finishedSinceStats / intervalSec : 0.0,
+                      watch_detail::percentile(m_latencies, 0.5), watch_detail::percentile(m_latencies, 0.95),
+                      m_latencies.empty() ? 0.0 : *std::max_element(m_latencies.begin(), m_latencies.end()),
+                      watch_detail::percentile(m_waits, 0.5), watch_detail::percentile(m_waits, 0.95));
+        std::fputs(line, m_statsFile);
+        std::fflush(m_statsFile);
+        m_finishedSinceStats = 0;
+    }
+
+    WatchDaemonOptions m_opts;
+    std::vector<std::thread> m_threads;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;      // новое задание или освободилась память
+    std::condition_variable m_doneHash;  // завершилась конвертация одного из m_inFlight
+    Queue m_queue;
+    std::unordered_map<std::string, Queue::iterator> m_pending;
+    std::unordered_map<std::string, FileState> m_known;          // последнее поставленное состояние
+    std::unordered_map<std::string, uint64_t> m_outputHash;      // путь -> хеш содержимого в результатах
+    std::unordered_map<uint64_t, std::string> m_hashSource;      // хеш -> путь с готовыми результатами
+    std::set<std::string> m_runningPaths;                        // пути выполняемых заданий
+    std::set<std::string> m_rerun;                               // изменились во время своего задания
+    std::map<std::string, std::string> m_outputSubdirs;          // каталог -> подкаталог результатов
+    std::set<uint64_t> m_inFlight;
+    std::atomic<bool> m_stopping{false};
+    bool m_deferred = false;
+    size_t m_running = 0;
+    uint64_t m_memoryInUse = 0;
+    uint64_t m_seq = 0;
+    Stats m_stats;
+    std::vector<double> m_latencies;
+    std::vector<double> m_waits;
+    size_t m_latencyNext = 0;
+    uint64_t m_finishedSinceStats = 0;
+    std::FILE *m_statsFile = nullptr;
+    std::map<int, std::string> m_watches;
+    int m_inotify = -1;
+    watch_detail::Clock::time_point m_started;
+    watch_detail::Clock::time_point m_lastStats;
+    watch_detail::Clock::time_point m_lastRescan;
+};
+
+#endif // WATCH_DAEMON_H
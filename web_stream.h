@@ -0,0 +1,432 @@
+// web_stream.h
+// Локальный сервер трансляции ASCII-кадров по WebSocket и HTTP (chunked).
+// Источник декодируется и конвертируется один раз; каждый кадр кодируется один раз
+// на используемый формат (plain, ansi, html, delta), и один и тот же буфер ставится
+// в очереди всех клиентов этого формата. Медленный клиент теряет очередь и ждёт
+// ключевого кадра, не задерживая остальных
+//
+// Маршруты:
+//   GET /                      - страница просмотра (?format=html|plain)
+//   GET /ws?format=...         - WebSocket, один кадр на сообщение
+//   GET /stream?format=...     - HTTP chunked, один кадр на chunk; текстовые кадры
+//                                заканчиваются '\f', записи delta предваряются длиной (u32 LE)
+// Запись delta: cols, rows (u16 LE), байт размера ячейки, затем запись кадра в формате
+// HTML-плеера (см. HtmlPlayerEncoder)
+
+#ifndef WEB_STREAM_H
+#define WEB_STREAM_H
+
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ascii_core.h"
+#include "ansi_export.h"
+#include "html_export.h"
+#include "html_player.h"
+#include "net_server.h"
+
+enum class StreamFormat { Plain = 0, Ansi, Html, Delta };
+constexpr int kStreamFormatCount = 4;
+
+inline bool streamFormatFromString(const std::string &name, StreamFormat &format) {
+    if (name == "plain" || name == "text") format = StreamFormat::Plain;
+    else if (name == "ansi") format = StreamFormat::Ansi;
+    else if (name == "html") format = StreamFormat::Html;
+    else if (name == "delta" || name == "binary") format = StreamFormat::Delta;
+    else return false;
+    return true;
+}
+
+namespace web_detail {
+
+inline std::array<uint8_t, 20> sha1(const std::string &message) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = message;
+    const uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+    data += static_cast<char>(0x80);
+    while (data.size() % 64 != 56)
+        data += '\0';
+    for (int i = 7; i >= 0; --i)
+        data += static_cast<char>((bitLength >> (i * 8)) & 0xFF);
+    auto rol = [](uint32_t v, int n) { return (v << n) | (v >> (32 - n)); };
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data()) + block + i * 4;
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; ++i)
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 20; ++i)
+        digest[i] = static_cast<uint8_t>((h[i / 4] >> (24 - (i % 4) * 8)) & 0xFF);
+    return digest;
+}
+
+// Кадр WebSocket от сервера (без маски)
+inline std::string wsFrame(uint8_t opcode, const std::string &payload) {
+    std::string out;
+    out += static_cast<char>(0x80 | opcode);
+    const uint64_t n = payload.size();
+    if (n < 126) {
+        out += static_cast<char>(n);
+    } else if (n <= 0xFFFF) {
+        out += static_cast<char>(126);
+        out += static_cast<char>((n >> 8) & 0xFF);
+        out += static_cast<char>(n & 0xFF);
+    } else {
+        out += static_cast<char>(127);
+        for (int i = 7; i >= 0; --i)
+            out += static_cast<char>((n >> (i * 8)) & 0xFF);
+    }
+    out += payload;
+    return out;
+}
+
+inline std::string httpChunk(const std::string &payload) {
+    char size[20];
+    std::snprintf(size, sizeof(size), "%zx\r\n", payload.size());
+    return size + payload + "\r\n";
+}
+
+// Значение заголовка без учёта регистра имени (пусто, если нет)
+inline std::string headerValue(const std::string &head, const std::string &name) {
+    size_t pos = head.find("\r\n");
+    while (pos != std::string::npos && pos + 2 < head.size()) {
+        size_t lineStart = pos + 2;
+        size_t lineEnd = head.find("\r\n", lineStart);
+        std::string line = head.substr(lineStart, lineEnd == std::string::npos ? std::string::npos : lineEnd - lineStart);
+        size_t colon = line.find(':');
+        if (colon == name.size()) {
+            bool same = true;
+            for (size_t i = 0; i < colon && same; ++i)
+                same = std::tolower(static_cast<unsigned char>(line[i])) == std::tolower(static_cast<unsigned char>(name[i]));
+            if (same) {
+                size_t start = line.find_first_not_of(' ', colon + 1);
+                return start == std::string::npos ? std::string() : line.substr(start);
+            }
+        }
+        pos = lineEnd;
+    }
+    return std::string();
+}
+
+inline std::string queryParam(const std::string &target, const std::string &name) {
+    size_t q = target.find('?');
+    while (q != std::string::npos) {
+        size_t start = q + 1;
+        size_t end = target.find('&', start);
+        std::string pair = target.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        if (pair.compare(0, name.size() + 1, name + "=") == 0)
+            return pair.substr(name.size() + 1);
+        q = end;
+    }
+    return std::string();
+}
+
+static const char *kViewerPage =
+    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>ASCII</title><style>"
+    "body{margin:0;background:#000}pre{margin:0;color:#fff;font:10px/1.1 monospace}</style></head>"
+    "<body><pre id=\"a\"></pre><script>"
+    "var f=new URLSearchParams(location.search).get('format')==='plain'?'plain':'html',a=document.getElementById('a');"
+    "var ws=new WebSocket((location.protocol==='https:'?'wss://':'ws://')+location.host+'/ws?format='+f);"
+    "ws.onmessage=function(e){if(f==='html')a.innerHTML=e.data;else a.textContent=e.data;};"
+    "</script></body></html>\n";
+
+} // namespace web_detail
+
+class WebStreamServer : public NetServer {
+public:
+    struct Options {
+        std::vector<std::string> glyphs;
+        bool blackWhite = false;                       // html и delta без цвета
+        ColorDepth ansiDepth = ColorDepth::TrueColor;
+        DitherMode dither = DitherMode::None;          // для квантования ansi 256
+        size_t maxQueuedBytes = 1 << 20;               // предел очереди клиента до сброса
+        int keyframeInterval = 48;
+    };
+
+    explicit WebStreamServer(Options opts)
+        : m_opts(std::move(opts)), m_delta(m_opts.blackWhite, m_opts.keyframeInterval) {
+        for (auto &format : m_users)
+            for (auto &count : format)
+                count = 0;
+    }
+
+    // Цикл останавливается до разрушения членов: он вызывает переопределённые onData/onClosed
+    ~WebStreamServer() override { stop(); }
+
+    // Публикация кадра из потока источника
+    void publish(const AsciiFrame &frame) {
+        std::array<Encoded, kStreamFormatCount> encoded;
+        for (int f = 0; f < kStreamFormatCount; ++f) {
+            const bool http = m_users[f][kHttp] > 0, ws = m_users[f][kWebSocket] > 0;
+            if (!http && !ws)
+                continue;
+            encodeFormat(static_cast<StreamFormat>(f), frame, http, ws, encoded[f]);
+            ++m_encodes;
+        }
+        ++m_published;
+        post([this, encoded]() { distribute(encoded); });
+    }
+
+    std::string statusLine() const {
+        Counters c = counters();
+        char line[256];
+        std::snprintf(line, sizeof(line),
+                      "клиентов: %zu | кадров: %llu | кодирований: %llu | отправлено: %.1f МБ | сброшено из очередей: %llu | пропущено до ключевого: %llu",
+                      clientCount(), static_cast<unsigned long long>(m_published.load()),
+                      static_cast<unsigned long long>(m_encodes.load()), c.bytesSent / (1024.0 * 1024.0),
+                      static_cast<unsigned long long>(c.framesDropped),
+                      static_cast<unsigned long long>(m_skipped.load()));
+        return line;
+    }
+
+protected:
+    enum Transport { kHttp = 0, kWebSocket = 1, kPending = 2 };
+
+    struct WebConnection : Connection {
+        Transport transport = kPending;
+        StreamFormat format = StreamFormat::Html;
+        bool waitKeyframe = true;
+    };
+
+    struct Encoded {
+        SharedBuffer buffers[2];   // [kHttp], [kWebSocket]
+        bool key = true;
+    };
+
+    std::unique_ptr<Connection> createConnection() override { return std::make_unique<WebConnection>(); }
+
+    void onData(Connection &c) override {
+        WebConnection &w = static_cast<WebConnection &>(c);
+        if (w.transport == kPending)
+            handleRequest(w);
+        else if (w.transport == kWebSocket)
+            handleWebSocketInput(w);
+        else
+            w.inbox.clear();
+    }
+
+    void onClosed(Connection &c) override {
+        WebConnection &w = static_cast<WebConnection &>(c);
+        if (w.transport != kPending)
+            --m_users[static_cast<int>(w.format)][w.transport];
+    }
+
+private:
+    void encodeFormat(StreamFormat format, const AsciiFrame &frame, bool http, bool ws, Encoded &out) {
+        std::string payload;
+        uint8_t opcode = 0x1;
+        switch (format) {
+        case StreamFormat::Plain:
+            payload = asciiFrameToPlain(frame, m_opts.glyphs);
+            break;
+        case StreamFormat::Ansi:
+            payload = "\033[H" + asciiFrameToAnsi(frame, m_opts.glyphs, m_opts.ansiDepth, m_opts.dither);
+            break;
+        case StreamFormat::Html: {
+            HtmlOptions html;
+            html.blackWhite = m_opts.blackWhite;
+            payload = asciiFrameToHtmlBody(frame, m_opts.glyphs, html);
+            break;
+        }
+        case StreamFormat::Delta: {
+            // Новый зритель или сброшенная очередь - ключевой кадр, но не чаще раза в 8 кадров
+            bool force = m_forceKey.load() && m_framesSinceForced >= 8;
+            if (force)
+                m_forceKey = false;
+            out.key = m_delta.encodeFrame(frame, m_record, force);
+            m_framesSinceForced = out.key ? 0 : m_framesSinceForced + 1;
+            payload.reserve(m_record.size() + 5);
+            payload += static_cast<char>(m_delta.columns() & 0xFF);
+            payload += static_cast<char>(m_delta.columns() >> 8);
+            payload += static_cast<char>(m_delta.rows() & 0xFF);
+            payload += static_cast<char>(m_delta.rows() >> 8);
+            payload += static_cast<char>(m_delta.cellSize());
+            payload.append(reinterpret_cast<const char *>(m_record.data()), m_record.size());
+            opcode = 0x2;
+            break;
+        }
+        }
+        if (ws)
+            out.buffers[kWebSocket] = makeSharedBuffer(web_detail::wsFrame(opcode, payload));
+        if (http) {
+            if (format == StreamFormat::Delta) {
+                std::string prefixed;
+                const uint32_t n = static_cast<uint32_t>(payload.size());
+                for (int i = 0; i < 4; ++i)
+                    prefixed += static_cast<char>((n >> (i * 8)) & 0xFF);
+                out.buffers[kHttp] = makeSharedBuffer(web_detail::httpChunk(prefixed + payload));
+            } else {
+                out.buffers[kHttp] = makeSharedBuffer(web_detail::httpChunk(payload + "\f"));
+            }
+        }
+    }
+
+    void distribute(const std::array<Encoded, kStreamFormatCount> &encoded) {
+        forEachConnection([&](Connection &c) {
+            WebConnection &w = static_cast<WebConnection &>(c);
+            if (w.transport == kPending)
+                return;
+            const Encoded &e = encoded[static_cast<int>(w.format)];
+            const SharedBuffer &buffer = e.buffers[w.transport];
+            if (!buffer)
+                return;
+            if (w.queuedBytes > m_opts.maxQueuedBytes) {
+                dropQueued(w);
+                w.waitKeyframe = true;
+            }
+            if (w.waitKeyframe && !e.key) {
+                ++m_skipped;
+                m_forceKey = true;
+                return;
+            }
+            w.waitKeyframe = false;
+            send(w, buffer);
+        });
+    }
+
+    void respond(WebConnection &w, const std::string &status, const std::string &type, const std::string &body) {
+        std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + type +
+                               "\r\nContent-Length: " + std::to_string(body.size()) +
+                               "\r\nConnection: close\r\n\r\n" + body;
+        w.closeAfterFlush = true;
+        send(w, makeSharedBuffer(std::move(response)));
+    }
+
+    void handleRequest(WebConnection &w) {
+        size_t end = w.inbox.find("\r\n\r\n");
+        if (end == std::string::npos)
+            return;
+        std::string head = w.inbox.substr(0, end + 2);
+        w.inbox.erase(0, end + 4);
+
+        size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+        if (head.compare(0, 4, "GET ") != 0 || sp2 == std::string::npos) {
+            respond(w, "405 Method Not Allowed", "text/plain", "GET only\n");
+            return;
+        }
+        const std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+        const std::string path = target.substr(0, target.find('?'));
+        if (path == "/") {
+            respond(w, "200 OK", "text/html; charset=utf-8", web_detail::kViewerPage);
+            return;
+        }
+        StreamFormat format = StreamFormat::Html;
+        std::string formatName = web_detail::queryParam(target, "format");
+        if (!formatName.empty() && !streamFormatFromString(formatName, format)) {
+            respond(w, "400 Bad Request", "text/plain", "format: plain|ansi|html|delta\n");
+            return;
+        }
+
+        if (path == "/ws") {
+            std::string key = web_detail::headerValue(head, "Sec-WebSocket-Key");
+            if (key.empty()) {
+                respond(w, "400 Bad Request", "text/plain", "WebSocket upgrade expected\n");
+                return;
+            }
+            auto digest = web_detail::sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+            std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                   "Sec-WebSocket-Accept: " + base64Encode(digest.data(), digest.size()) + "\r\n\r\n";
+            send(w, makeSharedBuffer(std::move(response)));
+            attach(w, kWebSocket, format);
+            if (!w.inbox.empty())
+                handleWebSocketInput(w);
+        } else if (path == "/stream") {
+            const char *type = format == StreamFormat::Delta ? "application/octet-stream" : "text/plain; charset=utf-8";
+            std::string response = std::string("HTTP/1.1 200 OK\r\nContent-Type: ") + type +
+                                   "\r\nTransfer-Encoding: chunked\r\nCache-Control: no-cache\r\n\r\n";
+            if (format == StreamFormat::Ansi)
+                response += web_detail::httpChunk("\033[2J");
+            send(w, makeSharedBuffer(std::move(response)));
+            attach(w, kHttp, format);
+            w.inbox.clear();
+        } else {
+            respond(w, "404 Not Found", "text/plain", "not found\n");
+        }
+    }
+
+    void attach(WebConnection &w, Transport transport, StreamFormat format) {
+        w.transport = transport;
+        w.format = format;
+        w.waitKeyframe = true;
+        ++m_users[static_cast<int>(format)][transport];
+        if (format == StreamFormat::Delta)
+            m_forceKey = true;
+    }
+
+    // Кадры от браузера: отвечаем на ping и close, остальное игнорируем
+    void handleWebSocketInput(WebConnection &w) {
+        for (;;) {
+            if (w.inbox.size() < 2)
+                return;
+            const uint8_t b0 = static_cast<uint8_t>(w.inbox[0]), b1 = static_cast<uint8_t>(w.inbox[1]);
+            size_t header = 2;
+            uint64_t length = b1 & 0x7F;
+            if (length == 126) {
+                if (w.inbox.size() < 4)
+                    return;
+                length = (uint64_t(uint8_t(w.inbox[2])) << 8) | uint8_t(w.inbox[3]);
+                header = 4;
+            } else if (length == 127) {
+                if (w.inbox.size() < 10)
+                    return;
+                length = 0;
+                for (int i = 0; i < 8; ++i)
+                    length = (length << 8) | uint8_t(w.inbox[2 + i]);
+                header = 10;
+            }
+            const bool masked = (b1 & 0x80) != 0;
+            const size_t total = header + (masked ? 4 : 0) + length;
+            if (length > 65536) {
+                closeConnection(w);
+                return;
+            }
+            if (w.inbox.size() < total)
+                return;
+            std::string payload = w.inbox.substr(header + (masked ? 4 : 0), length);
+            if (masked) {
+                for (size_t i = 0; i < payload.size(); ++i)
+                    payload[i] ^= w.inbox[header + (i % 4)];
+            }
+            w.inbox.erase(0, total);
+            const uint8_t opcode = b0 & 0x0F;
+            if (opcode == 0x8) {
+                w.closeAfterFlush = true;
+                send(w, makeSharedBuffer(web_detail::wsFrame(0x8, std::string())));
+                return;
+            }
+            if (opcode == 0x9)
+                send(w, makeSharedBuffer(web_detail::wsFrame(0xA, payload)));
+        }
+    }
+
+    Options m_opts;
+    HtmlPlayerEncoder m_delta;          // используется только потоком источника
+    std::vector<uint8_t> m_record;
+    int m_framesSinceForced = 8;
+    std::atomic<bool> m_forceKey{false};
+    std::atomic<int> m_users[kStreamFormatCount][2];
+    std::atomic<uint64_t> m_published{0};
+    std::atomic<uint64_t> m_encodes{0};
+    std::atomic<uint64_t> m_skipped{0};
+};
+
+#endif // WEB_STREAM_H
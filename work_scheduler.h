@@ -0,0 +1,445 @@
+// work_scheduler.h
+// Общий планировщик работы процесса: фиксированный набор рабочих потоков по числу ядер,
+// у каждого свои очереди по приоритетам. Задание, порождённое внутри задания, кладётся
+// в очередь своего потока и берётся оттуда с конца (данные ещё в кэше), простаивающие
+// потоки воруют с начала чужих очередей. Задания извне и продолжения длинной работы
+// идут в общую очередь по порядку поступления, поэтому две предобработки делят ядра
+// поровну. Более высокий приоритет всегда выбирается раньше, но уже начатое задание
+// не прерывается - длинная работа дробится на куски сама. Отмена кооперативная: задание
+// проверяет свой CancelToken
+
+#ifndef WORK_SCHEDULER_H
+#define WORK_SCHEDULER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+enum class TaskPriority {
+    Interactive = 0,  // то, чего пользователь ждёт сейчас: конвертация изображения, превью
+    Normal = 1,       // экспорт и прочие фоновые задания с собственным окном прогресса
+    Bulk = 2          // предобработка видео и GIF
+};
+
+static const int kTaskPriorities = 3;
+
+// Флаг кооперативной отмены, разделяемый копиями
+class CancelToken {
+public:
+    CancelToken() : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { m_flag->store(true, std::memory_order_release); }
+    bool cancelled() const { return m_flag->load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+class WorkScheduler {
+public:
+    using Task = std::function<void()>;
+
+    struct Stats {
+        int workers = 0;
+        int busy = 0;                         // потоков выполняют задание сейчас
+        size_t queued[kTaskPriorities] = {};  // ожидают по приоритетам
+        uint64_t executed = 0;
+        uint64_t stolen = 0;                  // взято из чужой очереди
+        double utilization = 0.0;             // доля занятого времени потоков с прошлого вызова stats()
+    };
+
+    // workers: 0 - по числу ядер. threadInit вызывается в каждом рабочем потоке до первого задания
+    explicit WorkScheduler(int workers = 0, std::function<void()> threadInit = std::function<void()>()) {
+        if (workers <= 0)
+            workers = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        m_lastStats = nowNs();
+        for (int i = 0; i < workers; ++i)
+            m_workers.push_back(std::make_unique<Worker>());
+        for (int i = 0; i < workers; ++i) {
+            m_workers[i]->thread = std::thread([this, i, threadInit]() {
+                current() = {this, i};
+                if (threadInit)
+                    threadInit();
+                loop(i);
+            });
+        }
+    }
+
+    ~WorkScheduler() { shutdown(); }
+
+    WorkScheduler(const WorkScheduler &) = delete;
+    WorkScheduler &operator=(const WorkScheduler &) = delete;
+
+    int workerCount() const { return static_cast<int>(m_workers.size()); }
+
+    // Поставить задание. Из рабочего потока - в его очередь, иначе - в общую
+    void submit(Task task, TaskPriority priority = TaskPriority::Normal) {
+        const int self = workerIndex();
+        if (self < 0) {
+            post(std::move(task), priority);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_workers[self]->mutex);
+            m_workers[self]->queues[index(priority)].push_back(std::move(task));
+        }
+        notify();
+    }
+
+    // Всегда в конец общей очереди: продолжение длинной работы пропускает вперёд
+    // всё, что уже ждёт с тем же приоритетом
+    void post(Task task, TaskPriority priority = TaskPriority::Normal) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shared[index(priority)].push_back(std::move(task));
+        }
+        notify();
+    }
+
+    // Выполнить одно задание из собственной очереди вызывающего рабочего потока (для
+    // ожидания с помощью). Там лежат только задания, порождённые работой на его стеке,
+    // поэтому ожидание не подхватывает чужой экспорт или предобработку.
+    // false - очередь пуста или поток не рабочий
+    bool runLocal() {
+        const int self = workerIndex();
+        if (self < 0)
+            return false;
+        Task task;
+        {
+            Worker &own = *m_workers[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            for (int p = 0; p < kTaskPriorities && !task; ++p) {
+                if (!own.queues[p].empty()) {
+                    task = std::move(own.queues[p].back());
+                    own.queues[p].pop_back();
+                }
+            }
+        }
+        if (!task)
+            return false;
+        m_pending.fetch_sub(1);
+        execute(self, task);
+        return true;
+    }
+
+    // Вызывающий поток - рабочий поток этого планировщика
+    bool onWorkerThread() const { return workerIndex() >= 0; }
+
+    // Потоков без задания сейчас (оценка: к моменту использования может измениться)
+    int idleWorkers() const { return std::max(0, workerCount() - m_busy.load()); }
+
+    // body(i) для i = 0..count-1 с приоритетом priority; возвращается после всех вызовов
+    template <typename Body>
+    void parallelFor(int count, const Body &body, TaskPriority priority = TaskPriority::Normal);
+
+    Stats stats() {
+        Stats s;
+        s.workers = workerCount();
+        s.busy = m_busy.load();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (int p = 0; p < kTaskPriorities; ++p)
+                s.queued[p] = m_shared[p].size();
+        }
+        for (const auto &w : m_workers) {
+            std::lock_guard<std::mutex> lock(w->mutex);
+            for (int p = 0; p < kTaskPriorities; ++p)
+                s.queued[p] += w->queues[p].size();
+        }
+        s.executed = m_executed.load();
+        s.stolen = m_stolen.load();
+        // Время ещё идущих заданий учитывается до текущего момента, и начало их отсчёта
+        // сдвигается сюда: длинное задание видно в загрузке, пока выполняется
+        const int64_t now = nowNs();
+        for (const auto &w : m_workers) {
+            int64_t since = w->busySince.load();
+            while (since != 0 && since < now && !w->busySince.compare_exchange_weak(since, now)) {
+            }
+            if (since != 0 && since < now)
+                m_busyNs.fetch_add(static_cast<uint64_t>(now - since));
+        }
+        const double wallNs = static_cast<double>(now - m_lastStats);
+        const uint64_t busyNs = m_busyNs.exchange(0);
+        m_lastStats = now;
+        if (wallNs > 0 && s.workers > 0)
+            s.utilization = std::min(1.0, busyNs / (wallNs * s.workers));
+        return s;
+    }
+
+    // Дождаться очередей и остановить потоки. Ожидающие задания и порождённые ими
+    // выполняются до конца, поэтому их владельцы к этому времени должны отменить свою
+    // работу. Задание, поставленное извне после остановки, уже не выполнится
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+                return;
+            m_stopping = true;
+        }
+        m_wake.notify_all();
+        for (auto &w : m_workers) {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> queues[kTaskPriorities];
+        std::thread thread;
+        std::atomic<int64_t> busySince{0};  // начало неучтённого занятого времени, 0 - простаивает
+        int depth = 0;                      // вложенность заданий (ожидание с помощью), только свой поток
+    };
+
+    struct Current {
+        WorkScheduler *owner = nullptr;
+        int index = -1;
+    };
+
+    static Current &current() {
+        thread_local Current c;
+        return c;
+    }
+
+    int workerIndex() const { return current().owner == this ? current().index : -1; }
+
+    static int index(TaskPriority priority) { return static_cast<int>(priority); }
+
+    static int64_t nowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void notify() {
+        m_pending.fetch_add(1);
+        // Пустая блокировка: спящий поток либо уже увидел m_pending, либо ждёт и получит сигнал
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_wake.notify_one();
+    }
+
+    // Лучшее доступное задание: по приоритетам, внутри приоритета - своя очередь
+    // с конца, общая с начала, затем чужие очереди с начала
+    bool take(int self, Task &task) {
+        if (m_pending.load() == 0)
+            return false;
+        const int count = workerCount();
+        for (int p = 0; p < kTaskPriorities; ++p) {
+            if (self >= 0) {
+                Worker &own = *m_workers[self];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.queues[p].empty()) {
+                    task = std::move(own.queues[p].back());
+                    own.queues[p].pop_back();
+                    m_pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_shared[p].empty()) {
+                    task = std::move(m_shared[p].front());
+                    m_shared[p].pop_front();
+                    m_pending.fetch_sub(1);
+                    return true;
+                }
+            }
+            for (int k = 1; k <= count; ++k) {
+                const int victim = (std::max(self, 0) + k) % count;
+                if (victim == self)
+                    continue;
+                Worker &other = *m_workers[victim];
+                std::lock_guard<std::mutex> lock(other.mutex);
+                if (!other.queues[p].empty()) {
+                    task = std::move(other.queues[p].front());
+                    other.queues[p].pop_front();
+                    m_pending.fetch_sub(1);
+                    m_stolen.fetch_add(1);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Занятость считается по внешнему заданию: вложенные (ожидание с помощью) идут внутри него
+    void execute(int self, Task &task) {
+        Worker &w = *m_workers[self];
+        const bool outer = w.depth++ == 0;
+        if (outer) {
+            ++m_busy;
+            w.busySince.store(nowNs());
+        }
+        try {
+            task();
+        } catch (...) {
+            // Исключение задания не должно останавливать рабочий поток
+        }
+        task = Task();
+        if (outer) {
+            const int64_t since = w.busySince.exchange(0);
+            const int64_t now = nowNs();
+            if (now > since)
+                m_busyNs.fetch_add(static_cast<uint64_t>(now - since));
+            --m_busy;
+        }
+        --w.depth;
+        ++m_executed;
+    }
+
+    void loop(int self) {
+        for (;;) {
+            Task task;
+            if (take(self, task)) {
+                execute(self, task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_stopping || m_pending.load() > 0; });
+            if (m_stopping && m_pending.load() == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<Task> m_shared[kTaskPriorities];
+    std::atomic<size_t> m_pending{0};
+    std::atomic<int> m_busy{0};
+    std::atomic<uint64_t> m_busyNs{0};
+    std::atomic<uint64_t> m_executed{0};
+    std::atomic<uint64_t> m_stolen{0};
+    int64_t m_lastStats = 0;
+    bool m_stopping = false;
+};
+
+// Группа заданий с общим ожиданием. Рабочий поток планировщика, ожидая группу, выполняет
+// ещё не начатые задания этой группы и своей очереди, поэтому вложенное ожидание не
+// занимает поток впустую и не может исчерпать пул. Задания из общей очереди (другой
+// экспорт, куски предобработки) при этом не берутся: они не вкладываются в чужой стек.
+// Задание выполняет тот, кто первым его захватил, - рабочий из очереди или ожидающий
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkScheduler &scheduler) : m_scheduler(scheduler) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    void submit(WorkScheduler::Task task, TaskPriority priority = TaskPriority::Normal) {
+        std::shared_ptr<Pending> pending = begin(std::move(task));
+        m_scheduler.submit([this, pending]() { runClaimed(pending); }, priority);
+    }
+
+    void post(WorkScheduler::Task task, TaskPriority priority = TaskPriority::Normal) {
+        std::shared_ptr<Pending> pending = begin(std::move(task));
+        m_scheduler.post([this, pending]() { runClaimed(pending); }, priority);
+    }
+
+    // true - все задания группы завершены; иначе прошло timeout
+    bool waitFor(std::chrono::milliseconds timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (m_scheduler.onWorkerThread()) {
+            for (;;) {
+                if (done())
+                    return true;
+                if (std::chrono::steady_clock::now() >= deadline)
+                    return false;
+                if (!helpOne() && !m_scheduler.runLocal()) {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_finished.wait_for(lock, std::chrono::milliseconds(1), [this]() { return m_running == 0; });
+                }
+            }
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_finished.wait_until(lock, deadline, [this]() { return m_running == 0; });
+    }
+
+    void wait() {
+        while (!waitFor(std::chrono::milliseconds(100))) {
+        }
+    }
+
+private:
+    bool done() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_running == 0;
+    }
+
+    // Задание группы; копия в очереди планировщика, захваченная позже ожидающим,
+    // пропускается и к группе (возможно, уже разрушенной) не обращается
+    struct Pending {
+        std::atomic<bool> claimed{false};
+        WorkScheduler::Task task;
+    };
+
+    std::shared_ptr<Pending> begin(WorkScheduler::Task task) {
+        auto pending = std::make_shared<Pending>();
+        pending->task = std::move(task);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_running;
+        m_unstarted.push_back(pending);
+        return pending;
+    }
+
+    // Самое позднее незахваченное задание группы в вызывающем потоке
+    bool helpOne() {
+        std::shared_ptr<Pending> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (!m_unstarted.empty() && !pending) {
+                if (!m_unstarted.back()->claimed.load())
+                    pending = m_unstarted.back();
+                m_unstarted.pop_back();
+            }
+        }
+        return pending && runClaimed(pending);
+    }
+
+    // Счётчик уменьшается и при исключении задания. Сигнал отправляется под блокировкой:
+    // ожидающий не вернётся и не разрушит группу, пока выполнивший её касается
+    bool runClaimed(const std::shared_ptr<Pending> &pending) {
+        if (pending->claimed.exchange(true))
+            return false;
+        try {
+            pending->task();
+        } catch (...) {
+        }
+        pending->task = WorkScheduler::Task();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_unstarted.empty() && m_unstarted.front()->claimed.load())
+            m_unstarted.pop_front();
+        --m_running;
+        m_finished.notify_all();
+        return true;
+    }
+
+    WorkScheduler &m_scheduler;
+    std::mutex m_mutex;
+    std::condition_variable m_finished;
+    size_t m_running = 0;
+    std::deque<std::shared_ptr<Pending>> m_unstarted;  // по порядку постановки, начатые - удаляются
+};
+
+template <typename Body>
+void WorkScheduler::parallelFor(int count, const Body &body, TaskPriority priority) {
+    if (count <= 0)
+        return;
+    TaskGroup group(*this);
+    for (int i = 1; i < count; ++i)
+        group.submit([&body, i]() { body(i); }, priority);
+    body(0);
+    group.wait();
+}
+
+#endif // WORK_SCHEDULER_H